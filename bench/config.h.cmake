@@ -0,0 +1,3 @@
+#define TLDR_BENCH_MODULE_DIR "@CMAKE_CURRENT_BINARY_DIR@"
+#define TLDR_BENCH_CORPUS_DIR "@CMAKE_CURRENT_BINARY_DIR@/corpus"
+#define TLDR_BENCH_CORPUS "@TLDR_BENCH_CORPUS_NAMES@"
@@ -0,0 +1,133 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+struct ModuleSpec
+{
+	std::string prefix = "bench_";
+	std::string import_prefix = "bench_import_";
+	unsigned long exports = 0;
+	unsigned long jump_slots = 0;
+	unsigned long glob_dats = 0;
+	unsigned long relatives = 0;
+	unsigned long inits = 0;
+	unsigned long payload_kb = 0;
+	std::string needed;
+};
+
+void write_exports(std::ostream & out, const ModuleSpec & spec)
+{
+	for (unsigned long i = 0; i < spec.exports; ++i) {
+		out << "int " << spec.prefix << "proc_" << i << "(void) { return " << i << "; }\n";
+		out << "const int " << spec.prefix << "data_" << i << " = " << i << ";\n";
+	}
+}
+
+void write_imports(std::ostream & out, const ModuleSpec & spec)
+{
+	const auto & prefix = spec.import_prefix;
+	if (!spec.jump_slots && !spec.glob_dats && spec.needed.empty()) return;
+	for (unsigned long i = 0; i < spec.jump_slots; ++i)
+		out << "extern int " << prefix << "proc_" << i << "(void);\n";
+	for (unsigned long i = 0; i < spec.glob_dats; ++i)
+		out << "extern const int " << prefix << "data_" << i << ";\n";
+	if (!spec.needed.empty())
+		out << "extern int " << spec.needed << "(void);\n";
+
+	out << "int " << spec.prefix << "use_imports(void)\n{\n\tint sum = 0;\n";
+	for (unsigned long i = 0; i < spec.jump_slots; ++i)
+		out << "\tsum += " << prefix << "proc_" << i << "();\n";
+	for (unsigned long i = 0; i < spec.glob_dats; ++i)
+		out << "\tsum += *(const int * volatile) &" << prefix << "data_" << i << ";\n";
+	if (!spec.needed.empty())
+		out << "\tsum += " << spec.needed << "();\n";
+	out << "\treturn sum;\n}\n";
+}
+
+void write_relatives(std::ostream & out, const ModuleSpec & spec)
+{
+	if (!spec.relatives) return;
+	out << "static int relative_targets[" << spec.relatives << "];\n";
+	out << "int * const " << spec.prefix << "relative_table[] = {\n";
+	for (unsigned long i = 0; i < spec.relatives; ++i)
+		out << "\t&relative_targets[" << i << "],\n";
+	out << "};\n";
+}
+
+void write_inits(std::ostream & out, const ModuleSpec & spec)
+{
+	if (!spec.inits) return;
+	out << "int " << spec.prefix << "init_count;\n";
+	for (unsigned long i = 0; i < spec.inits; ++i) {
+		out << "__attribute__((constructor)) static void init_" << i << "(void)"
+		    << " { ++" << spec.prefix << "init_count; }\n";
+	}
+}
+
+void write_payload(std::ostream & out, const ModuleSpec & spec)
+{
+	if (!spec.payload_kb) return;
+	out << "const unsigned char " << spec.prefix << "payload["
+	    << spec.payload_kb * 1024 << "] = { 1 };\n";
+}
+
+void usage(const char * argv0)
+{
+	std::cerr << "usage: " << argv0 << " [options] -o FILE\n"
+	             "  --prefix P          prefix of exported names (bench_)\n"
+	             "  --exports N         export N functions and N data objects\n"
+	             "  --import-prefix P   prefix of imported names (bench_import_)\n"
+	             "  --jump-slots N      call N imported functions (JUMP_SLOT)\n"
+	             "  --glob-dats N       reference N imported data objects (GLOB_DAT)\n"
+	             "  --relatives N       emit a table of N local pointers (RELATIVE)\n"
+	             "  --inits N           emit N constructors (init_array entries)\n"
+	             "  --payload-kb N      emit N KiB of initialized read-only data\n"
+	             "  --needed SYMBOL     call SYMBOL from the next DT_NEEDED module\n";
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+	ModuleSpec spec;
+	const char * output = nullptr;
+	for (int i = 1; i < argc; ++i) {
+		const auto has_value = i + 1 < argc;
+		if (!std::strcmp(argv[i], "--prefix") && has_value)
+			spec.prefix = argv[++i];
+		else if (!std::strcmp(argv[i], "--exports") && has_value)
+			spec.exports = std::strtoul(argv[++i], nullptr, 10);
+		else if (!std::strcmp(argv[i], "--import-prefix") && has_value)
+			spec.import_prefix = argv[++i];
+		else if (!std::strcmp(argv[i], "--jump-slots") && has_value)
+			spec.jump_slots = std::strtoul(argv[++i], nullptr, 10);
+		else if (!std::strcmp(argv[i], "--glob-dats") && has_value)
+			spec.glob_dats = std::strtoul(argv[++i], nullptr, 10);
+		else if (!std::strcmp(argv[i], "--relatives") && has_value)
+			spec.relatives = std::strtoul(argv[++i], nullptr, 10);
+		else if (!std::strcmp(argv[i], "--inits") && has_value)
+			spec.inits = std::strtoul(argv[++i], nullptr, 10);
+		else if (!std::strcmp(argv[i], "--payload-kb") && has_value)
+			spec.payload_kb = std::strtoul(argv[++i], nullptr, 10);
+		else if (!std::strcmp(argv[i], "--needed") && has_value)
+			spec.needed = argv[++i];
+		else if (!std::strcmp(argv[i], "-o") && has_value)
+			output = argv[++i];
+		else
+			return usage(argv[0]), EXIT_FAILURE;
+	}
+	if (!output)
+		return usage(argv[0]), EXIT_FAILURE;
+
+	std::ofstream out { output };
+	write_exports(out, spec);
+	write_imports(out, spec);
+	write_relatives(out, spec);
+	write_inits(out, spec);
+	write_payload(out, spec);
+	return out ? EXIT_SUCCESS : EXIT_FAILURE;
+}
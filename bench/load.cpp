@@ -0,0 +1,253 @@
+#include <config.h>
+#include <benchmark/benchmark.h>
+#include <tldr/load_stats.hpp>
+#include <tldr/module_pool.hpp>
+#include <tldr/page_profile.hpp>
+#include <tldr/raw_module.hpp>
+#include <tldr/relocation_plan_cache.hpp>
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+class CorpusResolver final : public tldr::ModuleResolver
+{
+public:
+	virtual std::shared_ptr<tldr::Module> get_module(const std::string & name) const override;
+
+	const std::vector<char> * find_blob(const std::string & name) const;
+
+private:
+	mutable std::map<std::string, std::unique_ptr<std::vector<char>>> blobs_;
+};
+
+const std::vector<char> * CorpusResolver::find_blob(const std::string & name) const
+{
+	auto & blob = blobs_[name];
+	if (!blob) {
+		std::ifstream ifs { TLDR_BENCH_CORPUS_DIR "/" + name, std::ios::binary };
+		if (!ifs) return nullptr;
+		blob.reset(new std::vector<char>(std::istreambuf_iterator<char>(ifs),
+		                                 std::istreambuf_iterator<char>()));
+	}
+	return blob.get();
+}
+
+std::shared_ptr<tldr::Module> CorpusResolver::get_module(const std::string & name) const
+{
+	if (const auto blob = find_blob(name))
+		return tldr::load_from_memory(blob->data(), blob->size(), *this);
+	return tldr::system_loader.get_module(name);
+}
+
+double seconds(std::chrono::nanoseconds duration)
+{
+	return std::chrono::duration<double>(duration).count();
+}
+
+long peak_rss_kb()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+void report_load_stats(benchmark::State & state, const tldr::LoadStats & stats)
+{
+	const double iterations = state.iterations();
+	for (std::size_t i = 0; i < tldr::load_phase_count; ++i) {
+		const auto phase = static_cast<tldr::LoadPhase>(i);
+		const auto name = std::string(tldr::to_string(phase)) + "_us";
+		state.counters[name] = seconds(stats.phase(phase).wall_time) * 1e6 / iterations;
+	}
+
+	const auto relocs = std::accumulate(
+		stats.relocations.begin(), stats.relocations.end(), std::size_t(0),
+		[] (std::size_t sum, const auto & entry) { return sum + entry.second; });
+	const auto map_time = seconds(stats.phase(tldr::LoadPhase::MapProgramHeaders).wall_time);
+	const auto reloc_time = seconds(stats.phase(tldr::LoadPhase::ApplyRelocations).wall_time);
+
+	state.counters["relocs"] = relocs / iterations;
+	state.counters["mapped_kb"] = stats.bytes_mapped / 1024.0 / iterations;
+	state.counters["trimmed_kb"] = stats.bytes_trimmed / 1024.0 / iterations;
+	state.counters["map_MBps"] = map_time > 0 ? stats.bytes_mapped / 1e6 / map_time : 0;
+	state.counters["relocs_per_s"] = reloc_time > 0 ? relocs / reloc_time : 0;
+	state.counters["peak_rss_kb"] = peak_rss_kb();
+
+	std::size_t relocated_pages = 0;
+	for (const auto & entry : stats.page_relocation_density)
+		relocated_pages += entry.second;
+	if (relocated_pages) {
+		state.counters["relocated_pages"] = relocated_pages / iterations;
+		state.counters["relocs_per_page"] = static_cast<double>(relocs) / relocated_pages;
+	}
+}
+
+/*
+	Trimmed loads discard relocated pages after loading, and planned loads
+	replay a relocation plan compiled by an untimed first load.
+ */
+enum class LoadVariant
+{
+	Plain,
+	Trimmed,
+	Planned,
+};
+
+void BM_LoadFromMemory(benchmark::State & state, const std::string & name, LoadVariant variant)
+{
+	const CorpusResolver resolver;
+	const auto blob = resolver.find_blob("lib" + name + ".so");
+	if (!blob) return state.SkipWithError("corpus module not built");
+
+	tldr::LoadStats stats;
+	tldr::LoadOptions options;
+	options.stats = &stats;
+	options.trim_after_load = variant == LoadVariant::Trimmed;
+	tldr::RelocationPlanCache plans;
+	if (variant == LoadVariant::Planned) {
+		options.relocation_plans = &plans;
+		tldr::load_from_memory(blob->data(), blob->size(), resolver, options);
+		stats = {};
+	}
+	for (auto _ : state) {
+		const auto module = tldr::load_from_memory(blob->data(), blob->size(),
+		                                           resolver, options);
+		benchmark::DoNotOptimize(module.get());
+	}
+	state.SetBytesProcessed(state.iterations() * blob->size());
+	report_load_stats(state, stats);
+}
+
+void BM_ModulePoolCheckout(benchmark::State & state, const std::string & name)
+{
+	const CorpusResolver resolver;
+	const auto blob = resolver.find_blob("lib" + name + ".so");
+	if (!blob) return state.SkipWithError("corpus module not built");
+
+	tldr::ModulePool pool { blob->data(), blob->size(), 1, resolver };
+	for (auto _ : state) {
+		auto module = pool.acquire();
+		benchmark::DoNotOptimize(module.get());
+		module.reset();
+	}
+	state.counters["loads"] = pool.loads();
+	state.counters["restored_B"] = pool.bytes_restored() / static_cast<double>(state.iterations());
+}
+
+/*
+	Latency of the first call into each of a spread of procedures, right
+	after loading. Images are loaded with share_pages so their text is
+	mapped from the shared copy rather than written by the loader, which
+	leaves it unfaulted unless the populate policy faults it in. The profile
+	variant records a profile from one warm-up load first.
+ */
+void BM_FirstCall(benchmark::State & state, tldr::PopulatePolicy policy)
+{
+	std::ifstream ifs { TLDR_BENCH_MODULE_DIR "/libexports_10000.so", std::ios::binary };
+	const std::vector<char> blob { std::istreambuf_iterator<char>(ifs),
+	                               std::istreambuf_iterator<char>() };
+	if (blob.empty()) return state.SkipWithError("module not built");
+
+	std::vector<std::string> names;
+	for (int i = 0; i < 10000; i += 10000 / 64)
+		names.push_back("bench_proc_" + std::to_string(i));
+	tldr::LoadStats stats;
+	tldr::LoadOptions options;
+	options.stats = &stats;
+	options.share_pages = true;
+	options.populate = policy;
+	options.hot_symbols = names;
+
+	char profile_dir[] = "/tmp/tldr-bench-profiles-XXXXXX";
+	std::unique_ptr<tldr::PageProfileStore> profiles;
+	if (policy == tldr::PopulatePolicy::Profile) {
+		if (!mkdtemp(profile_dir)) return state.SkipWithError("mkdtemp failed");
+		profiles.reset(new tldr::PageProfileStore { profile_dir });
+		options.page_profiles = profiles.get();
+		const auto module = tldr::load_from_memory(blob.data(), blob.size(),
+		                                           tldr::system_loader, options);
+		for (const auto & name : names)
+			benchmark::DoNotOptimize(module->get_proc<int()>(name)());
+		profiles->flush();
+		stats = {};
+	}
+
+	std::vector<double> latencies;
+	for (auto _ : state) {
+		state.PauseTiming();
+		auto module = tldr::load_from_memory(blob.data(), blob.size(),
+		                                     tldr::system_loader, options);
+		std::vector<int (*)()> procs;
+		for (const auto & name : names)
+			procs.push_back(module->get_proc<int()>(name));
+		state.ResumeTiming();
+		for (const auto proc : procs) {
+			const auto start = std::chrono::steady_clock::now();
+			benchmark::DoNotOptimize(proc());
+			latencies.push_back(std::chrono::duration<double, std::nano>(
+				std::chrono::steady_clock::now() - start).count());
+		}
+		state.PauseTiming();
+		module.reset();
+		state.ResumeTiming();
+	}
+	std::sort(latencies.begin(), latencies.end());
+	state.counters["p50_ns"] = latencies[latencies.size() / 2];
+	state.counters["p99_ns"] = latencies[latencies.size() * 99 / 100];
+	state.counters["populate_us"] = seconds(stats.phase(tldr::LoadPhase::Populate).wall_time)
+	                              * 1e6 / state.iterations();
+	state.counters["populated_kb"] = stats.bytes_populated / 1024.0 / state.iterations();
+
+	if (profiles) {
+		profiles.reset();
+		if (const auto dir = opendir(profile_dir)) {
+			while (const auto entry = readdir(dir))
+				if (entry->d_name[0] != '.')
+					std::remove((std::string(profile_dir) + "/" + entry->d_name).c_str());
+			closedir(dir);
+		}
+		rmdir(profile_dir);
+	}
+}
+
+BENCHMARK_CAPTURE(BM_FirstCall, none, tldr::PopulatePolicy::None)->Iterations(200);
+BENCHMARK_CAPTURE(BM_FirstCall, full, tldr::PopulatePolicy::Full)->Iterations(200);
+BENCHMARK_CAPTURE(BM_FirstCall, hot_set, tldr::PopulatePolicy::HotSet)->Iterations(200);
+BENCHMARK_CAPTURE(BM_FirstCall, profile, tldr::PopulatePolicy::Profile)->Iterations(200);
+
+const bool corpus_registered = [] {
+	std::istringstream names { TLDR_BENCH_CORPUS };
+	std::string name;
+	while (std::getline(names, name, ';')) {
+		const auto bench_name = "BM_LoadFromMemory/" + name;
+		benchmark::RegisterBenchmark(bench_name.c_str(), BM_LoadFromMemory, name, LoadVariant::Plain)
+			->Unit(benchmark::kMicrosecond);
+		const auto trim_name = "BM_LoadFromMemoryTrimmed/" + name;
+		benchmark::RegisterBenchmark(trim_name.c_str(), BM_LoadFromMemory, name, LoadVariant::Trimmed)
+			->Unit(benchmark::kMicrosecond);
+		const auto planned_name = "BM_LoadFromMemoryPlanned/" + name;
+		benchmark::RegisterBenchmark(planned_name.c_str(), BM_LoadFromMemory, name, LoadVariant::Planned)
+			->Unit(benchmark::kMicrosecond);
+		const auto pool_name = "BM_ModulePoolCheckout/" + name;
+		benchmark::RegisterBenchmark(pool_name.c_str(), BM_ModulePoolCheckout, name)
+			->Unit(benchmark::kMicrosecond);
+	}
+	return true;
+}();
+
+}
@@ -0,0 +1,232 @@
+#include <config.h>
+#include <benchmark/benchmark.h>
+#include <tldr/lib_module.hpp>
+#include <tldr/loader.hpp>
+#include <tldr/module.hpp>
+#include <tldr/raw_module.hpp>
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+const long export_counts[] = { 10, 100, 1000, 10000, 100000 };
+const std::size_t lookup_names = 1024;
+
+std::string module_path(long exports)
+{
+	return TLDR_BENCH_MODULE_DIR "/libexports_" + std::to_string(exports) + ".so";
+}
+
+std::vector<char> read_file(const std::string & path)
+{
+	std::ifstream ifs { path, std::ios::binary };
+	if (!ifs) throw std::runtime_error("cannot open " + path);
+	return { std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>() };
+}
+
+std::vector<std::string> symbol_names(const char * prefix, long exports, bool hit)
+{
+	std::mt19937 rng { 42 };
+	std::uniform_int_distribution<long> pick { 0, exports - 1 };
+	std::vector<std::string> names;
+	for (std::size_t i = 0; i < lookup_names; ++i) {
+		const auto index = hit ? pick(rng) : exports + pick(rng);
+		names.push_back(prefix + std::to_string(index));
+	}
+	return names;
+}
+
+struct LibModuleBackend
+{
+	explicit LibModuleBackend(long exports)
+		: module_ { module_path(exports) } {}
+
+	tldr::fn_ptr_t proc(const std::string & name) const { return module_.get_raw_proc(name); }
+	tldr::data_ptr_t data(const std::string & name) const { return module_.get_raw_data(name); }
+	const tldr::Module & module() const { return module_; }
+
+	tldr::LibModule module_;
+};
+
+struct ElfModuleBackend
+{
+	explicit ElfModuleBackend(long exports)
+	{
+		const auto blob = read_file(module_path(exports));
+		module_ = tldr::load_from_memory(blob.data(), blob.size());
+		if (!module_) throw std::runtime_error("load_from_memory failed");
+	}
+
+	tldr::fn_ptr_t proc(const std::string & name) const { return module_->get_raw_proc(name); }
+	tldr::data_ptr_t data(const std::string & name) const { return module_->get_raw_data(name); }
+	const tldr::Module & module() const { return *module_; }
+
+	std::shared_ptr<tldr::Module> module_;
+};
+
+struct DlsymBackend
+{
+	explicit DlsymBackend(long exports)
+		: handle_ { dlopen(module_path(exports).c_str(), RTLD_NOW) }
+	{
+		if (!handle_) throw std::runtime_error(dlerror());
+	}
+
+	~DlsymBackend() { dlclose(handle_); }
+
+	void * proc(const std::string & name) const { return dlsym(handle_, name.c_str()); }
+	void * data(const std::string & name) const { return dlsym(handle_, name.c_str()); }
+
+	void * handle_;
+};
+
+template <class Backend>
+const Backend & backend_for(long exports)
+{
+	static std::map<long, std::unique_ptr<Backend>> backends;
+	auto & backend = backends[exports];
+	if (!backend) backend.reset(new Backend(exports));
+	return *backend;
+}
+
+using tldr::SymbolKind;
+
+template <class Backend>
+void BM_GetRawSymbol(benchmark::State & state, SymbolKind kind, bool hit)
+{
+	const auto exports = state.range(0);
+	const auto & backend = backend_for<Backend>(exports);
+	const auto prefix = kind == SymbolKind::Proc ? "bench_proc_" : "bench_data_";
+	const auto names = symbol_names(prefix, exports, hit);
+	std::size_t i = 0;
+	for (auto _ : state) {
+		if (kind == SymbolKind::Proc)
+			benchmark::DoNotOptimize(backend.proc(names[i]));
+		else
+			benchmark::DoNotOptimize(backend.data(names[i]));
+		if (++i == names.size()) i = 0;
+	}
+	state.SetItemsProcessed(state.iterations());
+	state.counters["exports"] = exports;
+}
+
+void BM_LibModule(benchmark::State & state, SymbolKind kind, bool hit)
+{
+	BM_GetRawSymbol<LibModuleBackend>(state, kind, hit);
+}
+
+void BM_ElfModule(benchmark::State & state, SymbolKind kind, bool hit)
+{
+	BM_GetRawSymbol<ElfModuleBackend>(state, kind, hit);
+}
+
+void BM_Dlsym(benchmark::State & state, SymbolKind kind, bool hit)
+{
+	BM_GetRawSymbol<DlsymBackend>(state, kind, hit);
+}
+
+template <class Backend>
+void BM_FindSymbols(benchmark::State & state, bool hit)
+{
+	const auto exports = state.range(0);
+	const auto & backend = backend_for<Backend>(exports);
+	const auto names = symbol_names("bench_proc_", exports, hit);
+	const std::vector<SymbolKind> kinds(names.size(), SymbolKind::Proc);
+	std::vector<void *> addresses(names.size());
+	for (auto _ : state) {
+		backend.module().find_symbols(names.data(), kinds.data(), names.size(),
+		                              addresses.data());
+		benchmark::DoNotOptimize(addresses.data());
+	}
+	state.SetItemsProcessed(state.iterations() * names.size());
+	state.counters["exports"] = exports;
+}
+
+void BM_LibModuleBatch(benchmark::State & state, bool hit)
+{
+	BM_FindSymbols<LibModuleBackend>(state, hit);
+}
+
+void BM_ElfModuleBatch(benchmark::State & state, bool hit)
+{
+	BM_FindSymbols<ElfModuleBackend>(state, hit);
+}
+
+void export_count_args(benchmark::internal::Benchmark * bench)
+{
+	for (const auto count : export_counts)
+		bench->Arg(count);
+}
+
+class NullModule final : public tldr::Module
+{
+public:
+	virtual tldr::fn_ptr_t get_raw_proc(const std::string &) const override { return nullptr; }
+	virtual tldr::data_ptr_t get_raw_data(const std::string &) const override { return nullptr; }
+};
+
+const int loader_module_count = 64;
+
+struct LoaderFixture
+{
+	LoaderFixture()
+	{
+		for (int i = 0; i < loader_module_count; ++i) {
+			names.push_back("module_" + std::to_string(i));
+			modules.push_back(std::make_shared<NullModule>());
+			loader.set_module(names.back(), modules.back());
+		}
+	}
+
+	tldr::Loader loader;
+	std::vector<std::string> names;
+	std::vector<std::shared_ptr<tldr::Module>> modules;
+};
+
+void BM_LoaderGetModule(benchmark::State & state)
+{
+	static LoaderFixture fixture;
+	std::size_t i = state.thread_index();
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(fixture.loader.get_module(fixture.names[i]));
+		if (++i == fixture.names.size()) i = 0;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+}
+
+BENCHMARK_CAPTURE(BM_LibModule, proc_hit, SymbolKind::Proc, true)->Apply(export_count_args);
+BENCHMARK_CAPTURE(BM_LibModule, proc_miss, SymbolKind::Proc, false)->Apply(export_count_args);
+BENCHMARK_CAPTURE(BM_LibModule, data_hit, SymbolKind::Data, true)->Apply(export_count_args);
+BENCHMARK_CAPTURE(BM_LibModule, data_miss, SymbolKind::Data, false)->Apply(export_count_args);
+
+BENCHMARK_CAPTURE(BM_ElfModule, proc_hit, SymbolKind::Proc, true)->Apply(export_count_args);
+BENCHMARK_CAPTURE(BM_ElfModule, proc_miss, SymbolKind::Proc, false)->Apply(export_count_args);
+BENCHMARK_CAPTURE(BM_ElfModule, data_hit, SymbolKind::Data, true)->Apply(export_count_args);
+BENCHMARK_CAPTURE(BM_ElfModule, data_miss, SymbolKind::Data, false)->Apply(export_count_args);
+
+BENCHMARK_CAPTURE(BM_LibModuleBatch, proc_hit, true)->Apply(export_count_args);
+BENCHMARK_CAPTURE(BM_LibModuleBatch, proc_miss, false)->Apply(export_count_args);
+
+BENCHMARK_CAPTURE(BM_ElfModuleBatch, proc_hit, true)->Apply(export_count_args);
+BENCHMARK_CAPTURE(BM_ElfModuleBatch, proc_miss, false)->Apply(export_count_args);
+
+BENCHMARK_CAPTURE(BM_Dlsym, proc_hit, SymbolKind::Proc, true)->Apply(export_count_args);
+BENCHMARK_CAPTURE(BM_Dlsym, proc_miss, SymbolKind::Proc, false)->Apply(export_count_args);
+BENCHMARK_CAPTURE(BM_Dlsym, data_hit, SymbolKind::Data, true)->Apply(export_count_args);
+BENCHMARK_CAPTURE(BM_Dlsym, data_miss, SymbolKind::Data, false)->Apply(export_count_args);
+
+BENCHMARK(BM_LoaderGetModule)->ThreadRange(1, 64)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -3,3 +3,9 @@
 
 #cmakedefine TLDR_HAS_PE32_SUPPORT
 #cmakedefine TLDR_HAS_PE64_SUPPORT
+
+#cmakedefine TLDR_INTERPOSE_DL_ITERATE_PHDR
+
+#cmakedefine TLDR_HAS_MEMFD_CREATE
+
+#cmakedefine TLDR_HAS_SWAPPABLE_MODULE
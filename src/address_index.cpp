@@ -0,0 +1,238 @@
+#include <config.h>
+#include "address_index.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tldr {
+
+namespace {
+
+struct AddressInterval
+{
+	std::uintptr_t begin;
+	std::uintptr_t end;
+	ModuleInfo info;
+	const AddressSymbols * symbols;
+	ImageHeaders headers;
+};
+
+struct AddressSnapshot
+{
+	std::vector<AddressInterval> intervals;
+};
+
+/*
+	Readers never block: each pins the epoch it started in by claiming a
+	reader slot, then reads whatever snapshot is current. Writers publish a
+	copy of the snapshot, advance the epoch and retire the old copy, which
+	is freed once no slot pins an earlier epoch. Readers that start after a
+	publish pin the new epoch, so writers never wait on them, and claiming a
+	slot is a single compare-and-swap, which signal handlers can do too.
+	When every slot is taken the lookup fails rather than spin, since a
+	signal handler could otherwise wait on the thread it interrupted.
+
+	Removing an image waits for the readers that may still see it, since the
+	module is destroyed once address_index_remove returns. Inserting does
+	not wait; its retired snapshot is freed by a later writer.
+ */
+
+const std::size_t reader_slot_count = 128;
+
+struct RetiredSnapshot
+{
+	std::unique_ptr<const AddressSnapshot> snapshot;
+	std::uint64_t epoch;
+};
+
+std::mutex writer_mutex;
+std::atomic<const AddressSnapshot *> current_snapshot { nullptr };
+std::atomic<std::uint64_t> snapshot_epoch { 1 };
+std::atomic<std::uint64_t> reader_slots[reader_slot_count];
+std::vector<RetiredSnapshot> retired_snapshots;
+std::atomic<unsigned long long> images_added { 0 };
+std::atomic<unsigned long long> images_removed { 0 };
+
+class SnapshotReader
+{
+public:
+	SnapshotReader() noexcept
+		: slot_ { claim_slot() }
+		, snapshot_ { slot_ ? current_snapshot.load() : nullptr } {}
+
+	~SnapshotReader()
+	{
+		if (slot_) slot_->store(0);
+	}
+
+	SnapshotReader(const SnapshotReader &) = delete;
+	SnapshotReader & operator=(const SnapshotReader &) = delete;
+
+	const AddressSnapshot * snapshot() const noexcept
+	{
+		return snapshot_;
+	}
+
+	const AddressInterval * find(std::uintptr_t addr) const noexcept
+	{
+		if (!snapshot_) return nullptr;
+		const auto & intervals = snapshot_->intervals;
+		const auto iter = std::upper_bound(intervals.begin(), intervals.end(), addr,
+			[] (std::uintptr_t addr, const AddressInterval & interval) {
+				return addr < interval.begin;
+			});
+		if (iter == intervals.begin()) return nullptr;
+		const auto & interval = *(iter - 1);
+		return addr < interval.end ? &interval : nullptr;
+	}
+
+private:
+	/* Makes a single pass over the slots; returns nullptr if all are held. */
+	static std::atomic<std::uint64_t> * claim_slot() noexcept
+	{
+		const auto epoch = snapshot_epoch.load();
+		for (auto & slot : reader_slots) {
+			std::uint64_t expected = 0;
+			if (slot.load(std::memory_order_relaxed) == 0
+			 && slot.compare_exchange_strong(expected, epoch))
+				return &slot;
+		}
+		return nullptr;
+	}
+
+	std::atomic<std::uint64_t> * slot_;
+	const AddressSnapshot * snapshot_;
+};
+
+std::uint64_t oldest_pinned_epoch() noexcept
+{
+	auto oldest = std::numeric_limits<std::uint64_t>::max();
+	for (const auto & slot : reader_slots) {
+		const auto epoch = slot.load();
+		if (epoch != 0) oldest = std::min(oldest, epoch);
+	}
+	return oldest;
+}
+
+std::unique_ptr<AddressSnapshot> copy_snapshot()
+{
+	std::unique_ptr<AddressSnapshot> snapshot { new AddressSnapshot };
+	if (const auto current = current_snapshot.load())
+		snapshot->intervals = current->intervals;
+	return snapshot;
+}
+
+/* Frees the retired snapshots no reader can still hold. */
+void reclaim_snapshots()
+{
+	const auto oldest = oldest_pinned_epoch();
+	retired_snapshots.erase(std::remove_if(retired_snapshots.begin(), retired_snapshots.end(),
+		[oldest] (const RetiredSnapshot & retired) { return retired.epoch <= oldest; }),
+		retired_snapshots.end());
+}
+
+/* Returns the epoch that readers of the replaced snapshot started before. */
+std::uint64_t publish_snapshot(std::unique_ptr<AddressSnapshot> snapshot)
+{
+	retired_snapshots.reserve(retired_snapshots.size() + 1);
+	std::unique_ptr<const AddressSnapshot> previous {
+		current_snapshot.exchange(snapshot.release())
+	};
+	const auto epoch = snapshot_epoch.fetch_add(1) + 1;
+	retired_snapshots.push_back({ std::move(previous), epoch });
+	reclaim_snapshots();
+	return epoch;
+}
+
+void wait_for_readers(std::uint64_t epoch)
+{
+	while (oldest_pinned_epoch() < epoch)
+		std::this_thread::yield();
+	reclaim_snapshots();
+}
+
+}
+
+AddressSymbols::~AddressSymbols() = default;
+
+void address_index_insert(const ModuleInfo & info, const AddressSymbols * symbols,
+                          const ImageHeaders & headers)
+{
+	const std::lock_guard<std::mutex> lock { writer_mutex };
+	auto snapshot = copy_snapshot();
+	const auto begin = reinterpret_cast<std::uintptr_t>(info.base);
+	const AddressInterval interval { begin, begin + info.size, info, symbols, headers };
+	auto & intervals = snapshot->intervals;
+	intervals.insert(std::upper_bound(intervals.begin(), intervals.end(), interval,
+		[] (const AddressInterval & lhs, const AddressInterval & rhs) {
+			return lhs.begin < rhs.begin;
+		}), interval);
+	publish_snapshot(std::move(snapshot));
+	++images_added;
+}
+
+void address_index_remove(const Module * module)
+{
+	const std::lock_guard<std::mutex> lock { writer_mutex };
+	auto snapshot = copy_snapshot();
+	auto & intervals = snapshot->intervals;
+	intervals.erase(std::remove_if(intervals.begin(), intervals.end(),
+		[module] (const AddressInterval & interval) {
+			return interval.info.module == module;
+		}), intervals.end());
+	wait_for_readers(publish_snapshot(std::move(snapshot)));
+	++images_removed;
+}
+
+ImageCounters address_index_counters() noexcept
+{
+	return { images_added.load(), images_removed.load() };
+}
+
+bool address_index_find(const void * addr, ModuleInfo & info,
+                        ImageHeaders & headers) noexcept
+{
+	const SnapshotReader reader;
+	const auto interval = reader.find(reinterpret_cast<std::uintptr_t>(addr));
+	if (!interval) return false;
+	info = interval->info;
+	headers = interval->headers;
+	return true;
+}
+
+int address_index_visit(ImageVisitor visitor, void * data)
+{
+	const SnapshotReader reader;
+	if (!reader.snapshot()) return 0;
+	for (const auto & interval : reader.snapshot()->intervals) {
+		if (const int result = visitor(interval.info, interval.headers, data))
+			return result;
+	}
+	return 0;
+}
+
+bool find_module(const void * addr, ModuleInfo & info) noexcept
+{
+	const SnapshotReader reader;
+	const auto interval = reader.find(reinterpret_cast<std::uintptr_t>(addr));
+	if (!interval) return false;
+	info = interval->info;
+	return true;
+}
+
+bool find_symbol(const void * addr, SymbolInfo & info) noexcept
+{
+	const SnapshotReader reader;
+	const auto interval = reader.find(reinterpret_cast<std::uintptr_t>(addr));
+	if (!interval || !interval->symbols) return false;
+	info.module = interval->info;
+	return interval->symbols->find_symbol(reinterpret_cast<std::uintptr_t>(addr), info);
+}
+
+}
@@ -0,0 +1,64 @@
+#ifndef TLDR_SRC_ADDRESSINDEX_HPP_
+#define TLDR_SRC_ADDRESSINDEX_HPP_
+
+#include <tldr/address_index.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tldr {
+
+class AddressSymbols
+{
+public:
+	virtual ~AddressSymbols();
+	virtual bool find_symbol(std::uintptr_t addr, SymbolInfo & info) const noexcept = 0;
+};
+
+struct ImageHeaders
+{
+	std::uintptr_t load_bias = 0;
+	const void * phdrs = nullptr;
+	std::size_t phnum = 0;
+	const void * eh_frame_hdr = nullptr;
+};
+
+struct ImageCounters
+{
+	unsigned long long adds;
+	unsigned long long subs;
+};
+
+void address_index_insert(const ModuleInfo & info, const AddressSymbols * symbols,
+                          const ImageHeaders & headers = {});
+void address_index_remove(const Module * module);
+
+ImageCounters address_index_counters() noexcept;
+
+bool address_index_find(const void * addr, ModuleInfo & info,
+                        ImageHeaders & headers) noexcept;
+
+/*
+	Calls fn(info, headers) for each registered image until it returns
+	nonzero. Images cannot be removed from inside fn.
+ */
+template <typename Fn>
+int address_index_for_each(Fn && fn);
+
+typedef int (* ImageVisitor)(const ModuleInfo & info, const ImageHeaders & headers,
+                             void * data);
+
+int address_index_visit(ImageVisitor visitor, void * data);
+
+template <typename Fn>
+int address_index_for_each(Fn && fn)
+{
+	return address_index_visit([] (const ModuleInfo & info, const ImageHeaders & headers,
+	                               void * data) {
+		return (*static_cast<Fn *>(data))(info, headers);
+	}, &fn);
+}
+
+}
+
+#endif
@@ -0,0 +1,269 @@
+#include <config.h>
+#include <tldr/async_load.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace tldr {
+
+class LoadJob
+{
+public:
+	enum State { Queued, Running, Cancelled, Done };
+
+	LoadJob(std::function<std::shared_ptr<Module> ()> load, const AsyncLoadOptions & options,
+	        std::weak_ptr<LoadExecutor::State> executor, std::uint64_t sequence);
+
+	bool start();
+	void run();
+	bool cancel();
+	void fail(std::exception_ptr error);
+	bool cancelled() const;
+
+public:
+	const LoadPriority priority;
+	const std::uint64_t sequence;
+	std::shared_future<std::shared_ptr<Module>> result;
+
+private:
+	void complete(std::shared_ptr<Module> module, std::exception_ptr error);
+
+	std::function<std::shared_ptr<Module> ()> load_;
+	LoadCallback on_complete_;
+	std::weak_ptr<LoadExecutor::State> executor_;
+	std::promise<std::shared_ptr<Module>> promise_;
+	std::atomic<int> state_;
+};
+
+LoadJob::LoadJob(std::function<std::shared_ptr<Module> ()> load,
+                 const AsyncLoadOptions & options,
+                 std::weak_ptr<LoadExecutor::State> executor, std::uint64_t sequence)
+	: priority { options.priority }
+	, sequence { sequence }
+	, load_ { std::move(load) }
+	, on_complete_ { options.on_complete }
+	, executor_ { std::move(executor) }
+	, state_ { Queued }
+{
+	result = promise_.get_future().share();
+}
+
+/* Called by a worker, under the queue lock, to claim a job it popped. */
+bool LoadJob::start()
+{
+	int expected = Queued;
+	return state_.compare_exchange_strong(expected, Running);
+}
+
+void LoadJob::run()
+{
+	std::shared_ptr<Module> module;
+	std::exception_ptr error;
+	try {
+		module = load_();
+	} catch (...) {
+		error = std::current_exception();
+	}
+	state_ = Done;
+	complete(std::move(module), error);
+}
+
+void LoadJob::fail(std::exception_ptr error)
+{
+	int expected = Queued;
+	if (state_.compare_exchange_strong(expected, Done))
+		complete(nullptr, error);
+}
+
+void LoadJob::complete(std::shared_ptr<Module> module, std::exception_ptr error)
+{
+	load_ = nullptr;
+	if (error)
+		promise_.set_exception(error);
+	else
+		promise_.set_value(module);
+	if (on_complete_) {
+		try {
+			on_complete_(std::move(module), error);
+		} catch (...) {
+			/* the result is already delivered through the future */
+		}
+		on_complete_ = nullptr;
+	}
+}
+
+bool LoadJob::cancelled() const
+{
+	return state_ == Cancelled;
+}
+
+LoadHandle::LoadHandle(std::shared_ptr<LoadJob> job) : job_ { std::move(job) } {}
+
+std::shared_future<std::shared_ptr<Module>> LoadHandle::future() const
+{
+	return job_->result;
+}
+
+std::shared_ptr<Module> LoadHandle::get() const
+{
+	return job_->result.get();
+}
+
+bool LoadHandle::cancel()
+{
+	return job_->cancel();
+}
+
+namespace {
+
+struct JobOrder
+{
+	bool operator()(const std::shared_ptr<LoadJob> & lhs, const std::shared_ptr<LoadJob> & rhs) const
+	{
+		if (lhs->priority != rhs->priority)
+			return lhs->priority < rhs->priority;
+		return lhs->sequence > rhs->sequence;
+	}
+};
+
+}
+
+struct LoadExecutor::State
+{
+	std::size_t max_queued;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	std::priority_queue<std::shared_ptr<LoadJob>, std::vector<std::shared_ptr<LoadJob>>, JobOrder> queue;
+	std::size_t cancelled = 0;
+	std::uint64_t next_sequence = 0;
+	bool stopping = false;
+	std::vector<std::thread> workers;
+
+	std::size_t waiting() const;
+	void prune();
+	void work();
+};
+
+/* Cancelled jobs stay in the queue until popped, but no longer count. */
+std::size_t LoadExecutor::State::waiting() const
+{
+	return queue.size() - cancelled;
+}
+
+/* Drops cancelled jobs once they make up half the queue. */
+void LoadExecutor::State::prune()
+{
+	if (cancelled == 0 || cancelled < queue.size() / 2) return;
+	decltype(queue) kept;
+	for (; !queue.empty(); queue.pop()) {
+		if (!queue.top()->cancelled()) kept.push(queue.top());
+	}
+	queue.swap(kept);
+	cancelled = 0;
+}
+
+void LoadExecutor::State::work()
+{
+	for (;;) {
+		std::shared_ptr<LoadJob> job;
+		{
+			std::unique_lock<std::mutex> lock { mutex };
+			wakeup.wait(lock, [this] { return stopping || !queue.empty(); });
+			if (stopping) return;
+			job = queue.top();
+			queue.pop();
+			if (!job->start()) {
+				--cancelled;
+				continue;
+			}
+		}
+		job->run();
+	}
+}
+
+LoadExecutor::LoadExecutor(std::size_t threads, std::size_t max_queued)
+	: state_ { std::make_shared<State>() }
+{
+	state_->max_queued = max_queued;
+	for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); ++i)
+		state_->workers.emplace_back([state = state_.get()] { state->work(); });
+}
+
+LoadExecutor::~LoadExecutor()
+{
+	std::vector<std::shared_ptr<LoadJob>> pending;
+	{
+		std::lock_guard<std::mutex> lock { state_->mutex };
+		state_->stopping = true;
+		for (; !state_->queue.empty(); state_->queue.pop())
+			pending.push_back(state_->queue.top());
+	}
+	state_->wakeup.notify_all();
+	for (auto & worker : state_->workers)
+		worker.join();
+	for (const auto & job : pending)
+		job->cancel();
+}
+
+LoadHandle LoadExecutor::submit(std::function<std::shared_ptr<Module> ()> load,
+                                const AsyncLoadOptions & options)
+{
+	std::unique_lock<std::mutex> lock { state_->mutex };
+	const auto job = std::make_shared<LoadJob>(std::move(load), options, state_,
+	                                           state_->next_sequence++);
+	state_->prune();
+	if (state_->waiting() >= state_->max_queued) {
+		lock.unlock();
+		job->fail(std::make_exception_ptr(LoadQueueFullError("load queue is full")));
+		return LoadHandle { job };
+	}
+	state_->queue.push(job);
+	lock.unlock();
+	state_->wakeup.notify_one();
+	return LoadHandle { job };
+}
+
+std::size_t LoadExecutor::queued() const
+{
+	std::lock_guard<std::mutex> lock { state_->mutex };
+	return state_->waiting();
+}
+
+/*
+	Takes the queue lock so a worker never pops the job between the state
+	change and the count; jobs the destructor already took out of the
+	queue are no longer counted.
+ */
+bool LoadJob::cancel()
+{
+	if (const auto executor = executor_.lock()) {
+		std::lock_guard<std::mutex> lock { executor->mutex };
+		int expected = Queued;
+		if (!state_.compare_exchange_strong(expected, Cancelled)) return false;
+		if (!executor->stopping) ++executor->cancelled;
+	} else {
+		int expected = Queued;
+		if (!state_.compare_exchange_strong(expected, Cancelled)) return false;
+	}
+	complete(nullptr, std::make_exception_ptr(LoadCancelledError("load cancelled")));
+	return true;
+}
+
+LoadHandle load_from_memory_async(LoadExecutor & executor,
+                                  const void * mem, std::size_t size,
+                                  const ModuleResolver & resolver,
+                                  const LoadOptions & options,
+                                  const AsyncLoadOptions & async_options)
+{
+	return executor.submit([mem, size, &resolver, options] {
+		return load_from_memory(mem, size, resolver, options);
+	}, async_options);
+}
+
+}
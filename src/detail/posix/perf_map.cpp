@@ -0,0 +1,227 @@
+#include <config.h>
+#include "../../perf_map.hpp"
+
+#include <tldr/raw_module.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include <system_error>
+
+namespace tldr {
+
+namespace {
+
+const std::uint32_t jitdump_magic = 0x4a695444;
+const std::uint32_t jitdump_version = 1;
+const std::uint32_t jit_code_load = 0;
+const std::uint32_t jit_code_close = 3;
+
+struct JitDumpHeader
+{
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint32_t total_size;
+	std::uint32_t elf_mach;
+	std::uint32_t pad1;
+	std::uint32_t pid;
+	std::uint64_t timestamp;
+	std::uint64_t flags;
+};
+
+struct JitDumpRecordHeader
+{
+	std::uint32_t id;
+	std::uint32_t total_size;
+	std::uint64_t timestamp;
+};
+
+struct JitDumpCodeLoad
+{
+	JitDumpRecordHeader header;
+	std::uint32_t pid;
+	std::uint32_t tid;
+	std::uint64_t vma;
+	std::uint64_t code_addr;
+	std::uint64_t code_size;
+	std::uint64_t code_index;
+};
+
+std::uint64_t monotonic_timestamp()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return std::uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+std::uint32_t current_tid()
+{
+#ifdef SYS_gettid
+	return static_cast<std::uint32_t>(syscall(SYS_gettid));
+#else
+	return static_cast<std::uint32_t>(getpid());
+#endif
+}
+
+void write_all(int fd, const void * data, std::size_t size)
+{
+	auto bytes = static_cast<const char *>(data);
+	while (size != 0) {
+		const auto written = write(fd, bytes, size);
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			throw std::system_error(errno, std::system_category());
+		}
+		bytes += written;
+		size -= written;
+	}
+}
+
+/*
+	perf picks the jitdump file up from the mmap event of its marker mapping,
+	so the first page stays mapped executable for the life of the process.
+	The file goes in $JITDUMPDIR, or /tmp, and is never opened through a
+	symlink or over an existing file.
+
+	jitdump has no record for unloading code. An unloaded image is only
+	tombstoned in the perf map; in the jitdump its symbols stay valid until a
+	later code load record reuses the addresses. JIT_CODE_CLOSE is written
+	once, at exit.
+ */
+
+class PerfWriter
+{
+public:
+	~PerfWriter()
+	{
+		if (jitdump_ < 0) return;
+		JitDumpRecordHeader record {};
+		record.id = jit_code_close;
+		record.total_size = sizeof(record);
+		record.timestamp = monotonic_timestamp();
+		try {
+			write_all(jitdump_, &record, sizeof(record));
+		} catch (...) {
+		}
+		close(jitdump_);
+		jitdump_ = -1;
+	}
+
+	void write_map(const std::string & line)
+	{
+		const std::lock_guard<std::mutex> lock { mutex_ };
+		if (!map_) {
+			const auto path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+			map_ = std::fopen(path.c_str(), "a");
+			if (!map_) throw std::system_error(errno, std::system_category());
+		}
+		std::fputs(line.c_str(), map_);
+		std::fflush(map_);
+	}
+
+	void write_code_load(const PerfImage & image, const PerfSymbol & symbol)
+	{
+		const std::lock_guard<std::mutex> lock { mutex_ };
+		if (jitdump_ < 0) open_jitdump(image.machine);
+		JitDumpCodeLoad record {};
+		record.header.id = jit_code_load;
+		record.header.total_size = sizeof(record) + symbol.name.size() + 1 + symbol.size;
+		record.header.timestamp = monotonic_timestamp();
+		record.pid = static_cast<std::uint32_t>(getpid());
+		record.tid = current_tid();
+		record.vma = symbol.address;
+		record.code_addr = symbol.address;
+		record.code_size = symbol.size;
+		record.code_index = code_index_++;
+		write_all(jitdump_, &record, sizeof(record));
+		write_all(jitdump_, symbol.name.c_str(), symbol.name.size() + 1);
+		write_all(jitdump_, reinterpret_cast<const void *>(symbol.address), symbol.size);
+	}
+
+private:
+	void open_jitdump(unsigned int machine)
+	{
+		const auto dir = std::getenv("JITDUMPDIR");
+		const auto path = std::string { dir && *dir ? dir : "/tmp" }
+		                + "/jit-" + std::to_string(getpid()) + ".dump";
+		const int fd = open(path.c_str(), O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC | O_RDWR, 0644);
+		if (fd < 0) throw std::system_error(errno, std::system_category());
+		JitDumpHeader header {};
+		header.magic = jitdump_magic;
+		header.version = jitdump_version;
+		header.total_size = sizeof(header);
+		header.elf_mach = machine;
+		header.pid = static_cast<std::uint32_t>(getpid());
+		header.timestamp = monotonic_timestamp();
+		try {
+			write_all(fd, &header, sizeof(header));
+		} catch (...) {
+			close(fd);
+			throw;
+		}
+		const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+		const auto marker = mmap(nullptr, page_size, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+		if (marker == MAP_FAILED) {
+			const auto error = errno;
+			close(fd);
+			throw std::system_error(error, std::system_category());
+		}
+		jitdump_ = fd;
+	}
+
+private:
+	std::mutex mutex_;
+	std::FILE * map_ = nullptr;
+	int jitdump_ = -1;
+	std::uint64_t code_index_ = 0;
+};
+
+PerfWriter & perf_writer()
+{
+	static PerfWriter writer;
+	return writer;
+}
+
+std::string perf_map_line(std::uintptr_t address, std::size_t size, const std::string & name)
+{
+	char prefix[64];
+	std::snprintf(prefix, sizeof(prefix), "%zx %zx ",
+	              static_cast<std::size_t>(address), size);
+	return prefix + name + "\n";
+}
+
+}
+
+void perf_map_load(const PerfImage & image, const std::vector<PerfSymbol> & symbols,
+                   int outputs)
+{
+	auto & writer = perf_writer();
+	if (outputs & PerfOutputMap) {
+		std::string lines;
+		for (const auto & symbol : symbols)
+			lines += perf_map_line(symbol.address, symbol.size, symbol.name + " [" + image.name + "]");
+		writer.write_map(lines);
+	}
+	if (outputs & PerfOutputJitDump) {
+		for (const auto & symbol : symbols)
+			writer.write_code_load(image, symbol);
+	}
+}
+
+void perf_map_unload(const PerfImage & image, int outputs) noexcept
+{
+	if (!(outputs & PerfOutputMap)) return;
+	try {
+		perf_writer().write_map(perf_map_line(image.base, image.size, "[unloaded " + image.name + "]"));
+	} catch (...) {
+	}
+}
+
+}
@@ -0,0 +1,39 @@
+#include <config.h>
+#include "../../rusage.hpp"
+
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <cerrno>
+#include <system_error>
+
+namespace tldr {
+
+namespace {
+
+#ifdef RUSAGE_THREAD
+	const int rusage_who = RUSAGE_THREAD;
+#else
+	const int rusage_who = RUSAGE_SELF;
+#endif
+
+std::chrono::nanoseconds timeval_duration(const timeval & tv)
+{
+	return std::chrono::seconds(tv.tv_sec)
+	     + std::chrono::microseconds(tv.tv_usec);
+}
+
+}
+
+ResourceUsage thread_resource_usage()
+{
+	rusage usage;
+	if (getrusage(rusage_who, &usage) == -1)
+		throw std::system_error(errno, std::system_category());
+	return {
+		timeval_duration(usage.ru_utime) + timeval_duration(usage.ru_stime),
+		usage.ru_minflt, usage.ru_majflt
+	};
+}
+
+}
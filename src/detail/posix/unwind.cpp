@@ -0,0 +1,196 @@
+#include <config.h>
+#include "../../unwind.hpp"
+
+#include <tldr/unwind.hpp>
+
+#include "../../address_index.hpp"
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+extern "C" {
+
+void __register_frame(const void * begin) __attribute__((weak));
+void __deregister_frame(const void * begin) __attribute__((weak));
+void __register_frame_info(const void * begin, void * object);
+void * __deregister_frame_info(const void * begin);
+
+}
+
+namespace tldr {
+
+namespace {
+
+const unsigned char dw_eh_pe_omit = 0xff;
+
+/*
+	Storage for the unwinder's private struct object, which it links into
+	its registry; libgcc needs six words, the rest is headroom.
+ */
+struct FrameObject
+{
+	void * words[16];
+};
+
+bool read_encoded_pointer(const unsigned char *& data, unsigned char encoding,
+                          const unsigned char * data_base, std::uintptr_t & value)
+{
+	const auto field = data;
+	switch (encoding & 0x0f) {
+	case 0x00: { std::uintptr_t v; std::memcpy(&v, data, sizeof(v)); data += sizeof(v); value = v; break; }
+	case 0x02: { std::uint16_t v; std::memcpy(&v, data, sizeof(v)); data += sizeof(v); value = v; break; }
+	case 0x03: { std::uint32_t v; std::memcpy(&v, data, sizeof(v)); data += sizeof(v); value = v; break; }
+	case 0x04: { std::uint64_t v; std::memcpy(&v, data, sizeof(v)); data += sizeof(v); value = v; break; }
+	case 0x0a: { std::int16_t v; std::memcpy(&v, data, sizeof(v)); data += sizeof(v); value = v; break; }
+	case 0x0b: { std::int32_t v; std::memcpy(&v, data, sizeof(v)); data += sizeof(v); value = v; break; }
+	case 0x0c: { std::int64_t v; std::memcpy(&v, data, sizeof(v)); data += sizeof(v); value = v; break; }
+	default: return false;
+	}
+	switch (encoding & 0x70) {
+	case 0x00: break;
+	case 0x10: value += reinterpret_cast<std::uintptr_t>(field); break;
+	case 0x30: value += reinterpret_cast<std::uintptr_t>(data_base); break;
+	default: return false;
+	}
+	return true;
+}
+
+const void * eh_frame_from_hdr(const void * eh_frame_hdr)
+{
+	const auto hdr = static_cast<const unsigned char *>(eh_frame_hdr);
+	const unsigned char version = hdr[0];
+	const unsigned char eh_frame_ptr_enc = hdr[1];
+	if (version != 1 || eh_frame_ptr_enc == dw_eh_pe_omit) return nullptr;
+	auto data = hdr + 4;
+	std::uintptr_t eh_frame;
+	if (!read_encoded_pointer(data, eh_frame_ptr_enc, hdr, eh_frame)) return nullptr;
+	return reinterpret_cast<const void *>(eh_frame);
+}
+
+bool has_register_frame()
+{
+	return &__register_frame != nullptr && &__deregister_frame != nullptr;
+}
+
+typedef int (* DlIteratePhdr)(PhdrCallback callback, void * data);
+
+DlIteratePhdr system_iterate_phdr()
+{
+#ifdef TLDR_INTERPOSE_DL_ITERATE_PHDR
+	static const auto next = reinterpret_cast<DlIteratePhdr>(dlsym(RTLD_NEXT, "dl_iterate_phdr"));
+	return next;
+#else
+	return &::dl_iterate_phdr;
+#endif
+}
+
+struct SystemPhdrContext
+{
+	PhdrCallback callback;
+	void * data;
+	ImageCounters counters;
+};
+
+int forward_system_phdr(dl_phdr_info * info, std::size_t size, void * data)
+{
+	const auto context = static_cast<SystemPhdrContext *>(data);
+	dl_phdr_info adjusted;
+	std::memcpy(&adjusted, info, std::min(size, sizeof(adjusted)));
+	adjusted.dlpi_adds += context->counters.adds;
+	adjusted.dlpi_subs += context->counters.subs;
+	return context->callback(&adjusted, std::min(size, sizeof(adjusted)), context->data);
+}
+
+}
+
+/*
+	With the shim the unwinder reaches loaded images through _dl_find_object
+	(newer glibc and libgcc) or dl_iterate_phdr and uses their .eh_frame_hdr
+	search tables directly, so nothing is registered here. Otherwise .eh_frame
+	goes to __register_frame, which current libgcc indexes by address range
+	in a lock-free tree next to its _dl_find_object lookup. Unwinders
+	without it get __register_frame_info, whose objects are sorted on first
+	use and searched under a global lock.
+ */
+
+void * unwind_register_frames(const void * eh_frame_hdr)
+{
+#ifdef TLDR_INTERPOSE_DL_ITERATE_PHDR
+	(void) eh_frame_hdr;
+	return nullptr;
+#else
+	const auto eh_frame = eh_frame_from_hdr(eh_frame_hdr);
+	if (!eh_frame) return nullptr;
+	if (has_register_frame())
+		__register_frame(eh_frame);
+	else
+		__register_frame_info(eh_frame, new FrameObject {});
+	return const_cast<void *>(eh_frame);
+#endif
+}
+
+void unwind_deregister_frames(void * frames)
+{
+	if (!frames) return;
+	if (has_register_frame())
+		__deregister_frame(frames);
+	else
+		delete static_cast<FrameObject *>(__deregister_frame_info(frames));
+}
+
+int iterate_phdr(PhdrCallback callback, void * data)
+{
+	const auto counters = address_index_counters();
+	SystemPhdrContext context { callback, data, counters };
+	if (const auto iterate = system_iterate_phdr()) {
+		if (const int result = iterate(&forward_system_phdr, &context))
+			return result;
+	}
+	return address_index_for_each([&] (const ModuleInfo & module, const ImageHeaders & headers) {
+		dl_phdr_info info {};
+		info.dlpi_addr = headers.load_bias;
+		info.dlpi_name = module.name;
+		info.dlpi_phdr = static_cast<const ElfW(Phdr) *>(headers.phdrs);
+		info.dlpi_phnum = static_cast<ElfW(Half)>(headers.phnum);
+		info.dlpi_adds = counters.adds;
+		info.dlpi_subs = counters.subs;
+		return callback(&info, sizeof(info), data);
+	});
+}
+
+}
+
+#ifdef TLDR_INTERPOSE_DL_ITERATE_PHDR
+
+extern "C" TLDR_EXPORT int dl_iterate_phdr(tldr::PhdrCallback callback, void * data)
+{
+	return tldr::iterate_phdr(callback, data);
+}
+
+#ifdef DLFO_STRUCT_HAS_EH_DBASE
+
+extern "C" TLDR_EXPORT int _dl_find_object(void * address, dl_find_object * result)
+{
+	typedef int (* DlFindObject)(void *, dl_find_object *);
+	static const auto next = reinterpret_cast<DlFindObject>(dlsym(RTLD_NEXT, "_dl_find_object"));
+
+	tldr::ModuleInfo info;
+	tldr::ImageHeaders headers;
+	if (!tldr::address_index_find(address, info, headers))
+		return next ? next(address, result) : -1;
+	std::memset(result, 0, sizeof(*result));
+	result->dlfo_map_start = const_cast<void *>(info.base);
+	result->dlfo_map_end = static_cast<char *>(result->dlfo_map_start) + info.size;
+	result->dlfo_eh_frame = const_cast<void *>(headers.eh_frame_hdr);
+#if DLFO_STRUCT_HAS_EH_DBASE
+	result->dlfo_eh_dbase = nullptr;
+#endif
+	return 0;
+}
+
+#endif
+
+#endif
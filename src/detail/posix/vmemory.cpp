@@ -1,15 +1,43 @@
 #include <config.h>
 #include "../../vmemory.hpp"
 
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
+#include <atomic>
 #include <cerrno>
+#include <cstdint>
+#include <string>
 #include <system_error>
+#include <vector>
 
 namespace tldr {
 
 namespace {
 
+/*
+	Never displaces an existing mapping. Kernels before 4.17 ignore the flag
+	and treat the address as a hint, which is the fallback anyway.
+ */
+#ifdef MAP_FIXED_NOREPLACE
+const int map_preferred = MAP_FIXED_NOREPLACE;
+#else
+const int map_preferred = 0;
+#endif
+
+void * map_at(std::uintptr_t pref_base, std::size_t size, int prot, int flags, int fd)
+{
+	void * mem = MAP_FAILED;
+	if (pref_base)
+		mem = mmap(reinterpret_cast<void *>(pref_base), size, prot, flags | map_preferred, fd, 0);
+	if (mem == MAP_FAILED)
+		mem = mmap(nullptr, size, prot, flags, fd, 0);
+	if (mem == MAP_FAILED)
+		throw std::system_error(errno, std::system_category());
+	return mem;
+}
+
 int memory_access_flags(int access)
 {
 	int flags = PROT_NONE;
@@ -21,15 +49,15 @@ int memory_access_flags(int access)
 
 }
 
+std::size_t vmem_page_size()
+{
+	static const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	return page_size;
+}
+
 void * vmem_alloc(std::size_t size, std::uintptr_t pref_base, int access)
 {
-	const auto flags = MAP_PRIVATE | MAP_ANONYMOUS;
-	const auto access = memory_access_flags(access);
-	const auto mbase = reinterpret_cast<void *>(pref_base);
-	void * const mem = mmap(mbase, size, access, flags, -1, 0);
-	if (!mem)
-		throw std::system_error(errno, std::system_category());
-	return mem;
+	return map_at(pref_base, size, memory_access_flags(access), MAP_PRIVATE | MAP_ANONYMOUS, -1);
 }
 
 void vmem_protect(void * mem, std::size_t size, int new_access)
@@ -45,4 +73,108 @@ void vmem_free(void * mem, std::size_t size)
 		throw std::system_error(errno, std::system_category());
 }
 
+std::size_t vmem_resident_size(const void * mem, std::size_t size)
+{
+	const auto page_size = vmem_page_size();
+	std::vector<unsigned char> pages((size + page_size - 1) / page_size);
+	if (mincore(const_cast<void *>(mem), size, pages.data()) == -1)
+		throw std::system_error(errno, std::system_category());
+	std::size_t resident = 0;
+	for (const auto page : pages)
+		if (page & 1) resident += page_size;
+	return resident;
+}
+
+/*
+	Unlike mincore, which reports the page cache, /proc/self/pagemap says
+	whether this mapping has faulted a page in, so a page of a shared
+	object counts only once this process has touched it.
+ */
+std::vector<bool> vmem_mapped_pages(const void * mem, std::size_t size)
+{
+	const auto page_size = vmem_page_size();
+	const auto count = (size + page_size - 1) / page_size;
+	std::vector<bool> mapped(count);
+#ifdef __linux__
+	const int fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+	if (fd != -1) {
+		std::vector<std::uint64_t> entries(count);
+		const auto bytes = count * sizeof(entries[0]);
+		const auto offset = reinterpret_cast<std::uintptr_t>(mem) / page_size * sizeof(entries[0]);
+		const auto read = pread(fd, entries.data(), bytes, static_cast<off_t>(offset));
+		close(fd);
+		if (read == static_cast<ssize_t>(bytes)) {
+			for (std::size_t i = 0; i < count; ++i)
+				mapped[i] = (entries[i] >> 62) != 0;
+			return mapped;
+		}
+	}
+#endif
+	std::vector<unsigned char> pages(count);
+	if (mincore(const_cast<void *>(mem), size, pages.data()) == -1)
+		throw std::system_error(errno, std::system_category());
+	for (std::size_t i = 0; i < count; ++i)
+		mapped[i] = (pages[i] & 1) != 0;
+	return mapped;
+}
+
+void vmem_discard(void * mem, std::size_t size)
+{
+	if (madvise(mem, size, MADV_DONTNEED) == -1)
+		throw std::system_error(errno, std::system_category());
+}
+
+/*
+	MADV_POPULATE_READ maps every page in one call without dirtying it;
+	kernels before 5.14 reject it, so fall back to reading one byte a page.
+ */
+void vmem_populate(const void * mem, std::size_t size)
+{
+#ifdef MADV_POPULATE_READ
+	if (madvise(const_cast<void *>(mem), size, MADV_POPULATE_READ) == 0)
+		return;
+#endif
+	const auto page_size = vmem_page_size();
+	const auto bytes = static_cast<const volatile char *>(mem);
+	for (std::size_t offset = 0; offset < size; offset += page_size)
+		static_cast<void>(bytes[offset]);
+}
+
+vmem_object_t vmem_object_create(std::size_t size)
+{
+#ifdef TLDR_HAS_MEMFD_CREATE
+	const int fd = memfd_create("tldr-image", MFD_CLOEXEC);
+#else
+	static std::atomic<unsigned> counter { 0 };
+	const auto name = "/tldr-image-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+	const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd != -1) shm_unlink(name.c_str());
+#endif
+	if (fd == -1)
+		throw std::system_error(errno, std::system_category());
+	if (ftruncate(fd, static_cast<off_t>(size)) == -1) {
+		const int error = errno;
+		close(fd);
+		throw std::system_error(error, std::system_category());
+	}
+	return fd;
+}
+
+void vmem_object_close(vmem_object_t object)
+{
+	close(static_cast<int>(object));
+}
+
+void * vmem_object_map(vmem_object_t object, std::size_t size, bool copy_on_write,
+                       std::uintptr_t pref_base)
+{
+	const auto flags = copy_on_write ? MAP_PRIVATE : MAP_SHARED;
+	return map_at(pref_base, size, PROT_READ | PROT_WRITE, flags, static_cast<int>(object));
+}
+
+void vmem_object_unmap(void * mem, std::size_t size)
+{
+	vmem_free(mem, size);
+}
+
 }
@@ -0,0 +1,10 @@
+#include <config.h>
+#include "../../perf_map.hpp"
+
+namespace tldr {
+
+void perf_map_load(const PerfImage &, const std::vector<PerfSymbol> &, int) {}
+
+void perf_map_unload(const PerfImage &, int) {}
+
+}
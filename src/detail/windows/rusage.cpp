@@ -0,0 +1,40 @@
+#include <config.h>
+#include "../../rusage.hpp"
+
+#include <windows.h>
+#include <psapi.h>
+
+#include <system_error>
+
+namespace tldr {
+
+namespace {
+
+std::chrono::nanoseconds filetime_duration(const FILETIME & ft)
+{
+	ULARGE_INTEGER ticks;
+	ticks.LowPart = ft.dwLowDateTime;
+	ticks.HighPart = ft.dwHighDateTime;
+	return std::chrono::nanoseconds(ticks.QuadPart * 100);
+}
+
+}
+
+ResourceUsage thread_resource_usage()
+{
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time,
+	                    &kernel_time, &user_time))
+		throw std::system_error(GetLastError(), std::system_category());
+
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		throw std::system_error(GetLastError(), std::system_category());
+
+	return {
+		filetime_duration(kernel_time) + filetime_duration(user_time),
+		static_cast<long>(counters.PageFaultCount), 0
+	};
+}
+
+}
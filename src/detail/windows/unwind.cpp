@@ -0,0 +1,13 @@
+#include <config.h>
+#include "../../unwind.hpp"
+
+namespace tldr {
+
+void * unwind_register_frames(const void *)
+{
+	return nullptr;
+}
+
+void unwind_deregister_frames(void *) {}
+
+}
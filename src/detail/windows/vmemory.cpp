@@ -2,8 +2,11 @@
 #include "../../vmemory.hpp"
 
 #include <windows.h>
+#include <psapi.h>
 
+#include <algorithm>
 #include <system_error>
+#include <vector>
 
 namespace tldr {
 
@@ -30,6 +33,16 @@ DWORD memory_access_flags(int access)
 
 }
 
+std::size_t vmem_page_size()
+{
+	static const auto page_size = [] {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return static_cast<std::size_t>(info.dwPageSize);
+	}();
+	return page_size;
+}
+
 void * vmem_alloc(std::size_t size, std::uintptr_t pref_base, int access)
 {
 	const auto flags = MEM_RESERVE | MEM_COMMIT;
@@ -57,4 +70,109 @@ void vmem_free(void * mem, std::size_t size)
 		throw std::system_error(GetLastError(), std::system_category());
 }
 
+std::size_t vmem_resident_size(const void * mem, std::size_t size)
+{
+	const auto page_size = vmem_page_size();
+	std::vector<PSAPI_WORKING_SET_EX_INFORMATION> pages((size + page_size - 1) / page_size);
+	for (std::size_t i = 0; i < pages.size(); ++i)
+		pages[i].VirtualAddress = static_cast<const char *>(mem) + i * page_size;
+	const auto info_size = static_cast<DWORD>(pages.size() * sizeof(pages[0]));
+	if (!QueryWorkingSetEx(GetCurrentProcess(), pages.data(), info_size))
+		throw std::system_error(GetLastError(), std::system_category());
+	std::size_t resident = 0;
+	for (const auto & page : pages)
+		if (page.VirtualAttributes.Valid) resident += page_size;
+	return resident;
+}
+
+std::vector<bool> vmem_mapped_pages(const void * mem, std::size_t size)
+{
+	const auto page_size = vmem_page_size();
+	std::vector<PSAPI_WORKING_SET_EX_INFORMATION> pages((size + page_size - 1) / page_size);
+	for (std::size_t i = 0; i < pages.size(); ++i)
+		pages[i].VirtualAddress = static_cast<const char *>(mem) + i * page_size;
+	const auto info_size = static_cast<DWORD>(pages.size() * sizeof(pages[0]));
+	if (!QueryWorkingSetEx(GetCurrentProcess(), pages.data(), info_size))
+		throw std::system_error(GetLastError(), std::system_category());
+	std::vector<bool> mapped(pages.size());
+	for (std::size_t i = 0; i < pages.size(); ++i)
+		mapped[i] = pages[i].VirtualAttributes.Valid != 0;
+	return mapped;
+}
+
+/*
+	MEM_RESET leaves the old contents readable until the pages are reused,
+	so private pages are decommitted and recommitted with their protection
+	instead, which zeroes them. Views of a mapping cannot be decommitted.
+ */
+void vmem_discard(void * mem, std::size_t size)
+{
+	auto bytes = static_cast<char *>(mem);
+	const auto end = bytes + size;
+	while (bytes < end) {
+		MEMORY_BASIC_INFORMATION info;
+		if (!VirtualQuery(bytes, &info, sizeof(info)))
+			throw std::system_error(GetLastError(), std::system_category());
+		if (info.Type != MEM_PRIVATE)
+			throw std::system_error(ERROR_NOT_SUPPORTED, std::system_category());
+		const auto region_end = std::min(end, static_cast<char *>(info.BaseAddress) + info.RegionSize);
+		const auto length = static_cast<std::size_t>(region_end - bytes);
+		if (info.State == MEM_COMMIT) {
+			if (!VirtualFree(bytes, length, MEM_DECOMMIT))
+				throw std::system_error(GetLastError(), std::system_category());
+			if (!VirtualAlloc(bytes, length, MEM_COMMIT, info.Protect))
+				throw std::system_error(GetLastError(), std::system_category());
+		}
+		bytes = region_end;
+	}
+}
+
+void vmem_populate(const void * mem, std::size_t size)
+{
+	WIN32_MEMORY_RANGE_ENTRY range { const_cast<void *>(mem), size };
+	if (PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0))
+		return;
+	const auto page_size = vmem_page_size();
+	const auto bytes = static_cast<const volatile char *>(mem);
+	for (std::size_t offset = 0; offset < size; offset += page_size)
+		static_cast<void>(bytes[offset]);
+}
+
+vmem_object_t vmem_object_create(std::size_t size)
+{
+	const auto size64 = static_cast<unsigned long long>(size);
+	const HANDLE handle = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr,
+	                                         PAGE_EXECUTE_READWRITE,
+	                                         static_cast<DWORD>(size64 >> 32),
+	                                         static_cast<DWORD>(size64), nullptr);
+	if (!handle)
+		throw std::system_error(GetLastError(), std::system_category());
+	return reinterpret_cast<vmem_object_t>(handle);
+}
+
+void vmem_object_close(vmem_object_t object)
+{
+	CloseHandle(reinterpret_cast<HANDLE>(object));
+}
+
+void * vmem_object_map(vmem_object_t object, std::size_t size, bool copy_on_write,
+                       std::uintptr_t pref_base)
+{
+	const DWORD access = (copy_on_write ? FILE_MAP_COPY : FILE_MAP_WRITE) | FILE_MAP_EXECUTE;
+	const auto handle = reinterpret_cast<HANDLE>(object);
+	const auto mbase = reinterpret_cast<void *>(pref_base);
+	void * mem = MapViewOfFileEx(handle, access, 0, 0, size, mbase);
+	if (!mem && pref_base)
+		mem = MapViewOfFileEx(handle, access, 0, 0, size, nullptr);
+	if (!mem)
+		throw std::system_error(GetLastError(), std::system_category());
+	return mem;
+}
+
+void vmem_object_unmap(void * mem, std::size_t)
+{
+	if (!UnmapViewOfFile(mem))
+		throw std::system_error(GetLastError(), std::system_category());
+}
+
 }
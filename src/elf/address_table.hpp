@@ -0,0 +1,216 @@
+#ifndef TLDR_SRC_ELF_ADDRESSTABLE_HPP_
+#define TLDR_SRC_ELF_ADDRESSTABLE_HPP_
+
+#include "elf.hpp"
+#include "../address_index.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace tldr {
+
+struct ElfSymbolSource
+{
+	const char * syms;
+	std::size_t count;
+	std::size_t entsize;
+	const char * strs;
+	std::size_t strsize;
+};
+
+/*
+	Sorted address table over .dynsym and, when retained, .symtab. Sources
+	are captured and the table is built while the module is registered, so
+	lookups only search it and stay usable from a signal handler.
+ */
+
+template <class ElfN>
+class ElfAddressTable final : public AddressSymbols
+{
+public:
+	ElfAddressTable();
+	virtual ~ElfAddressTable();
+
+	ElfAddressTable(const ElfAddressTable &) = delete;
+	ElfAddressTable & operator=(const ElfAddressTable &) = delete;
+
+	void set_base(std::uintptr_t base);
+	void add_dynamic_symbols(const ElfImageR<ElfN> & image);
+	void retain_symtab(const ElfImageR<ElfN> & blob);
+	void build();
+	std::size_t memory_size() const;
+
+	virtual bool find_symbol(std::uintptr_t addr, SymbolInfo & info) const noexcept override;
+
+	template <typename Fn>
+	void for_each_function(Fn && fn) const;
+
+private:
+	struct Entry
+	{
+		std::uintptr_t address;
+		std::size_t size;
+		const char * name;
+		std::size_t order;
+	};
+
+	bool is_addressable(const Elf_Sym<ElfN> & sym, const ElfSymbolSource & source) const noexcept;
+	Elf_Sym<ElfN> symbol_at(const ElfSymbolSource & source, std::size_t index) const noexcept;
+
+private:
+	std::uintptr_t base_;
+	std::vector<ElfSymbolSource> sources_;
+	std::vector<char> symtab_;
+	std::vector<Entry> entries_;
+};
+
+template <class ElfN>
+ElfAddressTable<ElfN>::ElfAddressTable()
+	: base_ { 0 } {}
+
+template <class ElfN>
+ElfAddressTable<ElfN>::~ElfAddressTable() = default;
+
+template <class ElfN>
+void ElfAddressTable<ElfN>::set_base(std::uintptr_t base)
+{
+	base_ = base;
+}
+
+template <class ElfN>
+void ElfAddressTable<ElfN>::add_dynamic_symbols(const ElfImageR<ElfN> & image)
+{
+	const auto & dyn_table = image.dynamic_table();
+	if (!dyn_table) return;
+	std::uintptr_t symtab_rva = 0, strtab_rva = 0;
+	std::size_t syment = sizeof(Elf_Sym<ElfN>), strsz = 0;
+	for (const auto & dyn : dyn_table->entries()) {
+		switch (dyn.d_tag) {
+		case DT_SYMTAB: symtab_rva = dyn.d_un.d_ptr - image.vbase(); break;
+		case DT_STRTAB: strtab_rva = dyn.d_un.d_ptr - image.vbase(); break;
+		case DT_SYMENT: syment = dyn.d_un.d_val; break;
+		case DT_STRSZ: strsz = dyn.d_un.d_val; break;
+		}
+	}
+	if (!symtab_rva || !strtab_rva) return;
+	sources_.push_back({
+		static_cast<const char *>(image.rva_to_ptr(symtab_rva)),
+		dyn_table->hash_table().symbol_count(), syment,
+		static_cast<const char *>(image.rva_to_ptr(strtab_rva)), strsz
+	});
+}
+
+template <class ElfN>
+std::size_t ElfAddressTable<ElfN>::memory_size() const
+{
+	return sources_.capacity() * sizeof(ElfSymbolSource) + symtab_.capacity()
+	     + entries_.capacity() * sizeof(Entry);
+}
+
+template <class ElfN>
+void ElfAddressTable<ElfN>::retain_symtab(const ElfImageR<ElfN> & blob)
+{
+	if (blob.ehdr().e_shoff == 0 || blob.ehdr().e_shnum == 0) return;
+	const auto shdr_range = blob.shdrs();
+	const std::vector<Elf_Shdr<ElfN>> shdrs(shdr_range.begin(), shdr_range.end());
+	for (const auto & shdr : shdrs) {
+		if (shdr.sh_type != SHT_SYMTAB || shdr.sh_link >= shdrs.size()) continue;
+		const auto & strtab = shdrs[shdr.sh_link];
+		if (shdr.sh_offset + shdr.sh_size > blob.size()
+		 || strtab.sh_offset + strtab.sh_size > blob.size()
+		 || shdr.sh_entsize == 0)
+			return;
+		symtab_.resize(shdr.sh_size + strtab.sh_size);
+		std::memcpy(symtab_.data(), blob.offset_to_ptr(shdr.sh_offset), shdr.sh_size);
+		std::memcpy(symtab_.data() + shdr.sh_size,
+		            blob.offset_to_ptr(strtab.sh_offset), strtab.sh_size);
+		sources_.push_back({
+			symtab_.data(), shdr.sh_size / shdr.sh_entsize, shdr.sh_entsize,
+			symtab_.data() + shdr.sh_size, strtab.sh_size
+		});
+		return;
+	}
+}
+
+template <class ElfN>
+Elf_Sym<ElfN> ElfAddressTable<ElfN>::symbol_at(const ElfSymbolSource & source,
+                                               std::size_t index) const noexcept
+{
+	Elf_Sym<ElfN> sym;
+	std::memcpy(&sym, source.syms + index * source.entsize, sizeof(sym));
+	return sym;
+}
+
+template <class ElfN>
+bool ElfAddressTable<ElfN>::is_addressable(const Elf_Sym<ElfN> & sym,
+                                           const ElfSymbolSource & source) const noexcept
+{
+	const auto type = ELF_ST_TYPE(sym);
+	return (type == STT_FUNC || type == STT_OBJECT || type == STT_GNU_IFUNC)
+	    && sym.st_shndx != SHN_UNDEF && sym.st_value != 0
+	    && sym.st_name < source.strsize;
+}
+
+template <class ElfN> template <typename Fn>
+void ElfAddressTable<ElfN>::for_each_function(Fn && fn) const
+{
+	for (const auto & source : sources_) {
+		for (std::size_t i = 0; i < source.count; ++i) {
+			const auto sym = symbol_at(source, i);
+			if (!is_addressable(sym, source) || ELF_ST_TYPE(sym) == STT_OBJECT) continue;
+			fn(base_ + sym.st_value, sym.st_size, source.strs + sym.st_name);
+		}
+	}
+}
+
+template <class ElfN>
+void ElfAddressTable<ElfN>::build()
+{
+	std::size_t count = 0;
+	for (const auto & source : sources_) {
+		for (std::size_t i = 0; i < source.count; ++i)
+			count += is_addressable(symbol_at(source, i), source);
+	}
+	entries_.clear();
+	entries_.reserve(count);
+
+	std::size_t order = 0;
+	for (const auto & source : sources_) {
+		for (std::size_t i = 0; i < source.count; ++i) {
+			const auto sym = symbol_at(source, i);
+			if (!is_addressable(sym, source)) continue;
+			entries_.push_back({
+				base_ + sym.st_value, sym.st_size, source.strs + sym.st_name, order++
+			});
+		}
+	}
+	std::sort(entries_.begin(), entries_.end(), [] (const Entry & lhs, const Entry & rhs) {
+		return lhs.address != rhs.address ? lhs.address < rhs.address
+		                                  : lhs.order < rhs.order;
+	});
+	entries_.erase(std::unique(entries_.begin(), entries_.end(),
+		[] (const Entry & lhs, const Entry & rhs) {
+			return lhs.address == rhs.address;
+		}), entries_.end());
+}
+
+template <class ElfN>
+bool ElfAddressTable<ElfN>::find_symbol(std::uintptr_t addr, SymbolInfo & info) const noexcept
+{
+	const auto iter = std::upper_bound(entries_.begin(), entries_.end(), addr,
+		[] (std::uintptr_t addr, const Entry & entry) {
+			return addr < entry.address;
+		});
+	if (iter == entries_.begin()) return false;
+	const auto & entry = *(iter - 1);
+	if (entry.size != 0 && addr >= entry.address + entry.size) return false;
+	info.name = entry.name;
+	info.address = reinterpret_cast<const void *>(entry.address);
+	info.size = entry.size;
+	return true;
+}
+
+}
+
+#endif
@@ -25,12 +25,50 @@ Elf_Addr<ElfN> elf_x86_relocation_addend(const ElfImageR<ElfN> & image,
 		return 0;
 	case R_386_32: case R_386_PC32:
 	case R_386_GLOB_DAT: case R_386_JMP_SLOT: case R_386_RELATIVE:
-		return image.template load_from<std::uint32_t>(rel.r_offset);
+		return image.template load_from<std::uint32_t>(rel.r_offset - image.vbase());
 	default:
 		throw LoadError("relocation type not supported");
 	}
 }
 
+template <class ElfN, class Relocation>
+bool elf_x86_is_relative_relocation(const ElfImageR<ElfN> & image,
+                                    const Relocation & reloc)
+{
+	return ELF_R_TYPE(reloc) == R_386_RELATIVE;
+}
+
+inline const char * elf_x86_relocation_name(unsigned int type)
+{
+	switch (type) {
+	case R_386_NONE: return "R_386_NONE";
+	case R_386_32: return "R_386_32";
+	case R_386_PC32: return "R_386_PC32";
+	case R_386_COPY: return "R_386_COPY";
+	case R_386_GLOB_DAT: return "R_386_GLOB_DAT";
+	case R_386_JMP_SLOT: return "R_386_JMP_SLOT";
+	case R_386_RELATIVE: return "R_386_RELATIVE";
+	default: return nullptr;
+	}
+}
+
+template <class Relocation>
+bool elf_x86_plan_fixup(const Relocation & reloc, ElfFixupKind & kind, bool & uses_addend)
+{
+	uses_addend = true;
+	switch (ELF_R_TYPE(reloc)) {
+	case R_386_32: kind = ElfFixupKind::Word; return true;
+	case R_386_PC32: kind = ElfFixupKind::Pc32; return true;
+	case R_386_COPY: kind = ElfFixupKind::Copy; uses_addend = false; return true;
+	case R_386_GLOB_DAT: case R_386_JMP_SLOT:
+		kind = ElfFixupKind::Word;
+		uses_addend = false;
+		return true;
+	default:
+		return false;
+	}
+}
+
 template <class ElfN, class Relocation>
 bool elf_x86_is_copy_relocation(const ElfImageR<ElfN> & image,
                                 const Relocation & reloc)
@@ -45,7 +83,7 @@ void elf_x86_apply_copy_relocation(ElfImageRw<ElfN> & image,
                                    const ElfSymbolResolver<ElfN> & resolver)
 {
 	const auto sym_table = dyn_table.symbol_table();
-	const auto mem_dst = image.rva_to_ptr(reloc.r_offset);
+	const auto mem_dst = image.vaddr_to_ptr(reloc.r_offset);
 	const auto sym_info = sym_table.get_symbol(ELF_R_SYM(reloc));
 	const auto sym_value = elf_resolve_relocation_symbol(image, reloc, dyn_table, resolver);
 	const auto mem_src = reinterpret_cast<const void *>(sym_value);
@@ -68,12 +106,12 @@ Elf_Addr<ElfN> elf_x86_compute_relocation(const ElfImageR<ElfN> & image,
 	}
 	case R_386_PC32: {
 		const auto sym_value = elf_resolve_relocation_symbol(image, reloc, dyn_table, resolver);
-		return sym_value - reloc.r_offset + addend;
+		return sym_value - (image.load_bias() + reloc.r_offset) + addend;
 	}
 	case R_386_JMP_SLOT: case R_386_GLOB_DAT:
 		return elf_resolve_relocation_symbol(image, reloc, dyn_table, resolver);
 	case R_386_RELATIVE:
-		return image.vbase() + addend;
+		return image.load_bias() + addend;
 	default:
 		throw LoadError("relocation type not supported");
 	}
@@ -87,7 +125,7 @@ void elf_x86_store_relocation(ElfImageRw<ElfN> & image,
 	switch (ELF_R_TYPE(reloc)) {
 	case R_386_32: case R_386_PC32:
 	case R_386_GLOB_DAT: case R_386_JMP_SLOT: case R_386_RELATIVE:
-		return image.template store_at<std::uint32_t>(reloc.r_offset, value);
+		return image.template store_at<std::uint32_t>(reloc.r_offset - image.vbase(), value);
 	default:
 		throw LoadError("relocation type not supported");
 	}
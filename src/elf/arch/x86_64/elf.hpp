@@ -23,6 +23,48 @@ Elf_Addr<ElfN> elf_x86_64_relocation_addend(const ElfImageR<ElfN> & image,
 	throw LoadError("invalid relocation (Elf64_Rel; machine=x86_64)");
 }
 
+template <class ElfN, class Relocation>
+bool elf_x86_64_is_relative_relocation(const ElfImageR<ElfN> & image,
+                                       const Relocation & reloc)
+{
+	return ELF_R_TYPE(reloc) == R_X86_64_RELATIVE;
+}
+
+inline const char * elf_x86_64_relocation_name(unsigned int type)
+{
+	switch (type) {
+	case R_X86_64_NONE: return "R_X86_64_NONE";
+	case R_X86_64_64: return "R_X86_64_64";
+	case R_X86_64_PC32: return "R_X86_64_PC32";
+	case R_X86_64_COPY: return "R_X86_64_COPY";
+	case R_X86_64_GLOB_DAT: return "R_X86_64_GLOB_DAT";
+	case R_X86_64_JUMP_SLOT: return "R_X86_64_JUMP_SLOT";
+	case R_X86_64_RELATIVE: return "R_X86_64_RELATIVE";
+	case R_X86_64_32: return "R_X86_64_32";
+	case R_X86_64_32S: return "R_X86_64_32S";
+	default: return nullptr;
+	}
+}
+
+template <class Relocation>
+bool elf_x86_64_plan_fixup(const Relocation & reloc, ElfFixupKind & kind, bool & uses_addend)
+{
+	uses_addend = true;
+	switch (ELF_R_TYPE(reloc)) {
+	case R_X86_64_64: kind = ElfFixupKind::Word; return true;
+	case R_X86_64_PC32: kind = ElfFixupKind::Pc32; return true;
+	case R_X86_64_32: kind = ElfFixupKind::Word32; return true;
+	case R_X86_64_32S: kind = ElfFixupKind::Word32Signed; return true;
+	case R_X86_64_COPY: kind = ElfFixupKind::Copy; uses_addend = false; return true;
+	case R_X86_64_GLOB_DAT: case R_X86_64_JUMP_SLOT:
+		kind = ElfFixupKind::Word;
+		uses_addend = false;
+		return true;
+	default:
+		return false;
+	}
+}
+
 template <class ElfN, class Relocation>
 bool elf_x86_64_is_copy_relocation(const ElfImageR<ElfN> & image,
                                    const Relocation & reloc)
@@ -37,7 +79,7 @@ void elf_x86_64_apply_copy_relocation(ElfImageRw<ElfN> & image,
                                       const ElfSymbolResolver<ElfN> & resolver)
 {
 	const auto sym_table = dyn_table.symbol_table();
-	const auto mem_dst = image.rva_to_ptr(reloc.r_offset);
+	const auto mem_dst = image.vaddr_to_ptr(reloc.r_offset);
 	const auto sym_info = sym_table.get_symbol(ELF_R_SYM(reloc));
 	const auto sym_value = elf_resolve_relocation_symbol(image, reloc, dyn_table, resolver);
 	const auto mem_src = reinterpret_cast<const void *>(sym_value);
@@ -60,12 +102,12 @@ Elf_Addr<ElfN> elf_x86_64_compute_relocation(const ElfImageR<ElfN> & image,
 	}
 	case R_X86_64_PC32: {
 		const auto sym_value = elf_resolve_relocation_symbol(image, reloc, dyn_table, resolver);
-		return sym_value - reloc.r_offset + addend;
+		return sym_value - (image.load_bias() + reloc.r_offset) + addend;
 	}
 	case R_X86_64_GLOB_DAT: case R_X86_64_JUMP_SLOT:
 		return elf_resolve_relocation_symbol(image, reloc, dyn_table, resolver);
 	case R_X86_64_RELATIVE:
-		return image.vbase() + addend;
+		return image.load_bias() + addend;
 	case R_X86_64_32: {
 		const auto sym_value = elf_resolve_relocation_symbol(image, reloc, dyn_table, resolver);
 		return static_cast<std::uint32_t>(sym_value + addend);
@@ -87,9 +129,9 @@ void elf_x86_64_store_relocation(ElfImageRw<ElfN> & image,
 	switch (ELF_R_TYPE(reloc)) {
 	case R_X86_64_64: case R_X86_64_GLOB_DAT:
 	case R_X86_64_JUMP_SLOT: case R_X86_64_RELATIVE:
-		return image.template store_at<std::uint64_t>(reloc.r_offset, value);
+		return image.template store_at<std::uint64_t>(reloc.r_offset - image.vbase(), value);
 	case R_X86_64_PC32: case R_X86_64_32: case R_X86_64_32S:
-		return image.template store_at<std::uint32_t>(reloc.r_offset, value);
+		return image.template store_at<std::uint32_t>(reloc.r_offset - image.vbase(), value);
 	default:
 		throw LoadError("relocation type not supported");
 	}
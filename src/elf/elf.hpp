@@ -1,18 +1,41 @@
 #ifndef TLDR_SRC_ELF_ELF_HPP_
 #define TLDR_SRC_ELF_ELF_HPP_
 
+#include <tldr/load_stats.hpp>
+#include <tldr/module.hpp>
+
 #include <elf.h>
 #include "hash.hpp"
 #include "endian.hpp"
+#include "../prefetch.hpp"
 
 #include <boost/optional.hpp>
 #include <boost/iterator/iterator_facade.hpp>
 
+#include <algorithm>
 #include <cstdint>
 #include <limits>
+#include <string>
+#include <vector>
 
 namespace tldr {
 
+const std::size_t elf_lookup_group_size = 16;
+
+/*
+	What a symbol-bearing relocation stores, in arch-neutral terms: S + A
+	as a word, truncated or sign-checked to 32 bits, S + A - P, or a copy
+	of st_size bytes from S.
+ */
+enum class ElfFixupKind : std::uint8_t
+{
+	Word,
+	Word32,
+	Word32Signed,
+	Pc32,
+	Copy,
+};
+
 struct Elf32 {
 	typedef Elf32_Addr Addr;
 	typedef Elf32_Word Word;
@@ -76,8 +99,10 @@ public:
 	unsigned char type() const;
 	bool is_compatible() const;
 
+	std::size_t size() const;
 	std::uintptr_t vbase() const;
 	std::size_t vsize() const;
+	std::uintptr_t load_bias() const;
 
 	phdr_range phdrs() const;
 	shdr_range shdrs() const;
@@ -89,6 +114,7 @@ public:
 
 	const void * offset_to_ptr(std::uintptr_t offset) const;
 	const void * rva_to_ptr(std::uintptr_t reladdr) const;
+	const void * vaddr_to_ptr(std::uintptr_t vaddr) const;
 
 private:
 	VoidP mem_;
@@ -115,6 +141,9 @@ public:
 
 	using ElfImageR<ElfN>::rva_to_ptr;
 	void * rva_to_ptr(std::uintptr_t reladdr);
+
+	using ElfImageR<ElfN>::vaddr_to_ptr;
+	void * vaddr_to_ptr(std::uintptr_t vaddr);
 };
 
 template <class ElfN>
@@ -124,17 +153,29 @@ template <class ElfN>
 class ElfSymbolResolver
 {
 public:
-	explicit ElfSymbolResolver(const ElfModule<ElfN> & module);
+	explicit ElfSymbolResolver(const ElfModule<ElfN> & module,
+	                           LoadStats * stats = nullptr);
 
 	Elf_Addr<ElfN> get_data_symbol(const std::string & name) const;
 	Elf_Addr<ElfN> get_proc_symbol(const std::string & name) const;
 
+	void resolve_symbols(std::vector<std::string> names, std::vector<SymbolKind> kinds,
+	                     Elf_Addr<ElfN> * values) const;
+
+	void preload_symbols(const ElfDynamicTable<ElfN> & dyn_table,
+	                     const std::vector<std::uintptr_t> & sym_indices);
+	bool find_preloaded(std::uintptr_t sym_index, Elf_Addr<ElfN> & value) const;
+
 private:
 	template <typename Fn>
-	Elf_Addr<ElfN> get_symbol_each(Fn && try_resolve) const;
+	Elf_Addr<ElfN> get_symbol_each(const std::string & name, Fn && try_resolve) const;
 
 private:
 	const ElfModule<ElfN> & source_;
+	LoadStats * stats_;
+	std::vector<std::size_t> dep_stats_;
+	std::vector<Elf_Addr<ElfN>> preloaded_values_;
+	std::vector<bool> preloaded_;
 };
 
 template <class ElfN>
@@ -145,6 +186,7 @@ public:
 	               std::size_t size);
 
 	const char * get_string(std::uintptr_t index) const;
+	void prefetch(std::uintptr_t index) const;
 
 private:
 	const ElfImageR<ElfN> * image_;
@@ -160,6 +202,7 @@ public:
 	               std::size_t entsize);
 
 	Elf_Sym<ElfN> get_symbol(std::uintptr_t index) const;
+	void prefetch(std::uintptr_t index) const;
 
 private:
 	const ElfImageR<ElfN> * image_;
@@ -176,6 +219,12 @@ public:
 		find_symbol(const ElfSymbolTable<ElfN> & sym_table,
 		            const ElfStringTable<ElfN> & str_table,
 		            const std::string & sym_name) const = 0;
+	virtual void
+		find_symbols(const ElfSymbolTable<ElfN> & sym_table,
+		             const ElfStringTable<ElfN> & str_table,
+		             const std::string * sym_names, std::size_t count,
+		             boost::optional<Elf_Sym<ElfN>> * syms) const;
+	virtual std::size_t symbol_count() const = 0;
 };
 
 template <class ElfN>
@@ -191,8 +240,10 @@ public:
 
 	dyn_range entries() const;
 
-	rel_range rels() const;
-	rela_range relas() const;
+	rel_range rels(std::size_t skip = 0) const;
+	rela_range relas(std::size_t skip = 0) const;
+	std::size_t relative_rel_count() const;
+	std::size_t relative_rela_count() const;
 
 	rel_range plt_rels() const;
 	rela_range plt_relas() const;
@@ -222,6 +273,7 @@ public:
 		find_symbol(const ElfSymbolTable<ElfN> & sym_table,
 		            const ElfStringTable<ElfN> & str_table,
 		            const std::string & sym_name) const override;
+	virtual std::size_t symbol_count() const override;
 
 private:
 	const ElfImageR<ElfN> * image_;
@@ -239,6 +291,20 @@ public:
 		find_symbol(const ElfSymbolTable<ElfN> & sym_table,
 		            const ElfStringTable<ElfN> & str_table,
 		            const std::string & sym_name) const override;
+	virtual void
+		find_symbols(const ElfSymbolTable<ElfN> & sym_table,
+		             const ElfStringTable<ElfN> & str_table,
+		             const std::string * sym_names, std::size_t count,
+		             boost::optional<Elf_Sym<ElfN>> * syms) const override;
+	virtual std::size_t symbol_count() const override;
+
+private:
+	std::uintptr_t bloom_word_rva(std::uint32_t sym_hash) const;
+	std::uintptr_t bucket_rva(std::uint32_t sym_hash) const;
+	std::uintptr_t chain_rva(Elf_Word<ElfN> chain_iter) const;
+	bool may_contain(std::uint32_t sym_hash) const;
+	bool next_candidate(std::uint32_t sym_hash, Elf_Word<ElfN> & chain_iter,
+	                    bool & chain_end) const;
 
 private:
 	const ElfImageR<ElfN> * image_;
@@ -319,6 +385,16 @@ constexpr T elf_align(T value, Align align)
 	return (value + align - 1) & ~(align - 1);
 }
 
+/* Whether the program header table lies within the first size bytes of the file. */
+template <class ElfN>
+bool elf_program_headers_fit(const Elf_Ehdr<ElfN> & ehdr, std::uintmax_t size)
+{
+	if (ehdr.e_phnum == 0) return true;
+	if (ehdr.e_phentsize != sizeof(Elf_Phdr<ElfN>)) return false;
+	return ehdr.e_phoff <= size
+	    && std::uintmax_t { ehdr.e_phnum } * ehdr.e_phentsize <= size - ehdr.e_phoff;
+}
+
 template <class ElfN, typename VoidP>
 ElfImage<ElfN, VoidP>::ElfImage(VoidP mem, std::size_t size)
 	: mem_ { mem }, size_ { size }, vbase_ { UINTPTR_MAX }, vsize_ { 0 }
@@ -329,12 +405,21 @@ ElfImage<ElfN, VoidP>::ElfImage(VoidP mem, std::size_t size)
 	default: throw LoadError("invalid elf image (EI_DATA)");
 	}
 
+	if (!elf_program_headers_fit<ElfN>(ehdr_, size))
+		throw LoadError("invalid elf image (program headers out of bounds)");
 	for (const auto & phdr : phdrs()) {
 		if (phdr.p_type == PT_LOAD) {
+			if (phdr.p_align & (phdr.p_align - 1))
+				throw LoadError("invalid elf image (p_align)");
+			if (phdr.p_vaddr > UINTPTR_MAX - phdr.p_align
+			    || phdr.p_memsz > UINTPTR_MAX - phdr.p_align - phdr.p_vaddr)
+				throw LoadError("invalid elf image (PT_LOAD out of bounds)");
 			if (phdr.p_vaddr < vbase_) vbase_ = phdr.p_vaddr;
-			vsize_ += elf_align(phdr.p_memsz, phdr.p_align);
+			const std::size_t vend = elf_align(phdr.p_vaddr + phdr.p_memsz, phdr.p_align);
+			if (vend > vsize_) vsize_ = vend;
 		}
 	}
+	if (vsize_ != 0) vsize_ -= vbase_;
 }
 
 template <class ElfN, typename VoidP>
@@ -393,12 +478,28 @@ std::uintptr_t ElfImage<ElfN, VoidP>::vbase() const
 	return vbase_;
 }
 
+template <class ElfN, typename VoidP>
+std::size_t ElfImage<ElfN, VoidP>::size() const
+{
+	return size_;
+}
+
 template <class ElfN, typename VoidP>
 std::size_t ElfImage<ElfN, VoidP>::vsize() const
 {
 	return vsize_;
 }
 
+/*
+	How far the image was moved from the addresses it was linked at; what
+	the ABI calls the base address. Only meaningful for a mapped image.
+ */
+template <class ElfN, typename VoidP>
+std::uintptr_t ElfImage<ElfN, VoidP>::load_bias() const
+{
+	return reinterpret_cast<std::uintptr_t>(mem_) - vbase_;
+}
+
 template <class ElfN, typename VoidP> template <typename T>
 T ElfImage<ElfN, VoidP>::load_from(std::ptrdiff_t offset) const
 {
@@ -411,6 +512,7 @@ T ElfImage<ElfN, VoidP>::load_from(std::ptrdiff_t offset) const
 	case ELFDATA2LSB: le_read(data, size_ - offset, value); return value;
 	case ELFDATA2MSB: be_read(data, size_ - offset, value); return value;
 	}
+	throw LoadError("invalid elf image (EI_DATA)");
 }
 
 template <class ElfN, typename VoidP>
@@ -425,6 +527,12 @@ const void * ElfImage<ElfN, VoidP>::rva_to_ptr(std::uintptr_t reladdr) const
 	return static_cast<const char *>(mem_) + reladdr;
 }
 
+template <class ElfN, typename VoidP>
+const void * ElfImage<ElfN, VoidP>::vaddr_to_ptr(std::uintptr_t vaddr) const
+{
+	return rva_to_ptr(vaddr - vbase_);
+}
+
 template <class ElfN>
 ElfImageRw<ElfN>::ElfImage(void * mem, std::size_t size)
 	: ElfImageR<ElfN> { mem, size } {}
@@ -455,13 +563,31 @@ void * ElfImageRw<ElfN>::rva_to_ptr(std::uintptr_t reladdr)
 }
 
 template <class ElfN>
-ElfSymbolResolver<ElfN>::ElfSymbolResolver(const ElfModule<ElfN> & module)
-	: source_ { module } {}
+void * ElfImageRw<ElfN>::vaddr_to_ptr(std::uintptr_t vaddr)
+{
+	return const_cast<void *>(ElfImageR<ElfN>::vaddr_to_ptr(vaddr));
+}
+
+template <class ElfN>
+ElfSymbolResolver<ElfN>::ElfSymbolResolver(const ElfModule<ElfN> & module,
+                                           LoadStats * stats)
+	: source_ { module }, stats_ { stats }
+{
+	/* deps_ follows the order of the DT_NEEDED entries. */
+	if (!stats_) return;
+	if (const auto & dyn_table = source_.image_.dynamic_table()) {
+		const auto & str_table = dyn_table->string_table();
+		for (const auto & dyn : dyn_table->entries()) {
+			if (dyn.d_tag == DT_NEEDED)
+				dep_stats_.push_back(stats_->dependency_index(str_table.get_string(dyn.d_un.d_val)));
+		}
+	}
+}
 
 template <class ElfN>
 Elf_Addr<ElfN> ElfSymbolResolver<ElfN>::get_data_symbol(const std::string & name) const
 {
-	return get_symbol_each([&] (const auto & module) {
+	return get_symbol_each(name, [&] (const Module & module) {
 		return module.get_raw_data(name);
 	});
 }
@@ -469,22 +595,85 @@ Elf_Addr<ElfN> ElfSymbolResolver<ElfN>::get_data_symbol(const std::string & name
 template <class ElfN>
 Elf_Addr<ElfN> ElfSymbolResolver<ElfN>::get_proc_symbol(const std::string & name) const
 {
-	return get_symbol_each([&] (const auto & module) {
+	return get_symbol_each(name, [&] (const Module & module) {
 		return module.get_raw_proc(name);
 	});
 }
 
-template <class ElfN> template <typename Fn>
-Elf_Addr<ElfN> ElfSymbolResolver<ElfN>::get_symbol_each(Fn && try_resolve) const
+/*
+	Batched form of get_symbol_each: the whole batch is looked up in the
+	module itself, and whatever is still unresolved in each dependency in
+	turn, compacting the pending names between passes. The module's own
+	table is searched directly so the lookup does not run its initializers.
+ */
+
+template <class ElfN>
+void ElfSymbolResolver<ElfN>::resolve_symbols(std::vector<std::string> names,
+                                              std::vector<SymbolKind> kinds,
+                                              Elf_Addr<ElfN> * values) const
+{
+	std::vector<std::size_t> pending(names.size());
+	std::vector<void *> addresses(names.size());
+	for (std::size_t i = 0; i < names.size(); ++i)
+		pending[i] = i;
+
+	for (std::size_t dep = 0; dep <= source_.deps_.size() && !pending.empty(); ++dep) {
+		if (dep == 0) {
+			std::vector<std::uintptr_t> local_values(pending.size());
+			elf_find_symbols(source_.image_, names.data(), pending.size(), local_values.data());
+			for (std::size_t i = 0; i < pending.size(); ++i)
+				addresses[i] = reinterpret_cast<void *>(local_values[i]);
+		} else {
+			source_.deps_[dep - 1]->find_symbols(names.data(), kinds.data(),
+			                                     pending.size(), addresses.data());
+		}
+		std::size_t kept = 0;
+		for (std::size_t i = 0; i < pending.size(); ++i) {
+			if (addresses[i]) {
+				values[pending[i]] = reinterpret_cast<std::uintptr_t>(addresses[i]);
+				if (stats_ && dep == 0) ++stats_->symbols_resolved_locally;
+				if (stats_ && dep != 0) ++stats_->dependencies[dep_stats_[dep - 1]].symbols_resolved;
+			} else {
+				if (kept != i) {
+					pending[kept] = pending[i];
+					names[kept] = std::move(names[i]);
+					kinds[kept] = kinds[i];
+				}
+				++kept;
+			}
+		}
+		pending.resize(kept);
+	}
+	for (const auto index : pending)
+		values[index] = 0;
+}
+
+template <class ElfN>
+bool ElfSymbolResolver<ElfN>::find_preloaded(std::uintptr_t sym_index,
+                                             Elf_Addr<ElfN> & value) const
 {
-	auto sym_value = try_resolve(source_);
-	if (!sym_value) {
-		for (const auto module : source_.deps_) {
-			if (sym_value = try_resolve(*module))
+	if (sym_index >= preloaded_.size() || !preloaded_[sym_index]) return false;
+	value = preloaded_values_[sym_index];
+	return true;
+}
+
+template <class ElfN> template <typename Fn>
+Elf_Addr<ElfN> ElfSymbolResolver<ElfN>::get_symbol_each(const std::string & name,
+                                                         Fn && try_resolve) const
+{
+	Elf_Addr<ElfN> sym_value = elf_find_symbol(source_.image_, name);
+	if (sym_value) {
+		if (stats_) ++stats_->symbols_resolved_locally;
+	} else {
+		for (std::size_t i = 0; i < source_.deps_.size(); ++i) {
+			if (const auto value = try_resolve(*source_.deps_[i])) {
+				sym_value = reinterpret_cast<std::uintptr_t>(value);
+				if (stats_) ++stats_->dependencies[dep_stats_[i]].symbols_resolved;
 				break;
+			}
 		}
 	}
-	return reinterpret_cast<std::uintptr_t>(sym_value);
+	return sym_value;
 }
 
 template <class ElfN>
@@ -499,6 +688,13 @@ const char * ElfStringTable<ElfN>::get_string(std::uintptr_t index) const
 	return static_cast<const char *>(image_->rva_to_ptr(reladdr_ + index));
 }
 
+template <class ElfN>
+void ElfStringTable<ElfN>::prefetch(std::uintptr_t index) const
+{
+	if (index < size_)
+		tldr::prefetch(image_->rva_to_ptr(reladdr_ + index));
+}
+
 template <class ElfN>
 ElfSymbolTable<ElfN>::ElfSymbolTable(const ElfImageR<ElfN> & image,
                                      std::uintptr_t reladdr, std::size_t entsize)
@@ -510,6 +706,12 @@ Elf_Sym<ElfN> ElfSymbolTable<ElfN>::get_symbol(std::uintptr_t index) const
 	return image_->template load_from<Elf_Sym<ElfN>>(reladdr_ + index * entsize_);
 }
 
+template <class ElfN>
+void ElfSymbolTable<ElfN>::prefetch(std::uintptr_t index) const
+{
+	tldr::prefetch(image_->rva_to_ptr(reladdr_ + index * entsize_));
+}
+
 template <class ElfN>
 ElfDynamicTable<ElfN>::ElfDynamicTable(const ElfImageR<ElfN> & image,
                                        const Elf_Phdr<ElfN> & dyn_phdr)
@@ -578,7 +780,7 @@ const ElfHashTable<ElfN> & ElfDynamicTable<ElfN>::hash_table() const
 }
 
 template <class ElfN>
-auto ElfDynamicTable<ElfN>::rels() const -> rel_range
+auto ElfDynamicTable<ElfN>::rels(std::size_t skip) const -> rel_range
 {
 	std::uintptr_t reladdr = 0;
 	std::size_t relsz = 0, entsize = 0;
@@ -590,11 +792,13 @@ auto ElfDynamicTable<ElfN>::rels() const -> rel_range
 		}
 	}
 	const unsigned int relcount = entsize ? relsz / entsize : 0;
-	return { *image_, reladdr - image_->vbase(), entsize, relcount };
+	skip = std::min<std::size_t>(skip, relcount);
+	return { *image_, reladdr - image_->vbase() + skip * entsize, entsize,
+	         static_cast<unsigned int>(relcount - skip) };
 }
 
 template <class ElfN>
-auto ElfDynamicTable<ElfN>::relas() const -> rela_range
+auto ElfDynamicTable<ElfN>::relas(std::size_t skip) const -> rela_range
 {
 	std::uintptr_t reladdr = 0;
 	std::size_t relasz = 0, entsize = 0;
@@ -606,7 +810,29 @@ auto ElfDynamicTable<ElfN>::relas() const -> rela_range
 		}
 	}
 	const unsigned int relcount = entsize ? relasz / entsize : 0;
-	return { *image_, reladdr - image_->vbase(), entsize, relcount };
+	skip = std::min<std::size_t>(skip, relcount);
+	return { *image_, reladdr - image_->vbase() + skip * entsize, entsize,
+	         static_cast<unsigned int>(relcount - skip) };
+}
+
+/*
+	DT_RELCOUNT and DT_RELACOUNT: how many relative relocations the linker
+	sorted to the front of the table.
+ */
+template <class ElfN>
+std::size_t ElfDynamicTable<ElfN>::relative_rel_count() const
+{
+	for (const auto & dyn : entries())
+		if (dyn.d_tag == DT_RELCOUNT) return dyn.d_un.d_val;
+	return 0;
+}
+
+template <class ElfN>
+std::size_t ElfDynamicTable<ElfN>::relative_rela_count() const
+{
+	for (const auto & dyn : entries())
+		if (dyn.d_tag == DT_RELACOUNT) return dyn.d_un.d_val;
+	return 0;
 }
 
 template <class ElfN>
@@ -661,7 +887,7 @@ auto ElfDynamicTable<ElfN>::init_array() const -> addr_range
 		}
 	}
 	const unsigned int count = arraysz / sizeof(Elf_Addr<ElfN>);
-	return { *image_, reladdr - image_->vbase(), arraysz, count };
+	return { *image_, reladdr - image_->vbase(), sizeof(Elf_Addr<ElfN>), count };
 }
 
 template <class ElfN>
@@ -676,7 +902,7 @@ auto ElfDynamicTable<ElfN>::preinit_array() const -> addr_range
 		}
 	}
 	const unsigned int count = arraysz / sizeof(Elf_Addr<ElfN>);
-	return { *image_, reladdr - image_->vbase(), arraysz, count };
+	return { *image_, reladdr - image_->vbase(), sizeof(Elf_Addr<ElfN>), count };
 }
 
 template <class ElfN>
@@ -691,12 +917,23 @@ auto ElfDynamicTable<ElfN>::fini_array() const -> addr_range
 		}
 	}
 	const unsigned int count = arraysz / sizeof(Elf_Addr<ElfN>);
-	return { *image_, reladdr - image_->vbase(), arraysz, count };
+	return { *image_, reladdr - image_->vbase(), sizeof(Elf_Addr<ElfN>), count };
 }
 
 template <class ElfN>
 ElfHashTable<ElfN>::~ElfHashTable() = default;
 
+template <class ElfN>
+void ElfHashTable<ElfN>::find_symbols(const ElfSymbolTable<ElfN> & sym_table,
+                                      const ElfStringTable<ElfN> & str_table,
+                                      const std::string * sym_names,
+                                      std::size_t count,
+                                      boost::optional<Elf_Sym<ElfN>> * syms) const
+{
+	for (std::size_t i = 0; i < count; ++i)
+		syms[i] = find_symbol(sym_table, str_table, sym_names[i]);
+}
+
 template <class ElfN>
 ElfLegacyHashTable<ElfN>::ElfLegacyHashTable(const ElfImageR<ElfN> & image,
                                              std::uintptr_t reladdr)
@@ -718,11 +955,28 @@ ElfLegacyHashTable<ElfN>::find_symbol(const ElfSymbolTable<ElfN> & sym_table,
                                       const ElfStringTable<ElfN> & str_table,
                                       const std::string & sym_name) const
 {
+	if (table_.nbuckets == 0) return boost::none;
+	const auto wordsize = sizeof(Elf_Word<ElfN>);
+	const auto buckets_rva = reladdr_ + sizeof(Elf_Hash<ElfN>);
+	const auto chains_rva = buckets_rva + table_.nbuckets * wordsize;
 	const auto sym_hash = elf_hash(sym_name.c_str());
-
+	const auto bucket_offs = buckets_rva + (sym_hash % table_.nbuckets) * wordsize;
+	auto index = image_->template load_from<Elf_Word<ElfN>>(bucket_offs);
+	while (index != STN_UNDEF && index < table_.nchains) {
+		const auto sym = sym_table.get_symbol(index);
+		if (sym.st_shndx != SHN_UNDEF && str_table.get_string(sym.st_name) == sym_name)
+			return sym;
+		index = image_->template load_from<Elf_Word<ElfN>>(chains_rva + index * wordsize);
+	}
 	return boost::none;
 }
 
+template <class ElfN>
+std::size_t ElfLegacyHashTable<ElfN>::symbol_count() const
+{
+	return table_.nchains;
+}
+
 template <class ElfN>
 ElfGnuHashTable<ElfN>::ElfGnuHashTable(const ElfImageR<ElfN> & image,
                                        std::uintptr_t reladdr)
@@ -759,6 +1013,139 @@ ElfGnuHashTable<ElfN>::find_symbol(const ElfSymbolTable<ElfN> & sym_table,
 	return boost::none;
 }
 
+template <class ElfN>
+std::uintptr_t ElfGnuHashTable<ElfN>::bloom_word_rva(std::uint32_t sym_hash) const
+{
+	const unsigned int bits = sizeof(Elf_Addr<ElfN>) * 8;
+	const auto word_index = (sym_hash / bits) % table_.maskwords;
+	return bitmasks_rva_ + word_index * sizeof(Elf_Addr<ElfN>);
+}
+
+template <class ElfN>
+bool ElfGnuHashTable<ElfN>::may_contain(std::uint32_t sym_hash) const
+{
+	if (table_.maskwords == 0) return true;
+	const unsigned int bits = sizeof(Elf_Addr<ElfN>) * 8;
+	const auto word = image_->template load_from<Elf_Addr<ElfN>>(bloom_word_rva(sym_hash));
+	const Elf_Addr<ElfN> mask = (Elf_Addr<ElfN>(1) << (sym_hash % bits))
+	                          | (Elf_Addr<ElfN>(1) << ((sym_hash >> table_.gnu_shift) % bits));
+	return (word & mask) == mask;
+}
+
+template <class ElfN>
+std::uintptr_t ElfGnuHashTable<ElfN>::bucket_rva(std::uint32_t sym_hash) const
+{
+	return buckets_rva_ + (sym_hash % table_.nbuckets) * sizeof(Elf_Word<ElfN>);
+}
+
+template <class ElfN>
+std::uintptr_t ElfGnuHashTable<ElfN>::chain_rva(Elf_Word<ElfN> chain_iter) const
+{
+	return chains_rva_ + (chain_iter - table_.symndx) * sizeof(Elf_Word<ElfN>);
+}
+
+template <class ElfN>
+std::size_t ElfGnuHashTable<ElfN>::symbol_count() const
+{
+	const auto wordsize = sizeof(Elf_Word<ElfN>);
+	Elf_Word<ElfN> last = 0;
+	for (Elf_Word<ElfN> i = 0; i < table_.nbuckets; ++i)
+		last = std::max(last, image_->template load_from<Elf_Word<ElfN>>(buckets_rva_ + i * wordsize));
+	if (last < table_.symndx) return table_.symndx;
+	while ((image_->template load_from<Elf_Word<ElfN>>(chain_rva(last)) & 1) == 0)
+		++last;
+	return last + 1;
+}
+
+template <class ElfN>
+bool ElfGnuHashTable<ElfN>::next_candidate(std::uint32_t sym_hash,
+                                           Elf_Word<ElfN> & chain_iter,
+                                           bool & chain_end) const
+{
+	if (chain_iter < table_.symndx) return false;
+	for (;;) {
+		const auto chain_hash = image_->template load_from<Elf_Word<ElfN>>(chain_rva(chain_iter));
+		chain_end = (chain_hash & 1) != 0;
+		if (((chain_hash ^ sym_hash) & ~1) == 0) return true;
+		if (chain_end) return false;
+		++chain_iter;
+	}
+}
+
+/*
+	Resolves names in groups so that each dependent load of the lookup (bloom
+	word, bucket, chain, symbol, string) is issued for the whole group before
+	any name of the group needs its result. Names are hashed side by side,
+	and string compares come last, once a chain hash has matched.
+ */
+
+template <class ElfN>
+void ElfGnuHashTable<ElfN>::find_symbols(const ElfSymbolTable<ElfN> & sym_table,
+                                         const ElfStringTable<ElfN> & str_table,
+                                         const std::string * sym_names,
+                                         std::size_t count,
+                                         boost::optional<Elf_Sym<ElfN>> * syms) const
+{
+	std::fill(syms, syms + count, boost::none);
+	if (table_.nbuckets == 0) return;
+
+	for (std::size_t base = 0; base < count; base += elf_lookup_group_size) {
+		const auto group = std::min(elf_lookup_group_size, count - base);
+		const char * names[elf_lookup_group_size];
+		std::uint32_t hashes[elf_lookup_group_size];
+		Elf_Word<ElfN> chain_iters[elf_lookup_group_size];
+		bool candidates[elf_lookup_group_size];
+		bool chain_ends[elf_lookup_group_size];
+
+		for (std::size_t i = 0; i < group; ++i)
+			names[i] = sym_names[base + i].c_str();
+		elf_gnu_hash_lanes(names, group, hashes);
+
+		if (table_.maskwords != 0) {
+			for (std::size_t i = 0; i < group; ++i)
+				prefetch(image_->rva_to_ptr(bloom_word_rva(hashes[i])));
+		}
+		for (std::size_t i = 0; i < group; ++i) {
+			candidates[i] = may_contain(hashes[i]);
+			if (candidates[i])
+				prefetch(image_->rva_to_ptr(bucket_rva(hashes[i])));
+		}
+		for (std::size_t i = 0; i < group; ++i) {
+			if (!candidates[i]) continue;
+			chain_iters[i] = image_->template load_from<Elf_Word<ElfN>>(bucket_rva(hashes[i]));
+			candidates[i] = chain_iters[i] >= table_.symndx && chain_iters[i] != 0;
+			if (candidates[i])
+				prefetch(image_->rva_to_ptr(chain_rva(chain_iters[i])));
+		}
+		for (std::size_t i = 0; i < group; ++i) {
+			if (!candidates[i]) continue;
+			candidates[i] = next_candidate(hashes[i], chain_iters[i], chain_ends[i]);
+			if (candidates[i])
+				sym_table.prefetch(chain_iters[i]);
+		}
+		Elf_Sym<ElfN> entries[elf_lookup_group_size];
+		for (std::size_t i = 0; i < group; ++i) {
+			if (!candidates[i]) continue;
+			entries[i] = sym_table.get_symbol(chain_iters[i]);
+			str_table.prefetch(entries[i].st_name);
+		}
+		for (std::size_t i = 0; i < group; ++i) {
+			if (!candidates[i]) continue;
+			auto sym = entries[i];
+			for (;;) {
+				if (str_table.get_string(sym.st_name) == sym_names[base + i]) {
+					syms[base + i] = sym;
+					break;
+				}
+				if (chain_ends[i]) break;
+				++chain_iters[i];
+				if (!next_candidate(hashes[i], chain_iters[i], chain_ends[i])) break;
+				sym = sym_table.get_symbol(chain_iters[i]);
+			}
+		}
+	}
+}
+
 template <class ElfN, typename T>
 ElfObjectRange<ElfN, T>::ElfObjectRange()
 	: image_ { nullptr }, entsize_ { 0 }, begin_ { 0 }, end_ { 0 } {}
@@ -61,6 +61,30 @@ struct impl_symmetric_serializable_for<ElfN_Phdr,
 	}
 };
 
+template <class ElfN_Shdr>
+struct impl_symmetric_serializable_for<ElfN_Shdr,
+	std::enable_if_t<
+		std::is_same<ElfN_Shdr, Elf32_Shdr>::value
+		|| std::is_same<ElfN_Shdr, Elf64_Shdr>::value
+>>
+{
+	template <class io, class io_ref, class io_ptr>
+	static auto transfer(io_ref && shdr, io_ptr mem, std::size_t size)
+	{
+		io::ref(shdr.sh_name,      offsetof(ElfN_Shdr, sh_name     )).transfer(mem, size);
+		io::ref(shdr.sh_type,      offsetof(ElfN_Shdr, sh_type     )).transfer(mem, size);
+		io::ref(shdr.sh_flags,     offsetof(ElfN_Shdr, sh_flags    )).transfer(mem, size);
+		io::ref(shdr.sh_addr,      offsetof(ElfN_Shdr, sh_addr     )).transfer(mem, size);
+		io::ref(shdr.sh_offset,    offsetof(ElfN_Shdr, sh_offset   )).transfer(mem, size);
+		io::ref(shdr.sh_size,      offsetof(ElfN_Shdr, sh_size     )).transfer(mem, size);
+		io::ref(shdr.sh_link,      offsetof(ElfN_Shdr, sh_link     )).transfer(mem, size);
+		io::ref(shdr.sh_info,      offsetof(ElfN_Shdr, sh_info     )).transfer(mem, size);
+		io::ref(shdr.sh_addralign, offsetof(ElfN_Shdr, sh_addralign)).transfer(mem, size);
+		io::ref(shdr.sh_entsize,   offsetof(ElfN_Shdr, sh_entsize  )).transfer(mem, size);
+		return mem + sizeof(ElfN_Shdr);
+	}
+};
+
 template <class ElfN_Dyn>
 struct impl_symmetric_serializable_for<ElfN_Dyn,
 	std::enable_if_t<
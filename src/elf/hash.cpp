@@ -1,7 +1,9 @@
 #include <config.h>
 #include "hash.hpp"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 
 namespace tldr {
 
@@ -26,5 +28,42 @@ unsigned long elf_gnu_hash (const char * name)
 	return h & 0xffffffff;
 }
 
+namespace {
+
+const std::size_t gnu_hash_lanes = 8;
+
+}
+
+/*
+	Hashes up to eight names side by side: every lane steps one character per
+	iteration and lanes past the end of their name multiply by one and add
+	zero, so the inner loop is branch-free and the compiler can keep the lanes
+	in vector registers.
+ */
+
+void elf_gnu_hash_lanes(const char * const * names, std::size_t count,
+                        std::uint32_t * hashes)
+{
+	for (std::size_t base = 0; base < count; base += gnu_hash_lanes) {
+		const auto lanes = std::min(gnu_hash_lanes, count - base);
+		std::uint32_t h[gnu_hash_lanes];
+		std::size_t length[gnu_hash_lanes];
+		std::size_t max_length = 0;
+		for (std::size_t l = 0; l < gnu_hash_lanes; ++l) {
+			h[l] = 5381;
+			length[l] = l < lanes ? std::strlen(names[base + l]) : 0;
+			max_length = std::max(max_length, length[l]);
+		}
+		for (std::size_t pos = 0; pos < max_length; ++pos) {
+			for (std::size_t l = 0; l < gnu_hash_lanes; ++l) {
+				const bool active = pos < length[l];
+				const std::uint32_t c = active ? static_cast<unsigned char>(names[base + l][pos]) : 0;
+				h[l] = h[l] * (active ? 33 : 1) + c;
+			}
+		}
+		std::copy(h, h + lanes, hashes + base);
+	}
+}
+
 
 }
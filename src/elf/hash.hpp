@@ -3,6 +3,9 @@
 
 #include <elf.h>
 
+#include <cstddef>
+#include <cstdint>
+
 namespace tldr {
 
 struct Elf32_Hash
@@ -35,6 +38,8 @@ struct Elf64_GnuHash
 
 unsigned long elf_hash(const char * name);
 unsigned long elf_gnu_hash(const char * name);
+void elf_gnu_hash_lanes(const char * const * names, std::size_t count,
+                        std::uint32_t * hashes);
 
 }
 
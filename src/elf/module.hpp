@@ -2,39 +2,101 @@
 #define TLDR_SRC_ELF_MODULE_HPP_
 
 #include <tldr/loader.hpp>
+#include <tldr/memory_usage.hpp>
+#include <tldr/page_profile.hpp>
 #include <tldr/raw_module.hpp>
+#include <tldr/relocation_plan_cache.hpp>
+#include <tldr/relocation_report.hpp>
 
+#include "address_table.hpp"
 #include "elf.hpp"
+#include "../init_latch.hpp"
+#include "../module_snapshot.hpp"
+#include "../page_profile.hpp"
+#include "../perf_map.hpp"
+#include "../phase_timer.hpp"
+#include "../shared_image.hpp"
+#include "../unwind.hpp"
 #include "../vmemory.hpp"
 #include "arch/x86/elf.hpp"
 #include "arch/x86_64/elf.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
 #include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace tldr {
 
 template <class ElfN>
-class ElfModule final : public Module
+struct ElfMappedImage
+{
+	ElfImageRw<ElfN> image;
+	std::shared_ptr<SharedImage> shared;
+};
+
+template <class ElfN>
+class ElfModule final : public Module, public SnapshotSource, public PageProfileSource
 {
 	friend class ElfSymbolResolver<ElfN>;
 
 public:
 	static bool is_valid(const void * mem, std::size_t size);
 
-	ElfModule(const void * mem, std::size_t size, const ModuleResolver & resolver);
+	ElfModule(const void * mem, std::size_t size, const ModuleResolver & resolver,
+	          const LoadOptions & options = {});
+	ElfModule(ElfImageRw<ElfN> image, const ModuleResolver & resolver,
+	          const LoadOptions & options = {});
 	virtual ~ElfModule();
 
 	virtual fn_ptr_t get_raw_proc(const std::string & name) const override;
 	virtual data_ptr_t get_raw_data(const std::string & name) const override;
 
+	virtual void find_symbols(const std::string * names, const SymbolKind * kinds,
+	                          std::size_t count, void ** addresses) const override;
+
+	virtual MemoryUsage memory_usage() const override;
+	virtual RelocationReport relocation_report() const override;
+	virtual std::size_t footprint() const override;
+	virtual void wait_initialized() const override;
+	virtual std::vector<MemoryRegion> snapshot_regions() const override;
+	virtual std::string profile_key() const override;
+	virtual std::vector<std::size_t> touched_pages() const override;
+
+private:
+	ElfModule(ElfMappedImage<ElfN> mapped, const ModuleResolver & resolver,
+	          const LoadOptions & options, const void * blob, std::size_t blob_size);
+
+	void register_image(const void * blob, std::size_t blob_size);
+	void unregister_image();
+	std::size_t metadata_bytes() const;
+	void schedule_initialize(InitPolicy policy, const Executor & executor);
+	void ensure_initialized() const;
+
 private:
 	ElfImageRw<ElfN> image_;
+	std::shared_ptr<SharedImage> shared_image_;
+	int perf_outputs_;
 	std::vector<std::shared_ptr<Module>> deps_;
+	std::string name_;
+	ElfAddressTable<ElfN> address_table_;
+	std::vector<Elf_Phdr<ElfN>> phdrs_;
+	void * frames_;
+	std::shared_ptr<InitLatch> init_;
+	std::vector<std::uintptr_t> relocated_pages_;
+	std::string image_key_;
+	std::unique_ptr<RelocationReport> relocation_report_;
+	std::size_t footprint_ = 0;
 };
 
 #ifdef TLDR_HAS_ELF32_SUPPORT
@@ -78,19 +140,38 @@ void elf_map_program_headers(const ElfImageR<ElfN> & image, void * mem)
 			assert(mem_rva + phdr.p_memsz <= image.vsize());
 			if (phdr.p_filesz > phdr.p_memsz)
 				throw LoadError("invalid elf image (p_filesz > p_memsz)");
+			if (phdr.p_offset > image.size() || phdr.p_filesz > image.size() - phdr.p_offset)
+				throw LoadError("invalid elf image (PT_LOAD out of bounds)");
 			const auto mem_src = image.offset_to_ptr(phdr.p_offset);
-			const auto mem_dst = apply_offset<>(mem, phdr.p_vaddr);
+			const auto mem_dst = apply_offset<>(mem, mem_rva);
 			std::memcpy(mem_dst, mem_src, phdr.p_filesz);
 		}
 	}
 }
 
 template <class ElfN>
-ElfImageRw<ElfN> elf_load_image(const ElfImageR<ElfN> & image)
+std::size_t elf_image_file_size(const ElfImageR<ElfN> & image)
 {
-	const auto image_mem = vmem_alloc(image.vsize(), image.vbase());
+	std::size_t file_size = 0;
+	for (const auto & phdr : image.phdrs()) {
+		if (phdr.p_type == PT_LOAD)
+			file_size += phdr.p_filesz;
+	}
+	return file_size;
+}
+
+template <class ElfN>
+ElfImageRw<ElfN> elf_load_image(const ElfImageR<ElfN> & image,
+                                LoadStats * stats = nullptr,
+                                std::uintptr_t pref_base = 0)
+{
+	const auto image_mem = vmem_alloc(image.vsize(), pref_base);
 	try {
 		elf_map_program_headers(image, image_mem);
+		if (stats) {
+			stats->bytes_mapped += image.vsize();
+			stats->bytes_copied += elf_image_file_size(image);
+		}
 		return { image_mem, image.vsize() };
 	} catch (const std::exception & e) {
 		vmem_free(image_mem, image.vsize());
@@ -98,10 +179,67 @@ ElfImageRw<ElfN> elf_load_image(const ElfImageR<ElfN> & image)
 	}
 }
 
+template <class ElfN>
+bool elf_image_matches(const ElfImageR<ElfN> & image, const void * mem)
+{
+	for (const auto & phdr : image.phdrs()) {
+		if (phdr.p_type == PT_LOAD && phdr.p_filesz != 0) {
+			const auto mem_src = image.offset_to_ptr(phdr.p_offset);
+			const auto mem_dst = apply_offset<>(mem, phdr.p_vaddr - image.vbase());
+			if (std::memcmp(mem_dst, mem_src, phdr.p_filesz) != 0)
+				return false;
+		}
+	}
+	return true;
+}
+
+/*
+	Maps a copy-on-write view of the process-wide pristine copy of this
+	image, laying the copy out on first use. Falls back to a private copy if
+	the cached image under the same key turns out to differ.
+ */
+template <class ElfN>
+ElfMappedImage<ElfN> elf_load_shared_image(const ElfImageR<ElfN> & image,
+                                           LoadStats * stats = nullptr,
+                                           std::uintptr_t pref_base = 0)
+{
+	bool created = false;
+	const auto key = shared_image_key(image.offset_to_ptr(0), image.size());
+	auto shared = shared_image_acquire(key, image.vsize(), [&] (void * mem) {
+		elf_map_program_headers(image, mem);
+	}, created);
+	const auto image_mem = shared->map(pref_base);
+	if (!created && !elf_image_matches(image, image_mem)) {
+		SharedImage::unmap(image_mem, image.vsize());
+		return { elf_load_image(image, stats, pref_base), nullptr };
+	}
+	if (stats) {
+		stats->bytes_mapped += image.vsize();
+		if (created) stats->bytes_copied += elf_image_file_size(image);
+	}
+	return { { image_mem, image.vsize() }, std::move(shared) };
+}
+
+/*
+	Images are placed at LoadOptions::preferred_base, or else at the address
+	they were linked at, whenever that range is free. An image that lands
+	where it was linked needs none of its relative relocations.
+ */
+template <class ElfN>
+ElfMappedImage<ElfN> elf_map_image(const ElfImageR<ElfN> & image,
+                                   const LoadOptions & options)
+{
+	const auto pref_base = options.preferred_base ? options.preferred_base : image.vbase();
+	if (options.share_pages)
+		return elf_load_shared_image(image, options.stats, pref_base);
+	return { elf_load_image(image, options.stats, pref_base), nullptr };
+}
+
 template <class ElfN>
 std::vector<std::shared_ptr<Module>>
 elf_resolve_imports(const ElfImageR<ElfN> & image,
-                    const ModuleResolver & resolver)
+                    const ModuleResolver & resolver,
+                    LoadStats * stats = nullptr)
 {
 	std::vector<std::shared_ptr<Module>> imports;
 	if (const auto & dyn_table = image.dynamic_table()) {
@@ -113,6 +251,7 @@ elf_resolve_imports(const ElfImageR<ElfN> & image,
 				if (!mod_handle)
 					throw LoadError("module dependency not found");
 				imports.emplace_back(std::move(mod_handle));
+				if (stats) stats->dependency_index(mod_name);
 			}
 		}
 	}
@@ -136,6 +275,7 @@ Elf_Addr<ElfN> elf_relocation_addend(const ElfImageR<ElfN> & image,
 	case EM_X86_64:
 		return elf_x86_64_relocation_addend(image, rel);
 	}
+	throw LoadError("invalid elf image (e_machine)");
 }
 
 template <class ElfN>
@@ -150,6 +290,38 @@ Elf_Addr<ElfN> elf_resolve_symbol(const std::string & sym_name,
 	}
 }
 
+template <class ElfN>
+void ElfSymbolResolver<ElfN>::preload_symbols(const ElfDynamicTable<ElfN> & dyn_table,
+                                              const std::vector<std::uintptr_t> & sym_indices)
+{
+	const auto & sym_table = dyn_table.symbol_table();
+	const auto & str_table = dyn_table.string_table();
+	std::vector<std::string> names;
+	std::vector<SymbolKind> kinds;
+	std::vector<std::uintptr_t> indices;
+	for (const auto sym_index : sym_indices) {
+		const auto sym = sym_table.get_symbol(sym_index);
+		switch (ELF_ST_TYPE(sym)) {
+		case STT_OBJECT: kinds.push_back(SymbolKind::Data); break;
+		case STT_FUNC: kinds.push_back(SymbolKind::Proc); break;
+		default: continue;
+		}
+		names.emplace_back(str_table.get_string(sym.st_name));
+		indices.push_back(sym_index);
+	}
+	if (indices.empty()) return;
+
+	std::vector<Elf_Addr<ElfN>> values(indices.size());
+	resolve_symbols(std::move(names), std::move(kinds), values.data());
+	const auto max_index = *std::max_element(indices.begin(), indices.end());
+	preloaded_values_.resize(max_index + 1);
+	preloaded_.resize(max_index + 1);
+	for (std::size_t i = 0; i < indices.size(); ++i) {
+		preloaded_values_[indices[i]] = values[i];
+		preloaded_[indices[i]] = true;
+	}
+}
+
 template <class ElfN, class Relocation>
 Elf_Addr<ElfN> elf_resolve_relocation_symbol(const ElfImageR<ElfN> & image,
                                              const Relocation & reloc,
@@ -159,8 +331,11 @@ Elf_Addr<ElfN> elf_resolve_relocation_symbol(const ElfImageR<ElfN> & image,
 	const auto & sym_table = dyn_table.symbol_table();
 	const auto & str_table = dyn_table.string_table();
 	const auto sym_info = sym_table.get_symbol(ELF_R_SYM(reloc));
-	const auto sym_name = str_table.get_string(sym_info.st_name);
-	const auto sym_value = elf_resolve_symbol(sym_name, sym_info, resolver);
+	Elf_Addr<ElfN> sym_value;
+	if (!resolver.find_preloaded(ELF_R_SYM(reloc), sym_value)) {
+		const auto sym_name = str_table.get_string(sym_info.st_name);
+		sym_value = elf_resolve_symbol(sym_name, sym_info, resolver);
+	}
 	if (!sym_value && ELF_ST_BIND(sym_info) != STB_WEAK)
 		throw LoadError("required symbol not found");
 	return sym_value;
@@ -176,6 +351,20 @@ bool elf_is_group_stop_relocation(const ElfImageR<ElfN> & image,
 	case EM_X86_64:
 		return elf_x86_64_is_group_stop_relocation(image, reloc);
 	}
+	return false;
+}
+
+template <class ElfN, typename Relocation>
+bool elf_is_relative_relocation(const ElfImageR<ElfN> & image,
+                                const Relocation & reloc)
+{
+	switch (image.machine()) {
+	case EM_386:
+		return elf_x86_is_relative_relocation(image, reloc);
+	case EM_X86_64:
+		return elf_x86_64_is_relative_relocation(image, reloc);
+	}
+	return false;
 }
 
 template <class ElfN, typename Relocation>
@@ -188,6 +377,7 @@ bool elf_is_copy_relocation(const ElfImageR<ElfN> & image,
 	case EM_X86_64:
 		return elf_x86_64_is_copy_relocation(image, reloc);
 	}
+	return false;
 }
 
 template <class ElfN, typename Relocation>
@@ -217,6 +407,7 @@ Elf_Addr<ElfN> elf_compute_relocation(const ElfImageR<ElfN> & image,
 	case EM_X86_64:
 		return elf_x86_64_compute_relocation(image, reloc, addend, dyn_table, resolver);
 	}
+	throw LoadError("invalid elf image (e_machine)");
 }
 
 template <typename ElfN, class Relocation>
@@ -232,42 +423,619 @@ void elf_store_relocation(ElfImageRw<ElfN> & image,
 	}
 }
 
+/*
+	The page walk shared by everything that records which pages a write
+	dirtied: calls visit with the index of each page that the size bytes
+	at rva overlap.
+ */
+template <class Visit>
+void elf_for_each_page(std::uintptr_t rva, std::size_t size, std::size_t page_size, Visit visit)
+{
+	if (size == 0) return;
+	const auto last = (rva + size - 1) / page_size;
+	for (auto page = rva / page_size; page <= last; ++page)
+		visit(page);
+}
+
+/*
+	Adds count relocations to every page the size bytes at rva overlap, so
+	a write that straddles a page boundary counts on both pages and a page
+	with a zero count was never written.
+ */
+inline void elf_count_page_relocations(std::vector<std::size_t> & pages, std::uintptr_t rva,
+                                       std::size_t size, std::size_t page_size,
+                                       std::size_t count = 1)
+{
+	elf_for_each_page(rva, size, page_size, [&] (std::size_t page) {
+		if (page < pages.size()) pages[page] += count;
+	});
+}
+
+/* Counts each of the count words from rva on every page it overlaps. */
+inline void elf_count_page_words(std::vector<std::size_t> & pages, std::uintptr_t rva,
+                                 std::size_t count, std::size_t word_size, std::size_t page_size)
+{
+	const auto end = rva + count * word_size;
+	elf_for_each_page(rva, count * word_size, page_size, [&] (std::size_t page) {
+		if (page >= pages.size()) return;
+		const auto first = std::max<std::uintptr_t>(rva, page * page_size) - rva;
+		const auto last = std::min<std::uintptr_t>(end, (page + 1) * page_size) - rva;
+		pages[page] += (last + word_size - 1) / word_size - first / word_size;
+	});
+}
+
+/* How many bytes a relocation writes; a COPY writes the whole of its symbol. */
+template <class ElfN, class Relocation>
+std::size_t elf_relocation_write_size(const ElfImageR<ElfN> & image, const Relocation & reloc,
+                                      const ElfDynamicTable<ElfN> & dyn_table)
+{
+	if (elf_is_copy_relocation(image, reloc))
+		return std::max<std::size_t>(dyn_table.symbol_table().get_symbol(ELF_R_SYM(reloc)).st_size, 1);
+	return sizeof(Elf_Addr<ElfN>);
+}
+
+/*
+	Applies the relocations composed at the site iter points to, leaving
+	iter past them, and returns how many there were.
+ */
+template <class ElfN, class Iterator>
+std::size_t elf_apply_relocation_site(ElfImageRw<ElfN> & image,
+                                      Iterator & iter, const Iterator & enditer,
+                                      const ElfDynamicTable<ElfN> & dyn_table,
+                                      const ElfSymbolResolver<ElfN> & resolver,
+                                      LoadStats * stats,
+                                      std::vector<std::size_t> * page_relocations,
+                                      std::size_t page_size)
+{
+	const auto reloffs = iter->r_offset;
+	const auto write_size = elf_relocation_write_size(image, *iter, dyn_table);
+	auto value = elf_relocation_addend(image, *iter);
+	std::decay_t<decltype(*iter)> lastreloc;
+	std::size_t count = 0;
+	for (; iter != enditer; ++iter, ++count) {
+		if (iter->r_offset != reloffs) break;
+		if (elf_is_group_stop_relocation(image, *iter)) break;
+		if (stats) ++stats->relocations[ELF_R_TYPE(*iter)];
+		if (elf_is_copy_relocation(image, *iter)) {
+			elf_apply_copy_relocation(image, *iter, dyn_table, resolver);
+			continue;
+		}
+		value = elf_compute_relocation(image, *iter, value, dyn_table, resolver);
+		lastreloc = *iter;
+	}
+	elf_store_relocation(image, lastreloc, value);
+	if (page_relocations)
+		elf_count_page_relocations(*page_relocations, reloffs - image.vbase(),
+		                           write_size, page_size, count);
+	return count;
+}
+
 template <class ElfN, class RelocationRange>
 void elf_apply_relocation_group(ElfImageRw<ElfN> & image,
                                 const RelocationRange & relocs,
                                 const ElfDynamicTable<ElfN> & dyn_table,
-                                const ElfSymbolResolver<ElfN> & resolver)
+                                const ElfSymbolResolver<ElfN> & resolver,
+                                LoadStats * stats,
+                                std::vector<std::size_t> * page_relocations,
+                                bool skip_relative)
 {
+	const auto page_size = vmem_page_size();
 	const auto enditer = relocs.end();
 	for (auto iter = relocs.begin(); iter != enditer;) {
-		const auto reloffs = iter->r_offset;
-		const auto reladdr = reloffs - image.vbase();
-		const auto memptr = image.rva_to_ptr(reladdr);
-		auto value = elf_relocation_addend(image, *iter);
-		std::decay_t<decltype(*iter)> lastreloc;
-		for (; iter != enditer; ++iter) {
-			if (iter->r_offset != reloffs) break;
-			if (elf_is_group_stop_relocation(image, *iter)) break;
-			if (elf_is_copy_relocation(image, *iter)) {
-				elf_apply_copy_relocation(image, *iter, dyn_table, resolver);
-				continue;
-			}
-			value = elf_compute_relocation(image, *iter, value, dyn_table, resolver);
-			lastreloc = *iter;
+		if (skip_relative && elf_is_relative_relocation(image, *iter)) {
+			if (stats) ++stats->relocations_skipped;
+			++iter;
+			continue;
 		}
-		elf_store_relocation(image, lastreloc, value);
+		elf_apply_relocation_site(image, iter, enditer, dyn_table, resolver,
+		                          stats, page_relocations, page_size);
 	}
 }
 
+template <class RelocationRange>
+void elf_collect_relocation_symbols(const RelocationRange & relocs,
+                                    std::vector<std::uintptr_t> & sym_indices)
+{
+	for (const auto & reloc : relocs) {
+		if (ELF_R_SYM(reloc) != STN_UNDEF)
+			sym_indices.push_back(ELF_R_SYM(reloc));
+	}
+}
+
+/* The leading relative relocations never name a symbol, so they are not scanned. */
+template <class ElfN>
+std::vector<std::uintptr_t> elf_relocation_symbols(const ElfDynamicTable<ElfN> & dyn_table)
+{
+	std::vector<std::uintptr_t> sym_indices;
+	elf_collect_relocation_symbols(dyn_table.rels(dyn_table.relative_rel_count()), sym_indices);
+	elf_collect_relocation_symbols(dyn_table.relas(dyn_table.relative_rela_count()), sym_indices);
+	elf_collect_relocation_symbols(dyn_table.plt_rels(), sym_indices);
+	elf_collect_relocation_symbols(dyn_table.plt_relas(), sym_indices);
+	std::sort(sym_indices.begin(), sym_indices.end());
+	sym_indices.erase(std::unique(sym_indices.begin(), sym_indices.end()),
+	                  sym_indices.end());
+	return sym_indices;
+}
+
+/*
+	Relative relocations add the load bias to a link-time address, so they
+	are skipped outright when the bias is zero. The leading run that
+	DT_RELCOUNT/DT_RELACOUNT announces is not even read.
+ */
 template <class ElfN>
 void elf_apply_image_relocations(ElfImageRw<ElfN> & image,
                                  const ElfDynamicTable<ElfN> & dyn_table,
-                                 const ElfSymbolResolver<ElfN> & resolver)
+                                 const ElfSymbolResolver<ElfN> & resolver,
+                                 LoadStats * stats = nullptr,
+                                 std::vector<std::size_t> * page_relocations = nullptr)
+{
+	const bool skip = image.load_bias() == 0;
+	const auto rel_skip = skip ? dyn_table.relative_rel_count() : 0;
+	const auto rela_skip = skip ? dyn_table.relative_rela_count() : 0;
+	if (stats) stats->relocations_skipped += rel_skip + rela_skip;
+	elf_apply_relocation_group(image, dyn_table.rels(rel_skip), dyn_table, resolver, stats, page_relocations, skip);
+	elf_apply_relocation_group(image, dyn_table.relas(rela_skip), dyn_table, resolver, stats, page_relocations, skip);
+	elf_apply_relocation_group(image, dyn_table.plt_rels(), dyn_table, resolver, stats, page_relocations, skip);
+	elf_apply_relocation_group(image, dyn_table.plt_relas(), dyn_table, resolver, stats, page_relocations, skip);
+}
+
+template <class ElfN, typename Relocation>
+bool elf_plan_fixup(const ElfImageR<ElfN> & image, const Relocation & reloc,
+                    ElfFixupKind & kind, bool & uses_addend)
+{
+	switch (image.machine()) {
+	case EM_386:
+		return elf_x86_plan_fixup(reloc, kind, uses_addend);
+	case EM_X86_64:
+		return elf_x86_64_plan_fixup(reloc, kind, uses_addend);
+	}
+	return false;
+}
+
+/* The [start, end) image offsets of the REL, RELA and PLT relocation tables. */
+template <class ElfN>
+std::vector<std::pair<std::uintptr_t, std::uintptr_t>>
+elf_relocation_table_ranges(const ElfImageR<ElfN> & image)
 {
-	elf_apply_relocation_group(image, dyn_table.rels(), dyn_table, resolver);
-	elf_apply_relocation_group(image, dyn_table.relas(), dyn_table, resolver);
-	elf_apply_relocation_group(image, dyn_table.plt_rels(), dyn_table, resolver);
-	elf_apply_relocation_group(image, dyn_table.plt_relas(), dyn_table, resolver);
+	std::vector<std::pair<std::uintptr_t, std::uintptr_t>> tables;
+	if (const auto & dyn_table = image.dynamic_table()) {
+		std::uintptr_t rel = 0, rela = 0, jmprel = 0;
+		std::size_t relsz = 0, relasz = 0, pltrelsz = 0;
+		for (const auto & dyn : dyn_table->entries()) {
+			switch (dyn.d_tag) {
+			case DT_REL: rel = dyn.d_un.d_ptr; break;
+			case DT_RELSZ: relsz = dyn.d_un.d_val; break;
+			case DT_RELA: rela = dyn.d_un.d_ptr; break;
+			case DT_RELASZ: relasz = dyn.d_un.d_val; break;
+			case DT_JMPREL: jmprel = dyn.d_un.d_ptr; break;
+			case DT_PLTRELSZ: pltrelsz = dyn.d_un.d_val; break;
+			}
+		}
+		if (rel && relsz) tables.emplace_back(rel - image.vbase(), rel - image.vbase() + relsz);
+		if (rela && relasz) tables.emplace_back(rela - image.vbase(), rela - image.vbase() + relasz);
+		if (jmprel && pltrelsz) tables.emplace_back(jmprel - image.vbase(), jmprel - image.vbase() + pltrelsz);
+	}
+	return tables;
+}
+
+/*
+	An image's relocations compiled into what they do: runs of consecutive
+	relative words, each adding the load bias to its addend, and fixups
+	against a deduplicated import list. Sites are image offsets, so a plan
+	replays at any load address.
+ */
+template <class ElfN>
+struct ElfRelocationPlan
+{
+	struct RelativeRun
+	{
+		Elf_Addr<ElfN> rva;
+		std::uint32_t count;
+	};
+
+	struct Import
+	{
+		std::string name;
+		std::uint8_t type;
+		bool weak;
+	};
+
+	struct Fixup
+	{
+		Elf_Addr<ElfN> rva;
+		std::uint32_t import;
+		ElfFixupKind kind;
+		Elf_Addr<ElfN> addend;
+	};
+
+	std::uint64_t image_size = 0;
+	std::uint64_t digest = 0;
+	unsigned int relative_type = 0;
+	std::vector<RelativeRun> relative_runs;
+	std::vector<Elf_Addr<ElfN>> relative_addends;
+	std::vector<Import> imports;
+	std::vector<Fixup> fixups;
+	std::vector<std::pair<unsigned int, std::size_t>> type_counts;
+};
+
+template <class ElfN, class RelocationRange>
+bool elf_compile_relocation_group(const ElfImageR<ElfN> & image, const RelocationRange & relocs,
+                                  const ElfDynamicTable<ElfN> & dyn_table,
+                                  std::vector<std::pair<Elf_Addr<ElfN>, Elf_Addr<ElfN>>> & relatives,
+                                  std::map<std::uintptr_t, std::uint32_t> & import_index,
+                                  std::map<unsigned int, std::size_t> & type_counts,
+                                  ElfRelocationPlan<ElfN> & plan)
+{
+	const auto & sym_table = dyn_table.symbol_table();
+	const auto & str_table = dyn_table.string_table();
+	bool first = true;
+	Elf_Addr<ElfN> last_offset = 0;
+	for (const auto & reloc : relocs) {
+		/* composed relocations at one site are left to the table walk */
+		if (!first && reloc.r_offset == last_offset) return false;
+		first = false;
+		last_offset = reloc.r_offset;
+		const auto rva = reloc.r_offset - image.vbase();
+		if (elf_is_relative_relocation(image, reloc)) {
+			plan.relative_type = ELF_R_TYPE(reloc);
+			relatives.emplace_back(rva, elf_relocation_addend(image, reloc));
+			continue;
+		}
+		ElfFixupKind kind;
+		bool uses_addend;
+		if (!elf_plan_fixup(image, reloc, kind, uses_addend)) return false;
+		++type_counts[ELF_R_TYPE(reloc)];
+		const auto sym_index = ELF_R_SYM(reloc);
+		const auto sym = sym_table.get_symbol(sym_index);
+		auto inserted = import_index.emplace(sym_index, static_cast<std::uint32_t>(plan.imports.size()));
+		if (inserted.second) {
+			plan.imports.push_back({ str_table.get_string(sym.st_name),
+			                         static_cast<std::uint8_t>(ELF_ST_TYPE(sym)),
+			                         ELF_ST_BIND(sym) == STB_WEAK });
+		}
+		Elf_Addr<ElfN> addend = 0;
+		if (kind == ElfFixupKind::Copy) addend = sym.st_size;
+		else if (uses_addend) addend = elf_relocation_addend(image, reloc);
+		plan.fixups.push_back({ static_cast<Elf_Addr<ElfN>>(rva), inserted.first->second, kind, addend });
+	}
+	return true;
+}
+
+/*
+	Covers what a plan is compiled from: the relocation tables and the
+	names of the symbols they import. Zero if a table lies outside the
+	image.
+ */
+template <class ElfN>
+std::uint64_t elf_relocation_plan_digest(const ElfImageR<ElfN> & image,
+                                         const ElfDynamicTable<ElfN> & dyn_table)
+{
+	auto ranges = elf_relocation_table_ranges(image);
+	std::uintptr_t strtab = 0;
+	std::size_t strsz = 0;
+	for (const auto & dyn : dyn_table.entries()) {
+		if (dyn.d_tag == DT_STRTAB) strtab = dyn.d_un.d_ptr;
+		else if (dyn.d_tag == DT_STRSZ) strsz = dyn.d_un.d_val;
+	}
+	if (strtab && strsz) ranges.emplace_back(strtab - image.vbase(), strtab - image.vbase() + strsz);
+	std::uint64_t digest = 0xcbf29ce484222325ull;
+	for (const auto & range : ranges) {
+		if (range.first > range.second || range.second > image.vsize()) return 0;
+		digest = (digest ^ shared_image_key(image.rva_to_ptr(range.first),
+		                                    range.second - range.first)) * 0x100000001b3ull;
+	}
+	return digest;
+}
+
+/* How many bytes a fixup stores; zero for a kind no plan holds. */
+template <class ElfN>
+std::uint64_t elf_fixup_width(const typename ElfRelocationPlan<ElfN>::Fixup & fixup)
+{
+	switch (fixup.kind) {
+	case ElfFixupKind::Word: return sizeof(Elf_Addr<ElfN>);
+	case ElfFixupKind::Word32:
+	case ElfFixupKind::Word32Signed:
+	case ElfFixupKind::Pc32: return sizeof(std::uint32_t);
+	case ElfFixupKind::Copy: return fixup.addend;
+	}
+	return 0;
+}
+
+/* Whether every fixup writes inside the image and its import exists. */
+template <class ElfN>
+bool elf_relocation_plan_fits(const ElfRelocationPlan<ElfN> & plan, std::size_t image_size)
+{
+	for (const auto & fixup : plan.fixups) {
+		const auto width = elf_fixup_width<ElfN>(fixup);
+		if (fixup.kind != ElfFixupKind::Copy && width == 0) return false;
+		if (fixup.import >= plan.imports.size() || width > image_size
+		    || fixup.rva > image_size - width)
+			return false;
+	}
+	std::uint64_t relatives = 0;
+	for (const auto & run : plan.relative_runs) {
+		if (run.rva > image_size
+		    || run.count > (image_size - run.rva) / sizeof(Elf_Addr<ElfN>))
+			return false;
+		relatives += run.count;
+	}
+	return relatives == plan.relative_addends.size();
+}
+
+/*
+	Returns false for images whose relocations do not fit a plan, such as
+	unsupported types or several relocations composed at one site; those
+	are relocated by walking the tables as before. Must run on the image
+	before it is relocated, since REL addends are read in place.
+ */
+template <class ElfN>
+bool elf_compile_relocation_plan(const ElfImageR<ElfN> & image,
+                                 const ElfDynamicTable<ElfN> & dyn_table,
+                                 ElfRelocationPlan<ElfN> & plan)
+{
+	std::vector<std::pair<Elf_Addr<ElfN>, Elf_Addr<ElfN>>> relatives;
+	std::map<std::uintptr_t, std::uint32_t> import_index;
+	std::map<unsigned int, std::size_t> type_counts;
+	if (!elf_compile_relocation_group(image, dyn_table.rels(), dyn_table, relatives, import_index, type_counts, plan)
+	    || !elf_compile_relocation_group(image, dyn_table.relas(), dyn_table, relatives, import_index, type_counts, plan)
+	    || !elf_compile_relocation_group(image, dyn_table.plt_rels(), dyn_table, relatives, import_index, type_counts, plan)
+	    || !elf_compile_relocation_group(image, dyn_table.plt_relas(), dyn_table, relatives, import_index, type_counts, plan))
+		return false;
+
+	plan.image_size = image.vsize();
+	plan.digest = elf_relocation_plan_digest(image, dyn_table);
+	std::sort(relatives.begin(), relatives.end());
+	const auto word = static_cast<Elf_Addr<ElfN>>(sizeof(Elf_Addr<ElfN>));
+	for (const auto & relative : relatives) {
+		auto & runs = plan.relative_runs;
+		if (runs.empty() || runs.back().rva + runs.back().count * word != relative.first)
+			runs.push_back({ relative.first, 0 });
+		++runs.back().count;
+		plan.relative_addends.push_back(relative.second);
+	}
+	plan.type_counts.assign(type_counts.begin(), type_counts.end());
+	return true;
+}
+
+template <typename T>
+void elf_plan_write(std::ostream & stream, const T & value)
+{
+	stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+bool elf_plan_read(std::istream & stream, T & value)
+{
+	return static_cast<bool>(stream.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+const char elf_plan_magic[8] = { 't', 'l', 'd', 'r', 'r', 'p', 'l', '2' };
+
+template <class ElfN>
+void elf_save_relocation_plan(const std::string & path, const ElfRelocationPlan<ElfN> & plan)
+{
+	const auto temp_path = path + ".tmp";
+	{
+		std::ofstream file { temp_path, std::ios::binary | std::ios::trunc };
+		file.write(elf_plan_magic, sizeof(elf_plan_magic));
+		elf_plan_write(file, static_cast<std::uint32_t>(sizeof(Elf_Addr<ElfN>)));
+		elf_plan_write(file, plan.image_size);
+		elf_plan_write(file, plan.digest);
+		elf_plan_write(file, static_cast<std::uint32_t>(plan.relative_type));
+		elf_plan_write(file, static_cast<std::uint64_t>(plan.relative_runs.size()));
+		for (const auto & run : plan.relative_runs) {
+			elf_plan_write(file, run.rva);
+			elf_plan_write(file, run.count);
+		}
+		elf_plan_write(file, static_cast<std::uint64_t>(plan.relative_addends.size()));
+		file.write(reinterpret_cast<const char *>(plan.relative_addends.data()),
+		           plan.relative_addends.size() * sizeof(plan.relative_addends[0]));
+		elf_plan_write(file, static_cast<std::uint64_t>(plan.imports.size()));
+		for (const auto & import : plan.imports) {
+			elf_plan_write(file, static_cast<std::uint32_t>(import.name.size()));
+			file.write(import.name.data(), import.name.size());
+			elf_plan_write(file, import.type);
+			elf_plan_write(file, static_cast<std::uint8_t>(import.weak));
+		}
+		elf_plan_write(file, static_cast<std::uint64_t>(plan.fixups.size()));
+		for (const auto & fixup : plan.fixups) {
+			elf_plan_write(file, fixup.rva);
+			elf_plan_write(file, fixup.import);
+			elf_plan_write(file, fixup.kind);
+			elf_plan_write(file, fixup.addend);
+		}
+		elf_plan_write(file, static_cast<std::uint64_t>(plan.type_counts.size()));
+		for (const auto & count : plan.type_counts) {
+			elf_plan_write(file, static_cast<std::uint32_t>(count.first));
+			elf_plan_write(file, static_cast<std::uint64_t>(count.second));
+		}
+		if (!file) return;
+	}
+	std::remove(path.c_str());
+	std::rename(temp_path.c_str(), path.c_str());
+}
+
+/*
+	Any mismatch or truncation just means the plan is compiled again. Counts
+	are checked against what is left of the file before anything is sized
+	by them.
+ */
+template <class ElfN>
+bool elf_load_relocation_plan(const std::string & path, const ElfImageR<ElfN> & image,
+                              std::uint64_t digest, ElfRelocationPlan<ElfN> & plan)
+{
+	std::ifstream file { path, std::ios::binary | std::ios::ate };
+	const std::uint64_t file_size = file.tellg();
+	file.seekg(0);
+	char magic[sizeof(elf_plan_magic)];
+	std::uint32_t word_size = 0, relative_type = 0;
+	std::uint64_t count = 0;
+	if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, elf_plan_magic, sizeof(magic)) != 0
+	    || !elf_plan_read(file, word_size) || word_size != sizeof(Elf_Addr<ElfN>)
+	    || !elf_plan_read(file, plan.image_size) || plan.image_size != image.vsize()
+	    || !elf_plan_read(file, plan.digest) || plan.digest != digest
+	    || !elf_plan_read(file, relative_type) || !elf_plan_read(file, count)
+	    || count > file_size)
+		return false;
+	plan.relative_type = relative_type;
+	plan.relative_runs.resize(count);
+	for (auto & run : plan.relative_runs)
+		if (!elf_plan_read(file, run.rva) || !elf_plan_read(file, run.count)) return false;
+	if (!elf_plan_read(file, count) || count > file_size) return false;
+	plan.relative_addends.resize(count);
+	if (!file.read(reinterpret_cast<char *>(plan.relative_addends.data()),
+	               count * sizeof(plan.relative_addends[0])))
+		return false;
+	if (!elf_plan_read(file, count) || count > file_size) return false;
+	plan.imports.resize(count);
+	for (auto & import : plan.imports) {
+		std::uint32_t size = 0;
+		std::uint8_t weak = 0;
+		if (!elf_plan_read(file, size) || size > file_size) return false;
+		import.name.resize(size);
+		if (!file.read(&import.name[0], size) || !elf_plan_read(file, import.type)
+		    || !elf_plan_read(file, weak))
+			return false;
+		import.weak = weak != 0;
+	}
+	if (!elf_plan_read(file, count) || count > file_size) return false;
+	plan.fixups.resize(count);
+	for (auto & fixup : plan.fixups) {
+		if (!elf_plan_read(file, fixup.rva) || !elf_plan_read(file, fixup.import)
+		    || !elf_plan_read(file, fixup.kind) || !elf_plan_read(file, fixup.addend))
+			return false;
+	}
+	if (!elf_plan_read(file, count) || count > file_size) return false;
+	plan.type_counts.resize(count);
+	for (auto & type_count : plan.type_counts) {
+		std::uint32_t type = 0;
+		std::uint64_t value = 0;
+		if (!elf_plan_read(file, type) || !elf_plan_read(file, value)) return false;
+		type_count = { type, value };
+	}
+	return elf_relocation_plan_fits(plan, image.vsize());
+}
+
+/*
+	The plan for image from cache, else from the cache's directory, else
+	compiled and stored in both. Null when the image does not fit a plan.
+ */
+template <class ElfN>
+std::shared_ptr<const ElfRelocationPlan<ElfN>>
+elf_relocation_plan(const ElfImageR<ElfN> & image, const ElfDynamicTable<ElfN> & dyn_table,
+                    const std::string & image_key, RelocationPlanCache & cache, LoadStats * stats)
+{
+	const auto key = "elf" + std::to_string(sizeof(Elf_Addr<ElfN>) * 8) + "-" + image_key;
+	const auto digest = elf_relocation_plan_digest(image, dyn_table);
+	if (digest == 0) return nullptr;
+	if (auto cached = cache.find(key)) {
+		auto plan = std::static_pointer_cast<const ElfRelocationPlan<ElfN>>(cached);
+		if (plan->image_size == image.vsize() && plan->digest == digest) {
+			if (stats) stats->relocation_plan_cached = true;
+			return plan;
+		}
+	}
+	const auto path = cache.directory().empty() ? std::string {}
+	                                            : cache.directory() + "/" + key + ".relocs";
+	auto plan = std::make_shared<ElfRelocationPlan<ElfN>>();
+	if (!path.empty() && elf_load_relocation_plan(path, image, digest, *plan)) {
+		if (stats) stats->relocation_plan_cached = true;
+	} else {
+		*plan = {};
+		if (!elf_compile_relocation_plan(image, dyn_table, *plan)) return nullptr;
+		if (!path.empty()) elf_save_relocation_plan(path, *plan);
+	}
+	cache.insert(key, plan);
+	return plan;
+}
+
+template <class ElfN>
+void elf_replay_relocation_plan(ElfImageRw<ElfN> & image, const ElfRelocationPlan<ElfN> & plan,
+                                const ElfSymbolResolver<ElfN> & resolver,
+                                LoadStats * stats,
+                                std::vector<std::size_t> * page_relocations)
+{
+	std::vector<std::string> names;
+	std::vector<SymbolKind> kinds;
+	std::vector<std::size_t> indices;
+	for (std::size_t i = 0; i < plan.imports.size(); ++i) {
+		const auto & import = plan.imports[i];
+		switch (import.type) {
+		case STT_OBJECT: kinds.push_back(SymbolKind::Data); break;
+		case STT_FUNC: kinds.push_back(SymbolKind::Proc); break;
+		default: continue;
+		}
+		names.push_back(import.name);
+		indices.push_back(i);
+	}
+	std::vector<Elf_Addr<ElfN>> resolved(indices.size());
+	if (!indices.empty())
+		resolver.resolve_symbols(std::move(names), std::move(kinds), resolved.data());
+	std::vector<Elf_Addr<ElfN>> values(plan.imports.size());
+	for (std::size_t i = 0; i < indices.size(); ++i)
+		values[indices[i]] = resolved[i];
+	for (std::size_t i = 0; i < plan.imports.size(); ++i) {
+		if (!values[i] && !plan.imports[i].weak)
+			throw LoadError("required symbol not found");
+	}
+
+	const auto page_size = vmem_page_size();
+	const auto bias = static_cast<Elf_Addr<ElfN>>(image.load_bias());
+	if (bias != 0) {
+		auto addend = plan.relative_addends.begin();
+		for (const auto & run : plan.relative_runs) {
+			const auto words = static_cast<char *>(image.rva_to_ptr(run.rva));
+			for (std::uint32_t i = 0; i < run.count; ++i, ++addend) {
+				const Elf_Addr<ElfN> value = bias + *addend;
+				std::memcpy(words + i * sizeof(value), &value, sizeof(value));
+			}
+			if (page_relocations)
+				elf_count_page_words(*page_relocations, run.rva, run.count,
+				                     sizeof(Elf_Addr<ElfN>), page_size);
+		}
+		if (stats && !plan.relative_addends.empty())
+			stats->relocations[plan.relative_type] += plan.relative_addends.size();
+	} else if (stats) {
+		stats->relocations_skipped += plan.relative_addends.size();
+	}
+
+	for (const auto & fixup : plan.fixups) {
+		const auto place = image.rva_to_ptr(fixup.rva);
+		const auto sym_value = values[fixup.import];
+		switch (fixup.kind) {
+		case ElfFixupKind::Word: {
+			const Elf_Addr<ElfN> value = sym_value + fixup.addend;
+			std::memcpy(place, &value, sizeof(value));
+			break;
+		}
+		case ElfFixupKind::Word32: {
+			const auto value = static_cast<std::uint32_t>(sym_value + fixup.addend);
+			std::memcpy(place, &value, sizeof(value));
+			break;
+		}
+		case ElfFixupKind::Word32Signed: {
+			const auto value = static_cast<std::int32_t>(sym_value + fixup.addend);
+			std::memcpy(place, &value, sizeof(value));
+			break;
+		}
+		case ElfFixupKind::Pc32: {
+			const auto value = static_cast<std::uint32_t>(
+				sym_value + fixup.addend - reinterpret_cast<std::uintptr_t>(place));
+			std::memcpy(place, &value, sizeof(value));
+			break;
+		}
+		case ElfFixupKind::Copy:
+			std::memcpy(place, reinterpret_cast<const void *>(sym_value), fixup.addend);
+			break;
+		}
+		if (page_relocations)
+			elf_count_page_relocations(*page_relocations, fixup.rva,
+			                           elf_fixup_width<ElfN>(fixup), page_size);
+	}
+	if (stats) {
+		for (const auto & count : plan.type_counts)
+			stats->relocations[count.first] += count.second;
+	}
 }
 
 inline int elf_memory_access_flags(int flags)
@@ -282,13 +1050,15 @@ inline int elf_memory_access_flags(int flags)
 template <class ElfN>
 void elf_apply_memory_permissions(ElfImageRw<ElfN> & image)
 {
+	const auto page_size = vmem_page_size();
 	for (const auto & phdr : image.phdrs()) {
 		if (phdr.p_type == PT_LOAD) {
 			assert(phdr.p_filesz <= phdr.p_memsz);
-			const auto mem_addr = elf_align(phdr.p_vaddr, phdr.p_align);
+			const auto mem_addr = phdr.p_vaddr & ~(page_size - 1);
+			const auto mem_end = elf_align(phdr.p_vaddr + phdr.p_memsz, page_size);
 			const auto mem_ptr = image.rva_to_ptr(mem_addr - image.vbase());
 			const auto access = elf_memory_access_flags(phdr.p_flags);
-			vmem_protect(mem_ptr, phdr.p_memsz, access);
+			vmem_protect(mem_ptr, mem_end - mem_addr, access);
 		}
 	}
 }
@@ -299,7 +1069,7 @@ void elf_run_image_init(const ElfImageR<ElfN> & image,
 {
 	for (const auto & dyn : dyn_table.entries()) {
 		if (dyn.d_tag == DT_INIT) {
-			const auto init_ptr = image.rva_to_ptr(dyn.d_un.d_ptr);
+			const auto init_ptr = image.vaddr_to_ptr(dyn.d_un.d_ptr);
 			return reinterpret_cast<fn_ptr_t>(init_ptr)();
 		}
 	}
@@ -310,7 +1080,7 @@ void elf_run_image_entry(const ElfImageR<ElfN> & image)
 {
 	const auto & ehdr = image.ehdr();
 	if (ehdr.e_entry != 0) {
-		const auto entry_ptr = image.rva_to_ptr(ehdr.e_entry);
+		const auto entry_ptr = image.vaddr_to_ptr(ehdr.e_entry);
 		reinterpret_cast<fn_ptr_t>(entry_ptr)();
 	}
 }
@@ -319,10 +1089,9 @@ template <class ElfN>
 void elf_run_image_init_array(const ElfImageR<ElfN> & image,
                               const ElfDynamicTable<ElfN> & dyn_table)
 {
-	for (const auto init_rva : dyn_table.init_array()) {
-		if (init_rva == 0 || init_rva == -1) continue;
-		const auto init_ptr = image.rva_to_ptr(init_rva);
-		reinterpret_cast<fn_ptr_t>(init_ptr)();
+	for (const auto init_addr : dyn_table.init_array()) {
+		if (init_addr == 0 || init_addr == -1) continue;
+		reinterpret_cast<fn_ptr_t>(init_addr)();
 	}
 }
 
@@ -330,10 +1099,9 @@ template <class ElfN>
 void elf_run_image_preinit_array(const ElfImageR<ElfN> & image,
                               const ElfDynamicTable<ElfN> & dyn_table)
 {
-	for (const auto preinit_rva : dyn_table.preinit_array()) {
-		if (preinit_rva == 0 || preinit_rva == -1) continue;
-		const auto preinit_ptr = image.rva_to_ptr(preinit_rva);
-		reinterpret_cast<fn_ptr_t>(preinit_ptr)();
+	for (const auto preinit_addr : dyn_table.preinit_array()) {
+		if (preinit_addr == 0 || preinit_addr == -1) continue;
+		reinterpret_cast<fn_ptr_t>(preinit_addr)();
 	}
 }
 
@@ -348,28 +1116,562 @@ void elf_initialize_image(const ElfImageR<ElfN> & image)
 	elf_run_image_entry(image);
 }
 
+template <class ElfN>
+std::string elf_module_name(const ElfImageR<ElfN> & image)
+{
+	if (const auto & dyn_table = image.dynamic_table()) {
+		for (const auto & dyn : dyn_table->entries()) {
+			if (dyn.d_tag == DT_SONAME)
+				return dyn_table->string_table().get_string(dyn.d_un.d_val);
+		}
+	}
+	return {};
+}
+
+/*
+	The NT_GNU_BUILD_ID note among notes as lowercase hex, or empty if there
+	is none. Note headers have the same layout in both ELF classes.
+ */
+inline std::string elf_note_build_id(const unsigned char * notes, std::size_t size,
+                                     std::size_t align)
+{
+	align = std::max<std::size_t>(align, 4);
+	for (std::size_t offset = 0; offset + sizeof(Elf32_Nhdr) <= size;) {
+		Elf32_Nhdr note;
+		std::memcpy(&note, notes + offset, sizeof(note));
+		const auto name_offset = offset + sizeof(note);
+		const auto desc_offset = name_offset + elf_align<std::size_t>(note.n_namesz, align);
+		const auto next = desc_offset + elf_align<std::size_t>(note.n_descsz, align);
+		if (next > size) break;
+		if (note.n_type == NT_GNU_BUILD_ID && note.n_namesz == 4
+		    && std::memcmp(notes + name_offset, "GNU", 4) == 0) {
+			std::string build_id;
+			char digits[3];
+			for (std::size_t i = 0; i < note.n_descsz; ++i) {
+				std::snprintf(digits, sizeof(digits), "%02x", notes[desc_offset + i]);
+				build_id += digits;
+			}
+			return build_id;
+		}
+		offset = next;
+	}
+	return {};
+}
+
+/* The build-id of a mapped image. */
+template <class ElfN>
+std::string elf_build_id(const ElfImageR<ElfN> & image)
+{
+	for (const auto & phdr : image.phdrs()) {
+		if (phdr.p_type != PT_NOTE) continue;
+		const auto notes = image.rva_to_ptr(phdr.p_vaddr - image.vbase());
+		auto build_id = elf_note_build_id(static_cast<const unsigned char *>(notes),
+		                                  phdr.p_memsz, phdr.p_align);
+		if (!build_id.empty()) return build_id;
+	}
+	return {};
+}
+
+/* The build-id of an image still in its file layout. */
+template <class ElfN>
+std::string elf_file_build_id(const ElfImageR<ElfN> & image)
+{
+	for (const auto & phdr : image.phdrs()) {
+		if (phdr.p_type != PT_NOTE || phdr.p_offset + phdr.p_filesz > image.size()) continue;
+		const auto notes = image.offset_to_ptr(phdr.p_offset);
+		auto build_id = elf_note_build_id(static_cast<const unsigned char *>(notes),
+		                                  phdr.p_filesz, phdr.p_align);
+		if (!build_id.empty()) return build_id;
+	}
+	return {};
+}
+
+/*
+	Names the image for PageProfileStore and RelocationPlanCache: its
+	build-id, else a hash of the file it was loaded from, else nothing.
+ */
+template <class ElfN>
+std::string elf_image_key(const ElfImageR<ElfN> & image, const void * blob, std::size_t blob_size)
+{
+	auto key = elf_build_id(image);
+	if (key.empty() && blob) {
+		char hash[17];
+		std::snprintf(hash, sizeof(hash), "%016llx",
+		              static_cast<unsigned long long>(shared_image_key(blob, blob_size)));
+		key = std::string("fnv-") + hash;
+	}
+	return key;
+}
+
+template <class ElfN>
+PerfImage elf_perf_image(const ElfImageR<ElfN> & image, const std::string & name)
+{
+	return {
+		name.empty() ? "tldr-module" : name,
+		reinterpret_cast<std::uintptr_t>(image.rva_to_ptr(0)),
+		image.vsize(), image.machine()
+	};
+}
+
+template <class ElfN>
+void elf_write_perf_map(const ElfImageR<ElfN> & image, const std::string & name,
+                        const ElfAddressTable<ElfN> & address_table, int outputs)
+{
+	std::vector<PerfSymbol> symbols;
+	address_table.for_each_function([&] (std::uintptr_t address, std::size_t size,
+	                                     const char * sym_name) {
+		if (size != 0) symbols.push_back({ address, size, sym_name });
+	});
+	std::sort(symbols.begin(), symbols.end(), [] (const PerfSymbol & lhs, const PerfSymbol & rhs) {
+		return lhs.address < rhs.address;
+	});
+	symbols.erase(std::unique(symbols.begin(), symbols.end(),
+		[] (const PerfSymbol & lhs, const PerfSymbol & rhs) {
+			return lhs.address == rhs.address;
+		}), symbols.end());
+	perf_map_load(elf_perf_image(image, name), symbols, outputs);
+}
+
+inline std::vector<std::uintptr_t> elf_page_list(const std::vector<std::size_t> & page_relocations)
+{
+	const auto page_size = vmem_page_size();
+	std::vector<std::uintptr_t> pages;
+	for (std::size_t page = 0; page < page_relocations.size(); ++page)
+		if (page_relocations[page]) pages.push_back(page * page_size);
+	return pages;
+}
+
+/* Buckets the relocated pages by their relocation count, rounded down to a power of two. */
+inline void elf_record_page_relocation_density(const std::vector<std::size_t> & page_relocations,
+                                               LoadStats & stats)
+{
+	for (const auto count : page_relocations) {
+		if (!count) continue;
+		std::size_t bucket = 1;
+		while (bucket <= count / 2) bucket *= 2;
+		++stats.page_relocation_density[bucket];
+	}
+}
+
+template <class ElfN>
+MemoryUsage elf_image_memory_usage(const ElfImageR<ElfN> & image,
+                                   const std::vector<std::uintptr_t> & relocated_pages)
+{
+	MemoryUsage usage;
+	usage.reserved_bytes = image.vsize();
+	const auto page_size = vmem_page_size();
+	usage.relocated_bytes = relocated_pages.size() * page_size;
+	for (const auto & phdr : image.phdrs()) {
+		if (phdr.p_type != PT_LOAD) continue;
+		const auto seg_rva = (phdr.p_vaddr - image.vbase()) & ~(page_size - 1);
+		const auto seg_end = elf_align(phdr.p_vaddr - image.vbase() + phdr.p_memsz, page_size);
+		SegmentUsage segment;
+		segment.address = image.rva_to_ptr(seg_rva);
+		segment.size = seg_end - seg_rva;
+		segment.readable = (phdr.p_flags & PF_R) != 0;
+		segment.writable = (phdr.p_flags & PF_W) != 0;
+		segment.executable = (phdr.p_flags & PF_X) != 0;
+		segment.resident_bytes = vmem_resident_size(segment.address, segment.size);
+		const auto first = std::lower_bound(relocated_pages.begin(), relocated_pages.end(), seg_rva);
+		const auto last = std::lower_bound(first, relocated_pages.end(), seg_end);
+		segment.relocated_bytes = (last - first) * page_size;
+		usage.segments.push_back(segment);
+	}
+	usage.resident_bytes = vmem_resident_size(image.rva_to_ptr(0), image.vsize());
+	return usage;
+}
+
+inline std::string elf_relocation_name(unsigned char machine, unsigned int type)
+{
+	const char * name = nullptr;
+	switch (machine) {
+	case EM_386: name = elf_x86_relocation_name(type); break;
+	case EM_X86_64: name = elf_x86_64_relocation_name(type); break;
+	}
+	return name ? name : "type " + std::to_string(type);
+}
+
+/*
+	The allocated sections of the file image was loaded from, sorted by
+	offset, or its PT_LOAD segments when the file has no section headers
+	or is not at hand.
+ */
+template <class ElfN>
+std::vector<RelocationSectionUsage> elf_report_sections(const ElfImageR<ElfN> & image,
+                                                        const void * blob, std::size_t blob_size)
+{
+	std::vector<RelocationSectionUsage> sections;
+	if (blob) {
+		const ElfImageR<ElfN> file { blob, blob_size };
+		const auto & ehdr = file.ehdr();
+		if (ehdr.e_shoff && ehdr.e_shnum && ehdr.e_shstrndx < ehdr.e_shnum
+		    && ehdr.e_shoff + std::size_t(ehdr.e_shnum) * ehdr.e_shentsize <= blob_size) {
+			const auto shdr_range = file.shdrs();
+			const std::vector<Elf_Shdr<ElfN>> shdrs(shdr_range.begin(), shdr_range.end());
+			const auto & strtab = shdrs[ehdr.e_shstrndx];
+			for (const auto & shdr : shdrs) {
+				if (!(shdr.sh_flags & SHF_ALLOC) || !shdr.sh_size || shdr.sh_name >= strtab.sh_size
+				    || strtab.sh_offset + strtab.sh_size > blob_size)
+					continue;
+				const auto name = static_cast<const char *>(file.offset_to_ptr(strtab.sh_offset + shdr.sh_name));
+				RelocationSectionUsage section;
+				section.name.assign(name, std::find(name, name + (strtab.sh_size - shdr.sh_name), '\0'));
+				section.offset = shdr.sh_addr - image.vbase();
+				section.size = shdr.sh_size;
+				sections.push_back(std::move(section));
+			}
+		}
+	}
+	if (sections.empty()) {
+		std::size_t index = 0;
+		for (const auto & phdr : image.phdrs()) {
+			if (phdr.p_type != PT_LOAD) continue;
+			RelocationSectionUsage section;
+			section.name = "PT_LOAD[" + std::to_string(index++) + "]";
+			section.offset = phdr.p_vaddr - image.vbase();
+			section.size = phdr.p_memsz;
+			sections.push_back(std::move(section));
+		}
+	}
+	std::stable_sort(sections.begin(), sections.end(),
+	                 [] (const RelocationSectionUsage & a, const RelocationSectionUsage & b) {
+		return a.offset < b.offset;
+	});
+	return sections;
+}
+
+struct ElfReportTypePages
+{
+	std::size_t relocations = 0;
+	std::set<std::uintptr_t> pages;
+};
+
+using ElfReportTypes = std::map<unsigned int, ElfReportTypePages>;
+
+/* The last entry of sections collects relocations that fall in no other. */
+template <class ElfN, class Range>
+void elf_report_relocations(const ElfImageR<ElfN> & image, const Range & relocs,
+                            const ElfDynamicTable<ElfN> & dyn_table,
+                            RelocationReport & report, std::vector<ElfReportTypes> & types)
+{
+	const auto page_size = vmem_page_size();
+	const bool skip_relative = image.load_bias() == 0;
+	auto & sections = report.sections;
+	const auto sorted_end = std::prev(sections.end());
+	for (const auto & reloc : relocs) {
+		if (skip_relative && elf_is_relative_relocation(image, reloc)) {
+			++report.relocations_skipped;
+			continue;
+		}
+		const auto rva = reloc.r_offset - image.vbase();
+		auto section = std::upper_bound(sections.begin(), sorted_end, rva,
+		                                [] (std::uintptr_t rva, const RelocationSectionUsage & section) {
+			return rva < section.offset;
+		});
+		if (section != sections.begin() && rva < std::prev(section)->offset + std::prev(section)->size)
+			--section;
+		else
+			section = sorted_end;
+		++report.relocations;
+		++section->relocations;
+		auto & usage = types[section - sections.begin()][ELF_R_TYPE(reloc)];
+		++usage.relocations;
+		elf_for_each_page(rva, elf_relocation_write_size(image, reloc, dyn_table), page_size,
+		                  [&] (std::size_t page) { usage.pages.insert(page * page_size); });
+	}
+}
+
+/*
+	Built from the relocation tables right after relocating, before they
+	can be trimmed. Relative relocations skipped at the link base wrote
+	nothing, so they dirty no pages.
+ */
+template <class ElfN>
+RelocationReport elf_relocation_report(const ElfImageR<ElfN> & image,
+                                       const void * blob, std::size_t blob_size)
+{
+	RelocationReport report;
+	report.page_size = vmem_page_size();
+	const auto & dyn_table = image.dynamic_table();
+	if (!dyn_table) return report;
+	report.sections = elf_report_sections(image, blob, blob_size);
+	RelocationSectionUsage unsectioned;
+	unsectioned.name = "[none]";
+	report.sections.push_back(unsectioned);
+	std::vector<ElfReportTypes> types(report.sections.size());
+	elf_report_relocations(image, dyn_table->rels(), *dyn_table, report, types);
+	elf_report_relocations(image, dyn_table->relas(), *dyn_table, report, types);
+	elf_report_relocations(image, dyn_table->plt_rels(), *dyn_table, report, types);
+	elf_report_relocations(image, dyn_table->plt_relas(), *dyn_table, report, types);
+
+	const auto make_usage = [&] (unsigned int type, const ElfReportTypePages & pages) {
+		RelocationTypeUsage usage;
+		usage.type = type;
+		usage.name = elf_relocation_name(image.machine(), type);
+		usage.relocations = pages.relocations;
+		usage.dirty_pages = pages.pages.size();
+		usage.dirty_bytes = usage.dirty_pages * report.page_size;
+		return usage;
+	};
+	std::vector<RelocationSectionUsage> sections;
+	ElfReportTypes module_types;
+	std::set<std::uintptr_t> module_pages;
+	for (std::size_t i = 0; i < report.sections.size(); ++i) {
+		auto & section = report.sections[i];
+		if (!section.relocations) continue;
+		std::set<std::uintptr_t> section_pages;
+		for (const auto & entry : types[i]) {
+			section.types.push_back(make_usage(entry.first, entry.second));
+			section_pages.insert(entry.second.pages.begin(), entry.second.pages.end());
+			auto & module_type = module_types[entry.first];
+			module_type.relocations += entry.second.relocations;
+			module_type.pages.insert(entry.second.pages.begin(), entry.second.pages.end());
+		}
+		section.pages.assign(section_pages.begin(), section_pages.end());
+		section.dirty_bytes = section.pages.size() * report.page_size;
+		module_pages.insert(section_pages.begin(), section_pages.end());
+		sections.push_back(std::move(section));
+	}
+	report.sections = std::move(sections);
+	for (const auto & entry : module_types)
+		report.types.push_back(make_usage(entry.first, entry.second));
+	report.pages.assign(module_pages.begin(), module_pages.end());
+	report.dirty_bytes = report.pages.size() * report.page_size;
+	return report;
+}
+
+/*
+	Whole pages covered only by relocation tables. Nothing reads these
+	after relocation, so they can be discarded; pages shared with other
+	data, and any in writable segments, are left alone. A discarded page
+	of a private mapping reads back as zeros, and one of a shared image
+	as the pristine file contents (Windows cannot discard those), so
+	every reader of the relocation tables must run before the trim.
+ */
+template <class ElfN>
+std::vector<MemoryRegion> elf_trimmable_regions(ElfImageRw<ElfN> & image)
+{
+	auto tables = elf_relocation_table_ranges(image);
+	std::sort(tables.begin(), tables.end());
+
+	const auto page_size = vmem_page_size();
+	std::vector<MemoryRegion> regions;
+	for (std::size_t i = 0; i < tables.size();) {
+		auto start = tables[i].first, end = tables[i].second;
+		for (++i; i < tables.size() && tables[i].first <= end; ++i)
+			end = std::max(end, tables[i].second);
+		for (const auto & phdr : image.phdrs()) {
+			if (phdr.p_type != PT_LOAD || !(phdr.p_flags & PF_W)) continue;
+			const auto seg_rva = phdr.p_vaddr - image.vbase();
+			if (seg_rva < end && start < seg_rva + phdr.p_memsz) start = end;
+		}
+		const auto page_start = elf_align(start, page_size);
+		const auto page_end = end & ~(page_size - 1);
+		if (page_start < page_end && page_end <= image.vsize())
+			regions.push_back({ image.rva_to_ptr(page_start), page_end - page_start });
+	}
+	return regions;
+}
+
+template <class ElfN>
+void elf_mark_symbol_pages(const ElfImageR<ElfN> & image, const Elf_Sym<ElfN> & sym,
+                           std::vector<bool> & pages)
+{
+	if (sym.st_shndx == SHN_UNDEF || sym.st_value < image.vbase()) return;
+	const auto page_size = vmem_page_size();
+	const auto rva = sym.st_value - image.vbase();
+	const auto end = rva + std::max<std::uintptr_t>(sym.st_size, 1);
+	for (auto page = rva / page_size; page * page_size < end && page < pages.size(); ++page)
+		pages[page] = true;
+}
+
+/*
+	The pages holding the named symbols, or every defined .dynsym symbol
+	when no names are given.
+ */
+template <class ElfN>
+std::vector<bool> elf_hot_pages(const ElfImageR<ElfN> & image,
+                                const std::vector<std::string> & hot_symbols)
+{
+	const auto page_size = vmem_page_size();
+	std::vector<bool> pages((image.vsize() + page_size - 1) / page_size);
+	const auto & dyn_table = image.dynamic_table();
+	if (!dyn_table) return pages;
+	const auto & hash_table = dyn_table->hash_table();
+	const auto & sym_table = dyn_table->symbol_table();
+	const auto & str_table = dyn_table->string_table();
+	if (hot_symbols.empty()) {
+		for (std::size_t index = 0; index < hash_table.symbol_count(); ++index)
+			elf_mark_symbol_pages(image, sym_table.get_symbol(index), pages);
+	} else {
+		std::vector<boost::optional<Elf_Sym<ElfN>>> syms(hot_symbols.size());
+		hash_table.find_symbols(sym_table, str_table, hot_symbols.data(),
+		                        hot_symbols.size(), syms.data());
+		for (const auto & sym : syms)
+			if (sym) elf_mark_symbol_pages(image, *sym, pages);
+	}
+	return pages;
+}
+
+/*
+	The pages PopulatePolicy::HotSet or Profile asks for; every page for
+	Full, which elf_populate_image handles without a list.
+ */
+template <class ElfN>
+std::vector<bool> elf_populate_pages(const ElfImageR<ElfN> & image, const LoadOptions & options,
+                                     const std::string & profile_key)
+{
+	if (options.populate == PopulatePolicy::HotSet)
+		return elf_hot_pages(image, options.hot_symbols);
+	const auto page_size = vmem_page_size();
+	std::vector<bool> pages((image.vsize() + page_size - 1) / page_size);
+	std::vector<std::size_t> profile;
+	if (options.populate == PopulatePolicy::Profile && options.page_profiles
+	    && !profile_key.empty() && options.page_profiles->load(profile_key, pages.size(), profile)) {
+		for (const auto page : profile)
+			pages[page] = true;
+	}
+	return pages;
+}
+
+/*
+	Pages discarded by trim_after_load are never populated, whatever the
+	policy, so faulting them back in does not undo the trim.
+ */
+template <class ElfN>
+void elf_populate_image(const ElfImageR<ElfN> & image, PopulatePolicy policy,
+                        const std::vector<bool> & hot_pages,
+                        const std::vector<bool> & trimmed_pages, LoadStats * stats)
+{
+	if (policy == PopulatePolicy::None) return;
+	const auto page_size = vmem_page_size();
+	const auto wanted = [&] (std::uintptr_t rva) {
+		const auto page = rva / page_size;
+		if (page < trimmed_pages.size() && trimmed_pages[page]) return false;
+		return policy == PopulatePolicy::Full || hot_pages[page];
+	};
+	for (const auto & phdr : image.phdrs()) {
+		if (phdr.p_type != PT_LOAD || !(phdr.p_flags & PF_R)) continue;
+		const auto seg_rva = (phdr.p_vaddr - image.vbase()) & ~(page_size - 1);
+		const auto seg_end = elf_align(phdr.p_vaddr - image.vbase() + phdr.p_memsz, page_size);
+		for (auto rva = seg_rva; rva < seg_end;) {
+			auto run_end = rva + page_size;
+			if (!wanted(rva)) {
+				rva = run_end;
+				continue;
+			}
+			while (run_end < seg_end && wanted(run_end))
+				run_end += page_size;
+			vmem_populate(image.rva_to_ptr(rva), run_end - rva);
+			if (stats) stats->bytes_populated += run_end - rva;
+			rva = run_end;
+		}
+	}
+}
+
 template <class ElfN>
 ElfModule<ElfN>::ElfModule(const void * mem, std::size_t size,
-                           const ModuleResolver & resolver)
-	: image_ { elf_load_image<ElfN>({ mem, size }) }
-	, deps_ { elf_resolve_imports(image_, resolver) }
+                           const ModuleResolver & resolver,
+                           const LoadOptions & options)
+	: ElfModule { measure_load_phase(options.stats, LoadPhase::MapProgramHeaders, [&] {
+		return elf_map_image<ElfN>({ mem, size }, options);
+	}), resolver, options, mem, size } {}
+
+template <class ElfN>
+ElfModule<ElfN>::ElfModule(ElfImageRw<ElfN> image,
+                           const ModuleResolver & resolver,
+                           const LoadOptions & options)
+	: ElfModule { { image, nullptr }, resolver, options, nullptr, 0 } {}
+
+template <class ElfN>
+ElfModule<ElfN>::ElfModule(ElfMappedImage<ElfN> mapped,
+                           const ModuleResolver & resolver,
+                           const LoadOptions & options,
+                           const void * blob, std::size_t blob_size)
+try
+	: image_ { mapped.image }
+	, shared_image_ { mapped.shared }
+	, perf_outputs_ { options.perf_outputs }
+	, deps_ { measure_load_phase(options.stats, LoadPhase::ResolveImports, [&] {
+		return elf_resolve_imports(image_, resolver, options.stats);
+	}) }
+	, init_ { std::make_shared<InitLatch>() }
+	, image_key_ { options.page_profiles || options.relocation_plans
+	               ? elf_image_key(image_, blob, blob_size) : std::string {} }
 {
-	if (const auto & dyn_table = image_.dynamic_table()) {
-		const ElfSymbolResolver<ElfN> sym_resolver { *this };
-		elf_apply_image_relocations(image_, *dyn_table, sym_resolver);
+	const auto stats = options.stats;
+	std::vector<std::size_t> page_relocations((image_.vsize() + vmem_page_size() - 1) / vmem_page_size());
+	measure_load_phase(stats, LoadPhase::ApplyRelocations, [&] {
+		if (const auto & dyn_table = image_.dynamic_table()) {
+			ElfSymbolResolver<ElfN> sym_resolver { *this, stats };
+			if (options.relocation_plans && !image_key_.empty()) {
+				if (const auto plan = elf_relocation_plan(image_, *dyn_table, image_key_,
+				                                          *options.relocation_plans, stats)) {
+					elf_replay_relocation_plan(image_, *plan, sym_resolver, stats, &page_relocations);
+					return;
+				}
+			}
+			sym_resolver.preload_symbols(*dyn_table, elf_relocation_symbols(*dyn_table));
+			elf_apply_image_relocations(image_, *dyn_table, sym_resolver, stats, &page_relocations);
+		}
+	});
+	relocated_pages_ = elf_page_list(page_relocations);
+	if (stats) elf_record_page_relocation_density(page_relocations, *stats);
+	if (options.record_relocation_report)
+		relocation_report_.reset(new RelocationReport(elf_relocation_report(image_, blob, blob_size)));
+	std::vector<bool> trimmed_pages;
+	measure_load_phase(stats, LoadPhase::ApplyPermissions, [&] {
+		elf_apply_memory_permissions(image_);
+		if (options.trim_after_load) {
+			trimmed_pages.resize(page_relocations.size());
+			for (const auto & region : elf_trimmable_regions(image_)) {
+				try {
+					vmem_discard(region.mem, region.size);
+				} catch (const std::system_error &) {
+					/* the pages simply stay resident */
+					continue;
+				}
+				const auto rva = static_cast<const char *>(region.mem)
+				               - static_cast<const char *>(image_.rva_to_ptr(0));
+				const auto first = rva / vmem_page_size();
+				std::fill_n(trimmed_pages.begin() + first, region.size / vmem_page_size(), true);
+				if (stats) stats->bytes_trimmed += region.size;
+			}
+		}
+	});
+	measure_load_phase(stats, LoadPhase::Populate, [&] {
+		if (options.populate != PopulatePolicy::None) {
+			elf_populate_image(image_, options.populate,
+			                   elf_populate_pages(image_, options, image_key_),
+			                   trimmed_pages, stats);
+		}
+	});
+	register_image(options.retain_symtab ? blob : nullptr, blob_size);
+	footprint_ = image_.vsize() + metadata_bytes();
+	try {
+		if (options.init_policy == InitPolicy::Eager) {
+			measure_load_phase(stats, LoadPhase::Initialize, [&] {
+				init_->ensure([&] { elf_initialize_image(image_); });
+			});
+		} else {
+			schedule_initialize(options.init_policy, options.init_executor);
+		}
+	} catch (...) {
+		unregister_image();
+		throw;
 	}
-	elf_apply_memory_permissions(image_);
-	elf_initialize_image(image_);
+} catch (...) {
+	elf_unload_image(mapped.image, mapped.shared != nullptr);
+	throw;
 }
 
 template <class ElfN>
 void elf_run_image_fini_array(const ElfImageR<ElfN> & image,
                               const ElfDynamicTable<ElfN> & dyn_table)
 {
-	for (const auto fini_rva : dyn_table.fini_array()) {
-		if (fini_rva == 0 || fini_rva == -1) continue;
-		const auto fini_ptr = image.rva_to_ptr(fini_rva);
-		reinterpret_cast<fn_ptr_t>(fini_ptr)();
+	for (const auto fini_addr : dyn_table.fini_array()) {
+		if (fini_addr == 0 || fini_addr == -1) continue;
+		reinterpret_cast<fn_ptr_t>(fini_addr)();
 	}
 }
 
@@ -379,26 +1681,127 @@ void elf_run_image_fini(const ElfImageR<ElfN> & image,
 {
 	for (const auto & dyn : dyn_table.entries()) {
 		if (dyn.d_tag == DT_FINI) {
-			const auto fini_ptr = image.rva_to_ptr(dyn.d_un.d_ptr);
+			const auto fini_ptr = image.vaddr_to_ptr(dyn.d_un.d_ptr);
 			return reinterpret_cast<fn_ptr_t>(fini_ptr)();
 		}
 	}
 }
 
 template <class ElfN>
-void elf_unload_image(ElfImageRw<ElfN> & image)
+void elf_finalize_image(const ElfImageR<ElfN> & image)
 {
 	if (const auto dyn_table = image.dynamic_table()) {
 		elf_run_image_fini_array(image, *dyn_table);
 		elf_run_image_fini(image, *dyn_table);
 	}
-	vmem_free(image.rva_to_ptr(0), image.vsize());
+}
+
+template <class ElfN>
+void elf_unload_image(ElfImageRw<ElfN> & image, bool shared)
+{
+	if (shared)
+		SharedImage::unmap(image.rva_to_ptr(0), image.vsize());
+	else
+		vmem_free(image.rva_to_ptr(0), image.vsize());
+}
+
+template <class ElfN>
+void ElfModule<ElfN>::register_image(const void * blob, std::size_t blob_size)
+{
+	name_ = elf_module_name(image_);
+	address_table_.set_base(image_.load_bias());
+	address_table_.add_dynamic_symbols(image_);
+	if (blob) address_table_.retain_symtab({ blob, blob_size });
+	address_table_.build();
+
+	const auto phdr_range = image_.phdrs();
+	phdrs_.assign(phdr_range.begin(), phdr_range.end());
+	frames_ = nullptr;
+	const void * eh_frame_hdr = nullptr;
+	for (const auto & phdr : phdrs_) {
+		if (phdr.p_type == PT_GNU_EH_FRAME)
+			eh_frame_hdr = image_.rva_to_ptr(phdr.p_vaddr - image_.vbase());
+	}
+
+	ModuleInfo info;
+	info.module = this;
+	info.name = name_.c_str();
+	info.base = image_.rva_to_ptr(0);
+	info.size = image_.vsize();
+	ImageHeaders headers;
+	headers.load_bias = image_.load_bias();
+	headers.phdrs = phdrs_.data();
+	headers.phnum = phdrs_.size();
+	headers.eh_frame_hdr = eh_frame_hdr;
+
+	/* The perf map goes first so that a failure leaves nothing to undo. */
+	if (perf_outputs_ != PerfOutputNone)
+		elf_write_perf_map(image_, name_, address_table_, perf_outputs_);
+	try {
+		if (eh_frame_hdr)
+			frames_ = unwind_register_frames(eh_frame_hdr);
+		address_index_insert(info, &address_table_, headers);
+	} catch (...) {
+		unwind_deregister_frames(frames_);
+		frames_ = nullptr;
+		if (perf_outputs_ != PerfOutputNone)
+			perf_map_unload(elf_perf_image(image_, name_), perf_outputs_);
+		throw;
+	}
+}
+
+template <class ElfN>
+void ElfModule<ElfN>::unregister_image()
+{
+	address_index_remove(this);
+	unwind_deregister_frames(frames_);
+	frames_ = nullptr;
+	if (perf_outputs_ != PerfOutputNone)
+		perf_map_unload(elf_perf_image(image_, name_), perf_outputs_);
+}
+
+/*
+	Deferred initializers run on the first lookup that finds a symbol. A
+	background task only holds the latch and a copy of the image view, so
+	a module destroyed before the task runs simply cancels it; one destroyed
+	while it runs waits for it in ~ElfModule.
+ */
+template <class ElfN>
+void ElfModule<ElfN>::schedule_initialize(InitPolicy policy, const Executor & executor)
+{
+	if (policy != InitPolicy::Background) return;
+	std::function<void ()> task = [latch = init_, image = ElfImageR<ElfN> { image_ }] {
+		try {
+			latch->run_if_pending([&] { elf_initialize_image(image); });
+		} catch (...) {
+			/* left pending; the next lookup reruns it and sees the error */
+		}
+	};
+	if (executor)
+		executor(std::move(task));
+	else
+		run_background_init(std::move(task));
+}
+
+template <class ElfN>
+void ElfModule<ElfN>::ensure_initialized() const
+{
+	init_->ensure([this] { elf_initialize_image(image_); });
+}
+
+template <class ElfN>
+void ElfModule<ElfN>::wait_initialized() const
+{
+	init_->wait([this] { elf_initialize_image(image_); });
 }
 
 template <class ElfN>
 ElfModule<ElfN>::~ElfModule()
 {
-	elf_unload_image(image_);
+	if (init_->cancel())
+		elf_finalize_image(image_);
+	unregister_image();
+	elf_unload_image(image_, shared_image_ != nullptr);
 }
 
 template <class ElfN>
@@ -420,20 +1823,121 @@ std::uintptr_t elf_find_symbol(const ElfImageR<ElfN> & image,
 	const auto & str_table = dyn_table->string_table();
 	const auto sym = hash_table.find_symbol(sym_table, str_table, sym_name);
 	if (!sym || !elf_is_public_symbol<ElfN>(*sym)) return 0;
-	const auto value = image.rva_to_ptr(sym->st_value);
+	const auto value = image.vaddr_to_ptr(sym->st_value);
 	return reinterpret_cast<std::uintptr_t>(value);
 }
 
+template <class ElfN>
+void elf_find_symbols(const ElfImageR<ElfN> & image,
+                      const std::string * sym_names, std::size_t count,
+                      std::uintptr_t * values)
+{
+	std::fill(values, values + count, 0);
+	const auto & dyn_table = image.dynamic_table();
+	if (!dyn_table) return;
+	const auto & hash_table = dyn_table->hash_table();
+	const auto & sym_table = dyn_table->symbol_table();
+	const auto & str_table = dyn_table->string_table();
+	std::vector<boost::optional<Elf_Sym<ElfN>>> syms(count);
+	hash_table.find_symbols(sym_table, str_table, sym_names, count, syms.data());
+	for (std::size_t i = 0; i < count; ++i) {
+		if (!syms[i] || !elf_is_public_symbol<ElfN>(*syms[i])) continue;
+		const auto value = image.vaddr_to_ptr(syms[i]->st_value);
+		values[i] = reinterpret_cast<std::uintptr_t>(value);
+	}
+}
+
 template <class ElfN>
 fn_ptr_t ElfModule<ElfN>::get_raw_proc(const std::string & name) const
 {
-	return reinterpret_cast<fn_ptr_t>(elf_find_symbol(image_, name));
+	const auto proc = reinterpret_cast<fn_ptr_t>(elf_find_symbol(image_, name));
+	if (proc) ensure_initialized();
+	return proc;
 }
 
 template <class ElfN>
 data_ptr_t ElfModule<ElfN>::get_raw_data(const std::string & name) const
 {
-	return reinterpret_cast<data_ptr_t>(elf_find_symbol(image_, name));
+	const auto data = reinterpret_cast<data_ptr_t>(elf_find_symbol(image_, name));
+	if (data) ensure_initialized();
+	return data;
+}
+
+template <class ElfN>
+void ElfModule<ElfN>::find_symbols(const std::string * names, const SymbolKind *,
+                                   std::size_t count, void ** addresses) const
+{
+	std::vector<std::uintptr_t> values(count);
+	elf_find_symbols(image_, names, count, values.data());
+	for (std::size_t i = 0; i < count; ++i)
+		addresses[i] = reinterpret_cast<void *>(values[i]);
+	if (std::any_of(values.begin(), values.end(), [] (std::uintptr_t value) { return value != 0; }))
+		ensure_initialized();
+}
+
+template <class ElfN>
+std::vector<MemoryRegion> ElfModule<ElfN>::snapshot_regions() const
+{
+	ensure_initialized();
+	const auto page_size = vmem_page_size();
+	std::vector<MemoryRegion> regions;
+	for (const auto & phdr : phdrs_) {
+		if (phdr.p_type != PT_LOAD || !(phdr.p_flags & PF_W)) continue;
+		const auto seg_rva = (phdr.p_vaddr - image_.vbase()) & ~(page_size - 1);
+		const auto seg_end = elf_align(phdr.p_vaddr - image_.vbase() + phdr.p_memsz, page_size);
+		regions.push_back({ const_cast<void *>(image_.rva_to_ptr(seg_rva)), seg_end - seg_rva });
+	}
+	return regions;
+}
+
+template <class ElfN>
+std::string ElfModule<ElfN>::profile_key() const
+{
+	return image_key_;
+}
+
+template <class ElfN>
+std::vector<std::size_t> ElfModule<ElfN>::touched_pages() const
+{
+	const auto mapped = vmem_mapped_pages(image_.rva_to_ptr(0), image_.vsize());
+	std::vector<std::size_t> pages;
+	for (std::size_t page = 0; page < mapped.size(); ++page)
+		if (mapped[page]) pages.push_back(page);
+	return pages;
+}
+
+template <class ElfN>
+MemoryUsage ElfModule<ElfN>::memory_usage() const
+{
+	auto usage = elf_image_memory_usage(image_, relocated_pages_);
+	usage.metadata_bytes = metadata_bytes();
+	return usage;
+}
+
+template <class ElfN>
+std::size_t ElfModule<ElfN>::footprint() const
+{
+	return footprint_;
+}
+
+template <class ElfN>
+std::size_t ElfModule<ElfN>::metadata_bytes() const
+{
+	return sizeof(*this) + sizeof(InitLatch)
+	     + deps_.capacity() * sizeof(deps_[0])
+	     + name_.capacity()
+	     + phdrs_.capacity() * sizeof(phdrs_[0])
+	     + relocated_pages_.capacity() * sizeof(std::uintptr_t)
+	     + address_table_.memory_size();
+}
+
+template <class ElfN>
+RelocationReport ElfModule<ElfN>::relocation_report() const
+{
+	if (!relocation_report_) return {};
+	auto report = *relocation_report_;
+	report.module = name_;
+	return report;
 }
 
 }
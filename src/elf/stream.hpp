@@ -0,0 +1,146 @@
+#ifndef TLDR_SRC_ELF_STREAM_HPP_
+#define TLDR_SRC_ELF_STREAM_HPP_
+
+#include "module.hpp"
+#include "../stream_reader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace tldr {
+
+template <class ElfN>
+bool elf_read_stream_headers(StreamReader & reader, std::vector<char> & headers)
+{
+	if (!ElfImageR<ElfN>::is_valid(headers.data(), headers.size()))
+		return false;
+
+	Elf_Ehdr<ElfN> ehdr;
+	switch (headers[EI_DATA]) {
+	case ELFDATA2LSB: le_read(headers.data(), headers.size(), ehdr); break;
+	case ELFDATA2MSB: be_read(headers.data(), headers.size(), ehdr); break;
+	default: throw LoadError("invalid elf image (EI_DATA)");
+	}
+
+	if (!elf_program_headers_fit<ElfN>(ehdr, stream_max_headers_size))
+		throw LoadError("invalid elf image (program headers out of bounds)");
+	const std::size_t phdrs_end = ehdr.e_phoff + ehdr.e_phnum * ehdr.e_phentsize;
+	if (phdrs_end > headers.size()) {
+		const auto have = headers.size();
+		headers.resize(phdrs_end);
+		reader.read_exact(headers.data() + have, phdrs_end - have);
+	}
+	return ElfModule<ElfN>::is_valid(headers.data(), headers.size());
+}
+
+template <class ElfN>
+class ElfStreamPlacement
+{
+public:
+	ElfStreamPlacement(const ElfImageR<ElfN> & image, void * mem,
+	                   const std::vector<char> & headers);
+
+	std::size_t copy_consumed(std::uintptr_t offset, std::uintptr_t end, char * dst) const;
+	void add(const Elf_Phdr<ElfN> & phdr);
+
+private:
+	const ElfImageR<ElfN> & image_;
+	void * mem_;
+	const std::vector<char> & headers_;
+	std::vector<Elf_Phdr<ElfN>> placed_;
+};
+
+template <class ElfN>
+ElfStreamPlacement<ElfN>::ElfStreamPlacement(const ElfImageR<ElfN> & image, void * mem,
+                                             const std::vector<char> & headers)
+	: image_ { image }, mem_ { mem }, headers_ { headers } {}
+
+template <class ElfN>
+std::size_t ElfStreamPlacement<ElfN>::copy_consumed(std::uintptr_t offset,
+                                                    std::uintptr_t end,
+                                                    char * dst) const
+{
+	if (offset < headers_.size()) {
+		const auto count = std::min<std::uintptr_t>(end, headers_.size()) - offset;
+		std::memcpy(dst, headers_.data() + offset, count);
+		return count;
+	}
+	for (const auto & phdr : placed_) {
+		const auto placed_end = phdr.p_offset + phdr.p_filesz;
+		if (offset >= phdr.p_offset && offset < placed_end) {
+			const auto count = std::min<std::uintptr_t>(end, placed_end) - offset;
+			const auto src = apply_offset<char>(mem_, phdr.p_vaddr - image_.vbase());
+			std::memcpy(dst, src + (offset - phdr.p_offset), count);
+			return count;
+		}
+	}
+	throw LoadError("invalid elf image (segment data already skipped)");
+}
+
+template <class ElfN>
+void ElfStreamPlacement<ElfN>::add(const Elf_Phdr<ElfN> & phdr)
+{
+	placed_.push_back(phdr);
+}
+
+template <class ElfN>
+void elf_stream_program_headers(const ElfImageR<ElfN> & image, void * mem,
+                                StreamReader & reader,
+                                const std::vector<char> & headers)
+{
+	std::vector<Elf_Phdr<ElfN>> loads;
+	for (const auto & phdr : image.phdrs()) {
+		if (phdr.p_type == PT_LOAD) {
+			if (phdr.p_filesz > phdr.p_memsz)
+				throw LoadError("invalid elf image (p_filesz > p_memsz)");
+			if (phdr.p_vaddr - image.vbase() + phdr.p_memsz > image.vsize()
+			    || phdr.p_filesz > UINTPTR_MAX - phdr.p_offset)
+				throw LoadError("invalid elf image (PT_LOAD out of bounds)");
+			loads.push_back(phdr);
+		}
+	}
+	std::sort(loads.begin(), loads.end(), [] (const auto & lhs, const auto & rhs) {
+		return lhs.p_offset < rhs.p_offset;
+	});
+
+	ElfStreamPlacement<ElfN> placement { image, mem, headers };
+	for (const auto & phdr : loads) {
+		const auto dst = apply_offset<char>(mem, phdr.p_vaddr - image.vbase());
+		const auto end = phdr.p_offset + phdr.p_filesz;
+		auto offset = static_cast<std::uintptr_t>(phdr.p_offset);
+		while (offset < end && offset < reader.position())
+			offset += placement.copy_consumed(offset, end, dst + (offset - phdr.p_offset));
+		if (offset < end) {
+			reader.skip_to(offset);
+			reader.read_exact(dst + (offset - phdr.p_offset), end - offset);
+		}
+		placement.add(phdr);
+	}
+}
+
+/* Placed like elf_map_image does: at pref_base if set, else where the image was linked. */
+template <class ElfN>
+ElfImageRw<ElfN> elf_stream_image(StreamReader & reader,
+                                  const std::vector<char> & headers,
+                                  LoadStats * stats = nullptr,
+                                  std::uintptr_t pref_base = 0)
+{
+	const ElfImageR<ElfN> image { headers.data(), headers.size() };
+	const auto image_mem = vmem_alloc(image.vsize(), pref_base ? pref_base : image.vbase());
+	try {
+		elf_stream_program_headers(image, image_mem, reader, headers);
+		if (stats) {
+			stats->bytes_mapped += image.vsize();
+			stats->bytes_copied += elf_image_file_size(image);
+		}
+		return { image_mem, image.vsize() };
+	} catch (const std::exception & e) {
+		vmem_free(image_mem, image.vsize());
+		throw;
+	}
+}
+
+}
+
+#endif
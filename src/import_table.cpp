@@ -0,0 +1,89 @@
+#include <config.h>
+#include <tldr/import_table.hpp>
+
+namespace tldr {
+
+namespace {
+
+std::string missing_symbols_message(const std::vector<std::string> & missing)
+{
+	std::string message = "required symbols not found:";
+	for (const auto & name : missing)
+		message += " " + name;
+	return message;
+}
+
+}
+
+MissingSymbolsError::MissingSymbolsError(std::vector<std::string> missing)
+	: LoadError { missing_symbols_message(missing) }
+	, missing_ { std::move(missing) } {}
+
+const std::vector<std::string> & MissingSymbolsError::missing() const
+{
+	return missing_;
+}
+
+ImportTable::ImportTable() : bound_ { false } {}
+
+ImportTable::~ImportTable() = default;
+
+std::size_t ImportTable::add(std::string name, SymbolKind kind, int flags)
+{
+	names_.push_back(std::move(name));
+	kinds_.push_back(kind);
+	flags_.push_back(flags);
+	addresses_.push_back(nullptr);
+	bound_ = false;
+	return names_.size() - 1;
+}
+
+std::size_t ImportTable::size() const
+{
+	return names_.size();
+}
+
+const std::vector<std::string> & ImportTable::names() const
+{
+	return names_;
+}
+
+const std::vector<SymbolKind> & ImportTable::kinds() const
+{
+	return kinds_;
+}
+
+SymbolKind ImportTable::kind(std::size_t index) const
+{
+	return kinds_[index];
+}
+
+int ImportTable::flags(std::size_t index) const
+{
+	return flags_[index];
+}
+
+void ImportTable::set_address(std::size_t index, void * address)
+{
+	addresses_[index] = address;
+	bound_ = false;
+}
+
+bool ImportTable::is_bound() const
+{
+	return bound_;
+}
+
+void ImportTable::validate()
+{
+	std::vector<std::string> missing;
+	for (std::size_t i = 0; i < size(); ++i) {
+		if (!addresses_[i] && !(flags_[i] & ImportOptional))
+			missing.push_back(names_[i]);
+	}
+	if (!missing.empty())
+		throw MissingSymbolsError(std::move(missing));
+	bound_ = true;
+}
+
+}
@@ -0,0 +1,99 @@
+#include <config.h>
+#include "init_latch.hpp"
+
+#include <tldr/async_load.hpp>
+
+#include <algorithm>
+
+namespace tldr {
+
+InitLatch::InitLatch() : state_ { Pending }, done_ { false } {}
+
+bool InitLatch::is_done() const
+{
+	return done_.load(std::memory_order_acquire);
+}
+
+void InitLatch::ensure(const std::function<void ()> & init)
+{
+	if (is_done()) return;
+	std::unique_lock<std::mutex> lock { mutex_ };
+	while (!run(lock, init)) {}
+}
+
+void InitLatch::run_if_pending(const std::function<void ()> & init)
+{
+	std::unique_lock<std::mutex> lock { mutex_ };
+	if (state_ == Pending)
+		run(lock, init);
+}
+
+void InitLatch::wait(const std::function<void ()> & init)
+{
+	if (is_done()) return;
+	std::unique_lock<std::mutex> lock { mutex_ };
+	state_changed_.wait(lock, [this] {
+		return state_ != Running || runner_ == std::this_thread::get_id();
+	});
+	if (state_ == Pending && error_)
+		std::rethrow_exception(error_);
+	while (!run(lock, init)) {}
+}
+
+bool InitLatch::cancel()
+{
+	std::unique_lock<std::mutex> lock { mutex_ };
+	state_changed_.wait(lock, [this] { return state_ != Running; });
+	const bool was_done = state_ == Done;
+	state_ = Cancelled;
+	return was_done;
+}
+
+bool InitLatch::run(std::unique_lock<std::mutex> & lock, const std::function<void ()> & init)
+{
+	switch (state_) {
+	case Done:
+	case Cancelled:
+		return true;
+	case Running:
+		if (runner_ == std::this_thread::get_id()) return true;
+		state_changed_.wait(lock);
+		return false;
+	case Pending:
+		break;
+	}
+
+	state_ = Running;
+	runner_ = std::this_thread::get_id();
+	lock.unlock();
+	try {
+		init();
+	} catch (...) {
+		lock.lock();
+		state_ = Pending;
+		runner_ = {};
+		error_ = std::current_exception();
+		state_changed_.notify_all();
+		throw;
+	}
+	lock.lock();
+	state_ = Done;
+	runner_ = {};
+	error_ = nullptr;
+	done_.store(true, std::memory_order_release);
+	state_changed_.notify_all();
+	return true;
+}
+
+void run_background_init(std::function<void ()> task)
+{
+	static LoadExecutor executor {
+		std::max(1u, std::thread::hardware_concurrency() / 2), 256
+	};
+	executor.submit([task] {
+		task();
+		return std::shared_ptr<Module>();
+	});
+}
+
+}
@@ -0,0 +1,58 @@
+#ifndef TLDR_SRC_INITLATCH_HPP_
+#define TLDR_SRC_INITLATCH_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace tldr {
+
+/*
+	Runs a module's initializers at most once, from whichever caller gets
+	there first; concurrent callers wait for it to finish, while lookups made
+	by the initializers themselves pass straight through. A failed run leaves
+	the latch pending so the next caller of ensure retries, while wait
+	rethrows its error. Once cancelled the latch never runs, which lets a
+	queued background task outlive its module.
+ */
+class InitLatch
+{
+public:
+	InitLatch();
+
+	InitLatch(const InitLatch &) = delete;
+	InitLatch & operator=(const InitLatch &) = delete;
+
+	bool is_done() const;
+	void ensure(const std::function<void ()> & init);
+	void run_if_pending(const std::function<void ()> & init);
+	void wait(const std::function<void ()> & init);
+	bool cancel();
+
+private:
+	enum State { Pending, Running, Done, Cancelled };
+
+	bool run(std::unique_lock<std::mutex> & lock, const std::function<void ()> & init);
+
+private:
+	std::mutex mutex_;
+	std::condition_variable state_changed_;
+	State state_;
+	std::thread::id runner_;
+	std::exception_ptr error_;
+	std::atomic<bool> done_;
+};
+
+/*
+	Runs a background initializer on a small process-wide pool. Tasks that
+	do not fit in its queue are dropped, leaving their latch to the first
+	lookup.
+ */
+void run_background_init(std::function<void ()> task);
+
+}
+
+#endif
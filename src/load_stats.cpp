@@ -0,0 +1,19 @@
+#include <config.h>
+#include <tldr/load_stats.hpp>
+
+namespace tldr {
+
+const char * to_string(LoadPhase phase)
+{
+	switch (phase) {
+	case LoadPhase::MapProgramHeaders: return "map_program_headers";
+	case LoadPhase::ResolveImports: return "resolve_imports";
+	case LoadPhase::ApplyRelocations: return "apply_relocations";
+	case LoadPhase::ApplyPermissions: return "apply_permissions";
+	case LoadPhase::Populate: return "populate";
+	case LoadPhase::Initialize: return "initialize";
+	}
+	return "unknown";
+}
+
+}
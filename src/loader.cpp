@@ -1,7 +1,12 @@
 #include <config.h>
 #include <tldr/loader.hpp>
 
+#include <tldr/async_load.hpp>
+#include <tldr/memory_usage.hpp>
 #include <tldr/module.hpp>
+#include <tldr/relocation_report.hpp>
+
+#include <unordered_set>
 
 namespace tldr {
 
@@ -22,21 +27,93 @@ namespace {
 
 ModuleResolver::~ModuleResolver() = default;
 
-Loader::Loader() : resolver_ { &null_module_resolver } {}
+Loader::Loader()
+	: resolver_ { &null_module_resolver }, retained_bytes_ { 0 }, load_timeout_ { 0 } {}
 
 std::shared_ptr<Module> Loader::get_module(const std::string & name) const
 {
+	std::unique_lock<std::mutex> lock { mutex_ };
 	const auto mod_iter = modules_.find(name);
 	if (mod_iter != modules_.end()) {
 		const auto mod_ref = mod_iter->second.lock();
-		if (mod_ref) return mod_ref;
+		if (mod_ref) {
+			++counters_.hits;
+			if (retention_enabled()) retain(name, mod_ref);
+			return mod_ref;
+		}
 		modules_.erase(mod_iter);
 	}
-	return resolver_->get_module(name);
+
+	const auto flight_iter = in_flight_.find(name);
+	if (flight_iter != in_flight_.end()
+	 && flight_iter->second.loader != std::this_thread::get_id()) {
+		const auto result = flight_iter->second.result;
+		const auto timeout = load_timeout_;
+		++counters_.coalesced;
+		lock.unlock();
+		if (timeout.count() != 0
+		 && result.wait_for(timeout) == std::future_status::timeout)
+			throw LoadTimeoutError("timed out waiting for module " + name);
+		return result.get();
+	}
+	if (flight_iter != in_flight_.end()) {
+		/* the resolver asked for the module it is loading; let it recurse */
+		++counters_.misses;
+		const auto resolver = resolver_;
+		lock.unlock();
+		return resolver->get_module(name);
+	}
+
+	++counters_.misses;
+	std::promise<std::shared_ptr<Module>> promise;
+	in_flight_.emplace(name, InFlight { promise.get_future().share(), std::this_thread::get_id() });
+	const auto resolver = resolver_;
+	lock.unlock();
+
+	/* drops the entry however the load ends, before an unset promise breaks */
+	struct InFlightEraser
+	{
+		const Loader & loader;
+		const std::string & name;
+
+		~InFlightEraser()
+		{
+			std::lock_guard<std::mutex> lock { loader.mutex_ };
+			loader.in_flight_.erase(name);
+		}
+	} eraser { *this, name };
+
+	try {
+		const auto module = resolver->get_module(name);
+		if (module) {
+			std::lock_guard<std::mutex> retain_lock { mutex_ };
+			if (retention_enabled()) {
+				modules_[name] = module;
+				retain(name, module);
+			}
+		}
+		promise.set_value(module);
+		return module;
+	} catch (...) {
+		promise.set_exception(std::current_exception());
+		throw;
+	}
+}
+
+LoadHandle Loader::get_module_async(LoadExecutor & executor, const std::string & name) const
+{
+	return get_module_async(executor, name, {});
+}
+
+LoadHandle Loader::get_module_async(LoadExecutor & executor, const std::string & name,
+                                    const AsyncLoadOptions & options) const
+{
+	return executor.submit([this, name] { return get_module(name); }, options);
 }
 
 void Loader::set_module(const std::string & name, std::shared_ptr<Module> module)
 {
+	std::lock_guard<std::mutex> lock { mutex_ };
 	const auto result = modules_.emplace(name, std::move(module));
 	if (!result.second)
 		result.first->second = std::move(module);
@@ -44,12 +121,134 @@ void Loader::set_module(const std::string & name, std::shared_ptr<Module> module
 
 void Loader::set_module_resolver(const ModuleResolver * resolver)
 {
+	std::lock_guard<std::mutex> lock { mutex_ };
 	resolver_ = resolver ? resolver : &null_module_resolver;
 }
 
 void Loader::remove_module(const std::string & name)
 {
+	std::lock_guard<std::mutex> lock { mutex_ };
 	modules_.erase(name);
+	release(name);
+}
+
+void Loader::set_retention_policy(const RetentionPolicy & policy)
+{
+	std::lock_guard<std::mutex> lock { mutex_ };
+	retention_ = policy;
+	if (retention_enabled()) {
+		evict();
+	} else {
+		retained_index_.clear();
+		retained_.clear();
+		retained_bytes_ = 0;
+	}
+}
+
+void Loader::clear_retained()
+{
+	std::lock_guard<std::mutex> lock { mutex_ };
+	retained_index_.clear();
+	retained_.clear();
+	retained_bytes_ = 0;
+}
+
+std::size_t Loader::retained_bytes() const
+{
+	std::lock_guard<std::mutex> lock { mutex_ };
+	return retained_bytes_;
+}
+
+LoaderCounters Loader::counters() const
+{
+	std::lock_guard<std::mutex> lock { mutex_ };
+	return counters_;
+}
+
+void Loader::set_load_timeout(std::chrono::milliseconds timeout)
+{
+	std::lock_guard<std::mutex> lock { mutex_ };
+	load_timeout_ = timeout;
+}
+
+bool Loader::retention_enabled() const
+{
+	return retention_.max_modules != 0 || retention_.max_bytes != 0;
+}
+
+/*
+	Moves the module to the front of the LRU list, adding it if needed,
+	then evicts from the back until both limits hold again. The module just
+	used is never evicted, even if it alone exceeds the byte budget.
+ */
+void Loader::retain(const std::string & name, std::shared_ptr<Module> module) const
+{
+	const auto index_iter = retained_index_.find(name);
+	if (index_iter != retained_index_.end()) {
+		const auto entry = index_iter->second;
+		if (entry->module == module) {
+			retained_.splice(retained_.begin(), retained_, entry);
+			return;
+		}
+		release(name);
+	}
+	const auto bytes = module->footprint();
+	retained_.push_front({ name, std::move(module), bytes });
+	retained_index_.emplace(name, retained_.begin());
+	retained_bytes_ += bytes;
+	evict();
+}
+
+void Loader::release(const std::string & name) const
+{
+	const auto index_iter = retained_index_.find(name);
+	if (index_iter == retained_index_.end()) return;
+	retained_bytes_ -= index_iter->second->bytes;
+	retained_.erase(index_iter->second);
+	retained_index_.erase(index_iter);
+}
+
+void Loader::evict() const
+{
+	const auto over_budget = [this] {
+		return (retention_.max_modules && retained_.size() > retention_.max_modules)
+		    || (retention_.max_bytes && retained_bytes_ > retention_.max_bytes);
+	};
+	while (retained_.size() > 1 && over_budget()) {
+		const auto & victim = retained_.back();
+		retained_bytes_ -= victim.bytes;
+		retained_index_.erase(victim.name);
+		retained_.pop_back();
+		++counters_.evictions;
+	}
+}
+
+MemoryUsage Loader::memory_usage() const
+{
+	std::lock_guard<std::mutex> lock { mutex_ };
+	MemoryUsage usage;
+	std::unordered_set<const Module *> counted;
+	for (const auto & entry : modules_) {
+		const auto module = entry.second.lock();
+		if (module && counted.insert(module.get()).second)
+			usage += module->memory_usage();
+	}
+	return usage;
+}
+
+/* One report per module that recorded one, each module once. */
+std::vector<RelocationReport> Loader::relocation_reports() const
+{
+	std::lock_guard<std::mutex> lock { mutex_ };
+	std::vector<RelocationReport> reports;
+	std::unordered_set<const Module *> counted;
+	for (const auto & entry : modules_) {
+		const auto module = entry.second.lock();
+		if (!module || !counted.insert(module.get()).second) continue;
+		auto report = module->relocation_report();
+		if (report.page_size) reports.push_back(std::move(report));
+	}
+	return reports;
 }
 
 }
@@ -0,0 +1,16 @@
+#include <config.h>
+#include <tldr/memory_usage.hpp>
+
+namespace tldr {
+
+MemoryUsage & MemoryUsage::operator+=(const MemoryUsage & other)
+{
+	reserved_bytes += other.reserved_bytes;
+	resident_bytes += other.resident_bytes;
+	relocated_bytes += other.relocated_bytes;
+	metadata_bytes += other.metadata_bytes;
+	segments.insert(segments.end(), other.segments.begin(), other.segments.end());
+	return *this;
+}
+
+}
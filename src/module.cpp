@@ -1,8 +1,59 @@
 #include "config.h"
 #include <tldr/module.hpp>
 
+#include <tldr/import_table.hpp>
+#include <tldr/memory_usage.hpp>
+#include <tldr/relocation_report.hpp>
+
+#include <vector>
+
 namespace tldr {
 
 Module::~Module() = default;
 
+void Module::find_symbols(const std::string * names, const SymbolKind * kinds,
+                          std::size_t count, void ** addresses) const
+{
+	for (std::size_t i = 0; i < count; ++i) {
+		switch (kinds[i]) {
+		case SymbolKind::Proc:
+			addresses[i] = reinterpret_cast<void *>(get_raw_proc(names[i]));
+			break;
+		case SymbolKind::Data:
+			addresses[i] = get_raw_data(names[i]);
+			break;
+		}
+	}
+}
+
+void Module::bind(ImportTable & table) const
+{
+	std::vector<void *> addresses(table.size());
+	find_symbols(table.names().data(), table.kinds().data(), table.size(),
+	             addresses.data());
+	for (std::size_t i = 0; i < table.size(); ++i)
+		table.set_address(i, addresses[i]);
+	table.validate();
+}
+
+MemoryUsage Module::memory_usage() const
+{
+	return {};
+}
+
+RelocationReport Module::relocation_report() const
+{
+	return {};
+}
+
+std::size_t Module::footprint() const
+{
+	const auto usage = memory_usage();
+	return usage.reserved_bytes + usage.metadata_bytes;
+}
+
+void Module::wait_initialized() const
+{
+}
+
 }
@@ -0,0 +1,140 @@
+#include <config.h>
+#include <tldr/module_pool.hpp>
+
+#include "module_snapshot.hpp"
+
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace tldr {
+
+namespace {
+
+struct PooledInstance
+{
+	std::shared_ptr<Module> module;
+	std::unique_ptr<ModuleSnapshot> snapshot;
+};
+
+}
+
+struct ModulePool::State
+{
+	State(const void * mem, std::size_t size, std::size_t capacity,
+	      const ModuleResolver & resolver, const LoadOptions & options)
+		: mem { mem }, size { size }, capacity { capacity }
+		, resolver { resolver }, options { options } {}
+
+	const void * mem;
+	std::size_t size;
+	std::size_t capacity;
+	const ModuleResolver & resolver;
+	LoadOptions options;
+
+	mutable std::mutex mutex;
+	std::vector<std::shared_ptr<PooledInstance>> idle;
+	std::size_t restoring = 0;
+	std::size_t loads = 0;
+	std::size_t bytes_restored = 0;
+
+	std::shared_ptr<PooledInstance> load();
+	void release(const std::shared_ptr<PooledInstance> & instance);
+};
+
+std::shared_ptr<PooledInstance> ModulePool::State::load()
+{
+	auto instance = std::make_shared<PooledInstance>();
+	instance->module = load_from_memory(mem, size, resolver, options);
+	if (!instance->module)
+		throw LoadError("unsupported module image");
+	const auto source = dynamic_cast<const SnapshotSource *>(instance->module.get());
+	if (!source)
+		throw LoadError("module image cannot be pooled");
+	instance->snapshot.reset(new ModuleSnapshot { source->snapshot_regions() });
+	std::lock_guard<std::mutex> lock { mutex };
+	++loads;
+	return instance;
+}
+
+/*
+	An instance is restored only if a slot is free for it, counting the
+	instances already being restored; the rest are simply unloaded. One
+	that fails to restore is unloaded too.
+ */
+void ModulePool::State::release(const std::shared_ptr<PooledInstance> & instance)
+{
+	{
+		std::lock_guard<std::mutex> lock { mutex };
+		if (idle.size() + restoring >= capacity) return;
+		++restoring;
+	}
+	std::size_t restored = 0;
+	bool reusable = true;
+	try {
+		restored = instance->snapshot->restore();
+	} catch (...) {
+		reusable = false;
+	}
+	std::lock_guard<std::mutex> lock { mutex };
+	--restoring;
+	bytes_restored += restored;
+	if (reusable)
+		idle.push_back(instance);
+}
+
+ModulePool::ModulePool(const void * mem, std::size_t size, std::size_t capacity,
+                       const ModuleResolver & resolver, const LoadOptions & options)
+	: state_ { std::make_shared<State>(mem, size, capacity, resolver, options) }
+{
+	state_->options.stats = nullptr;
+	state_->options.dedup = false;
+	state_->idle.reserve(capacity);
+	for (std::size_t i = 0; i < capacity; ++i) {
+		auto instance = state_->load();
+		state_->idle.push_back(std::move(instance));
+	}
+}
+
+ModulePool::~ModulePool() = default;
+
+std::shared_ptr<Module> ModulePool::acquire()
+{
+	std::shared_ptr<PooledInstance> instance;
+	{
+		std::lock_guard<std::mutex> lock { state_->mutex };
+		if (!state_->idle.empty()) {
+			instance = std::move(state_->idle.back());
+			state_->idle.pop_back();
+		}
+	}
+	if (!instance)
+		instance = state_->load();
+
+	const auto module = instance->module.get();
+	std::weak_ptr<State> pool = state_;
+	return { module, [pool, instance] (Module *) {
+		if (const auto state = pool.lock())
+			state->release(instance);
+	} };
+}
+
+std::size_t ModulePool::idle() const
+{
+	std::lock_guard<std::mutex> lock { state_->mutex };
+	return state_->idle.size();
+}
+
+std::size_t ModulePool::loads() const
+{
+	std::lock_guard<std::mutex> lock { state_->mutex };
+	return state_->loads;
+}
+
+std::size_t ModulePool::bytes_restored() const
+{
+	std::lock_guard<std::mutex> lock { state_->mutex };
+	return state_->bytes_restored;
+}
+
+}
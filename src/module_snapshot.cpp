@@ -0,0 +1,50 @@
+#include <config.h>
+#include "module_snapshot.hpp"
+#include "vmemory.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace tldr {
+
+SnapshotSource::~SnapshotSource() = default;
+
+ModuleSnapshot::ModuleSnapshot(std::vector<MemoryRegion> regions)
+	: regions_ { std::move(regions) }
+{
+	std::size_t total = 0;
+	for (const auto & region : regions_)
+		total += region.size;
+	data_.resize(total);
+	auto dst = data_.data();
+	for (const auto & region : regions_) {
+		std::memcpy(dst, region.mem, region.size);
+		dst += region.size;
+	}
+}
+
+std::size_t ModuleSnapshot::size() const
+{
+	return data_.size();
+}
+
+std::size_t ModuleSnapshot::restore() const
+{
+	const auto page_size = vmem_page_size();
+	std::size_t restored = 0;
+	auto src = data_.data();
+	for (const auto & region : regions_) {
+		const auto mem = static_cast<char *>(region.mem);
+		for (std::size_t offset = 0; offset < region.size; offset += page_size) {
+			const auto count = std::min(page_size, region.size - offset);
+			if (std::memcmp(mem + offset, src + offset, count) != 0) {
+				std::memcpy(mem + offset, src + offset, count);
+				restored += count;
+			}
+		}
+		src += region.size;
+	}
+	return restored;
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef TLDR_SRC_MODULESNAPSHOT_HPP_
+#define TLDR_SRC_MODULESNAPSHOT_HPP_
+
+#include <cstddef>
+#include <vector>
+
+namespace tldr {
+
+struct MemoryRegion
+{
+	void * mem;
+	std::size_t size;
+};
+
+/*
+	Implemented by modules whose mutable state lives in their own image,
+	so that a copy of those pages is enough to put the module back into a
+	just-initialized state.
+ */
+class SnapshotSource
+{
+public:
+	virtual ~SnapshotSource();
+	virtual std::vector<MemoryRegion> snapshot_regions() const = 0;
+};
+
+/*
+	A page-granular copy of a module's writable regions. restore() compares
+	each page against the copy and writes back only those that differ, which
+	keeps the cost proportional to the writable pages rather than the image.
+ */
+class ModuleSnapshot
+{
+public:
+	explicit ModuleSnapshot(std::vector<MemoryRegion> regions);
+
+	std::size_t size() const;
+	std::size_t restore() const;
+
+private:
+	std::vector<MemoryRegion> regions_;
+	std::vector<char> data_;
+};
+
+}
+
+#endif
@@ -0,0 +1,191 @@
+#include <config.h>
+#include <tldr/page_profile.hpp>
+
+#include "page_profile.hpp"
+#include "vmemory.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+namespace tldr {
+
+namespace {
+
+const char profile_magic[8] = { 't', 'l', 'd', 'r', 'p', 'g', 'p', '1' };
+
+struct PendingProfile
+{
+	std::weak_ptr<Module> module;
+	std::string key;
+	std::chrono::steady_clock::time_point deadline;
+};
+
+}
+
+PageProfileSource::~PageProfileSource() = default;
+
+struct PageProfileStore::State
+{
+	std::string directory;
+	std::chrono::milliseconds window;
+
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<PendingProfile> pending;
+	std::thread sampler;
+	bool stopping = false;
+
+	std::string path(const std::string & key) const;
+	void sample(const PendingProfile & profile, const PageProfileStore & store);
+	void run(const PageProfileStore & store);
+};
+
+std::string PageProfileStore::State::path(const std::string & key) const
+{
+	return directory + "/" + key + ".profile";
+}
+
+void PageProfileStore::State::sample(const PendingProfile & profile,
+                                     const PageProfileStore & store)
+{
+	const auto module = profile.module.lock();
+	if (!module) return;
+	const auto source = dynamic_cast<const PageProfileSource *>(module.get());
+	try {
+		store.save(profile.key, source->touched_pages());
+	} catch (const std::exception &) {
+		/* A profile is only a hint; the next load records it again. */
+	}
+}
+
+void PageProfileStore::State::run(const PageProfileStore & store)
+{
+	std::unique_lock<std::mutex> lock { mutex };
+	while (!stopping) {
+		if (pending.empty()) {
+			wake.wait(lock);
+			continue;
+		}
+		const auto next = std::min_element(pending.begin(), pending.end(),
+		                                   [] (const PendingProfile & a, const PendingProfile & b) {
+			return a.deadline < b.deadline;
+		});
+		if (std::chrono::steady_clock::now() < next->deadline) {
+			wake.wait_until(lock, next->deadline);
+			continue;
+		}
+		const auto profile = std::move(*next);
+		pending.erase(next);
+		lock.unlock();
+		sample(profile, store);
+		lock.lock();
+	}
+}
+
+PageProfileStore::PageProfileStore(std::string directory, std::chrono::milliseconds window)
+	: state_ { new State }
+{
+	state_->directory = std::move(directory);
+	state_->window = window;
+}
+
+PageProfileStore::~PageProfileStore()
+{
+	{
+		std::lock_guard<std::mutex> lock { state_->mutex };
+		state_->stopping = true;
+	}
+	state_->wake.notify_all();
+	if (state_->sampler.joinable())
+		state_->sampler.join();
+}
+
+bool PageProfileStore::load(const std::string & key, std::size_t max_pages,
+                            std::vector<std::size_t> & pages) const
+{
+	std::ifstream file { state_->path(key), std::ios::binary };
+	char magic[sizeof(profile_magic)];
+	std::uint64_t page_size = 0, count = 0;
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char *>(&page_size), sizeof(page_size));
+	file.read(reinterpret_cast<char *>(&count), sizeof(count));
+	if (!file || std::memcmp(magic, profile_magic, sizeof(magic)) != 0
+	    || page_size != vmem_page_size() || count > max_pages)
+		return false;
+	std::vector<std::uint64_t> indices(count);
+	file.read(reinterpret_cast<char *>(indices.data()), count * sizeof(indices[0]));
+	if (!file) return false;
+	for (const auto index : indices)
+		if (index >= max_pages) return false;
+	pages.assign(indices.begin(), indices.end());
+	return true;
+}
+
+/*
+	Written to a temporary file first, so that a concurrent load never sees
+	a partial profile.
+ */
+void PageProfileStore::save(const std::string & key, const std::vector<std::size_t> & pages) const
+{
+	const auto path = state_->path(key);
+	const auto temp_path = path + ".tmp";
+	{
+		std::ofstream file { temp_path, std::ios::binary | std::ios::trunc };
+		const std::uint64_t page_size = vmem_page_size(), count = pages.size();
+		const std::vector<std::uint64_t> indices(pages.begin(), pages.end());
+		file.write(profile_magic, sizeof(profile_magic));
+		file.write(reinterpret_cast<const char *>(&page_size), sizeof(page_size));
+		file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+		file.write(reinterpret_cast<const char *>(indices.data()), count * sizeof(indices[0]));
+		file.close();
+		if (!file)
+			throw std::system_error(errno, std::system_category());
+	}
+	std::remove(path.c_str());
+	if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+		throw std::system_error(errno, std::system_category());
+}
+
+void PageProfileStore::record(const std::shared_ptr<Module> & module)
+{
+	const auto source = dynamic_cast<const PageProfileSource *>(module.get());
+	if (!source) return;
+	auto key = source->profile_key();
+	if (key.empty() || std::ifstream { state_->path(key) }) return;
+
+	std::lock_guard<std::mutex> lock { state_->mutex };
+	for (const auto & profile : state_->pending)
+		if (profile.key == key) return;
+	const auto deadline = std::chrono::steady_clock::now() + state_->window;
+	state_->pending.push_back({ module, std::move(key), deadline });
+	if (!state_->sampler.joinable())
+		state_->sampler = std::thread { [this] { state_->run(*this); } };
+	state_->wake.notify_all();
+}
+
+void PageProfileStore::flush()
+{
+	std::vector<PendingProfile> pending;
+	{
+		std::lock_guard<std::mutex> lock { state_->mutex };
+		pending.swap(state_->pending);
+	}
+	for (const auto & profile : pending)
+		state_->sample(profile, *this);
+}
+
+std::size_t PageProfileStore::pending() const
+{
+	std::lock_guard<std::mutex> lock { state_->mutex };
+	return state_->pending.size();
+}
+
+}
@@ -0,0 +1,25 @@
+#ifndef TLDR_SRC_PAGEPROFILE_HPP_
+#define TLDR_SRC_PAGEPROFILE_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace tldr {
+
+/*
+	Implemented by modules that can name their image for PageProfileStore
+	and list the pages of it this process has touched so far, as page
+	indices from the start of the image. An empty key opts out.
+ */
+class PageProfileSource
+{
+public:
+	virtual ~PageProfileSource();
+	virtual std::string profile_key() const = 0;
+	virtual std::vector<std::size_t> touched_pages() const = 0;
+};
+
+}
+
+#endif
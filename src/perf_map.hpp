@@ -0,0 +1,33 @@
+#ifndef TLDR_SRC_PERFMAP_HPP_
+#define TLDR_SRC_PERFMAP_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tldr {
+
+struct PerfSymbol
+{
+	std::uintptr_t address;
+	std::size_t size;
+	std::string name;
+};
+
+struct PerfImage
+{
+	std::string name;
+	std::uintptr_t base;
+	std::size_t size;
+	unsigned int machine;
+};
+
+void perf_map_load(const PerfImage & image, const std::vector<PerfSymbol> & symbols,
+                   int outputs);
+/* Errors are ignored; this runs while modules are being destroyed. */
+void perf_map_unload(const PerfImage & image, int outputs) noexcept;
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef TLDR_SRC_PHASE_TIMER_HPP_
+#define TLDR_SRC_PHASE_TIMER_HPP_
+
+#include <tldr/load_stats.hpp>
+
+#include "rusage.hpp"
+
+#include <chrono>
+#include <exception>
+#include <utility>
+
+namespace tldr {
+
+class PhaseTimer
+{
+public:
+	PhaseTimer(LoadStats & stats, LoadPhase phase);
+	PhaseTimer(const PhaseTimer &) = delete;
+	~PhaseTimer() noexcept;
+
+private:
+	PhaseStats & phase_;
+	std::chrono::steady_clock::time_point wall_start_;
+	ResourceUsage usage_start_;
+};
+
+inline PhaseTimer::PhaseTimer(LoadStats & stats, LoadPhase phase)
+	: phase_ { stats.phase(phase) }
+	, wall_start_ { std::chrono::steady_clock::now() }
+	, usage_start_ ( thread_resource_usage() ) {}
+
+/* Wall time is always recorded; resource usage only when it can be read. */
+inline PhaseTimer::~PhaseTimer() noexcept
+{
+	phase_.wall_time += std::chrono::steady_clock::now() - wall_start_;
+	try {
+		const auto usage_end = thread_resource_usage();
+		phase_.cpu_time += usage_end.cpu_time - usage_start_.cpu_time;
+		phase_.minor_faults += usage_end.minor_faults - usage_start_.minor_faults;
+		phase_.major_faults += usage_end.major_faults - usage_start_.major_faults;
+	} catch (const std::exception &) {
+	}
+}
+
+template <typename Fn>
+decltype(auto) measure_load_phase(LoadStats * stats, LoadPhase phase, Fn && fn)
+{
+	if (!stats) return std::forward<Fn>(fn)();
+	const PhaseTimer timer { *stats, phase };
+	return std::forward<Fn>(fn)();
+}
+
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef TLDR_SRC_PREFETCH_HPP_
+#define TLDR_SRC_PREFETCH_HPP_
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	#include <xmmintrin.h>
+#endif
+
+namespace tldr {
+
+inline void prefetch(const void * addr)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(addr, 0, 3);
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	_mm_prefetch(static_cast<const char *>(addr), _MM_HINT_T0);
+#else
+	(void) addr;
+#endif
+}
+
+}
+
+#endif
@@ -1,42 +1,184 @@
 #include <config.h>
+#include <tldr/page_profile.hpp>
 #include <tldr/raw_module.hpp>
 
+#include "sha256.hpp"
+#include "stream_reader.hpp"
+
 #if defined(TLDR_HAS_ELF32_SUPPORT) || defined(TLDR_HAS_ELF64_SUPPORT)
 #	include "elf/module.hpp"
+#	include "elf/stream.hpp"
 #endif
 
+#include <cstdio>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
 #if defined(TLDR_HAS_PE32_SUPPORT) || defined(TLDR_HAS_PE64_SUPPORT)
 #	include "pe/module.hpp"
 #endif
 
 namespace tldr {
 
-std::shared_ptr<Module> load_from_memory(const void * mem, std::size_t size,
-                                         const ModuleResolver & resolver)
+namespace {
+
+std::shared_ptr<Module> record_page_profile(std::shared_ptr<Module> module,
+                                            const LoadOptions & options)
+{
+	if (module && options.page_profiles)
+		options.page_profiles->record(module);
+	return module;
+}
+
+typedef std::pair<std::string, const ModuleResolver *> DedupKey;
+
+std::mutex dedup_mutex;
+std::map<DedupKey, std::weak_ptr<Module>> dedup_cache;
+
+std::string image_dedup_key(const void * mem, std::size_t size)
+{
+	std::string build_id;
+#ifdef TLDR_HAS_ELF32_SUPPORT
+	if (ElfImageR<Elf32>::is_valid(mem, size))
+		build_id = elf_file_build_id(ElfImageR<Elf32> { mem, size });
+#endif
+#ifdef TLDR_HAS_ELF64_SUPPORT
+	if (ElfImageR<Elf64>::is_valid(mem, size))
+		build_id = elf_file_build_id(ElfImageR<Elf64> { mem, size });
+#endif
+	if (!build_id.empty())
+		return "build-id:" + build_id;
+	std::string key = "sha256:";
+	for (const auto byte : sha256(mem, size)) {
+		char hex[3];
+		std::snprintf(hex, sizeof(hex), "%02x", static_cast<unsigned int>(byte));
+		key += hex;
+	}
+	return key + ":" + std::to_string(size);
+}
+
+std::shared_ptr<Module> load_image_from_memory(const void * mem, std::size_t size,
+                                               const ModuleResolver & resolver,
+                                               const LoadOptions & options)
 {
 
 #ifdef TLDR_HAS_ELF32_SUPPORT
 	if (Elf32Module::is_valid(mem, size))
-		return std::make_shared<Elf32Module>(mem, size, resolver);
+		return std::make_shared<Elf32Module>(mem, size, resolver, options);
 #endif
 
 #ifdef TLDR_HAS_ELF64_SUPPORT
 	if (Elf64Module::is_valid(mem, size))
-		return std::make_shared<Elf64Module>(mem, size, resolver);
+		return std::make_shared<Elf64Module>(mem, size, resolver, options);
 #endif
 
 #ifdef TLDR_HAS_PE32_SUPPORT
 	if (Pe32Module::is_valid(mem, size))
-		return std::make_shared<Pe32Module>(mem, size, resolver);
+		return std::make_shared<Pe32Module>(mem, size, resolver, options);
 #endif
 
 #ifdef TLDR_HAS_PE64_SUPPORT
 	if (Pe64Module::is_valid(mem, size))
-		return std::make_shared<Pe64Module>(mem, size, resolver);
+		return std::make_shared<Pe64Module>(mem, size, resolver, options);
 #endif
 
 	return nullptr;
 
 }
 
+std::shared_ptr<Module> load_image_from_stream(const ReadCallback & read,
+                                               const ModuleResolver & resolver,
+                                               const LoadOptions & options)
+{
+	StreamReader reader { read };
+	std::vector<char> headers(64);
+	headers.resize(reader.read_some(headers.data(), headers.size()));
+
+#ifdef TLDR_HAS_ELF32_SUPPORT
+	if (elf_read_stream_headers<Elf32>(reader, headers)) {
+		auto image = measure_load_phase(options.stats, LoadPhase::MapProgramHeaders, [&] {
+			return elf_stream_image<Elf32>(reader, headers, options.stats,
+			                               options.preferred_base);
+		});
+		return std::make_shared<Elf32Module>(image, resolver, options);
+	}
+#endif
+
+#ifdef TLDR_HAS_ELF64_SUPPORT
+	if (elf_read_stream_headers<Elf64>(reader, headers)) {
+		auto image = measure_load_phase(options.stats, LoadPhase::MapProgramHeaders, [&] {
+			return elf_stream_image<Elf64>(reader, headers, options.stats,
+			                               options.preferred_base);
+		});
+		return std::make_shared<Elf64Module>(image, resolver, options);
+	}
+#endif
+
+	return nullptr;
+}
+
+}
+
+std::shared_ptr<Module> load_from_memory(const void * mem, std::size_t size,
+                                         const ModuleResolver & resolver)
+{
+	return load_from_memory(mem, size, resolver, {});
+}
+
+std::shared_ptr<Module> load_from_memory(const void * mem, std::size_t size,
+                                         const ModuleResolver & resolver,
+                                         const LoadOptions & options)
+{
+	if (!options.dedup)
+		return record_page_profile(load_image_from_memory(mem, size, resolver, options), options);
+
+	const DedupKey key { image_dedup_key(mem, size), &resolver };
+	{
+		std::lock_guard<std::mutex> lock { dedup_mutex };
+		const auto iter = dedup_cache.find(key);
+		if (iter != dedup_cache.end()) {
+			if (auto module = iter->second.lock())
+				return module;
+		}
+	}
+
+	/* Loaded unlocked; if another thread loaded the same image meanwhile, its module wins. */
+	auto module = record_page_profile(load_image_from_memory(mem, size, resolver, options), options);
+	if (!module) return module;
+	std::lock_guard<std::mutex> lock { dedup_mutex };
+	for (auto iter = dedup_cache.begin(); iter != dedup_cache.end();) {
+		if (iter->second.expired())
+			iter = dedup_cache.erase(iter);
+		else
+			++iter;
+	}
+	auto & entry = dedup_cache[key];
+	if (auto existing = entry.lock())
+		return existing;
+	entry = module;
+	return module;
+}
+
+std::shared_ptr<Module> load_from_stream(const ReadCallback & read,
+                                         const ModuleResolver & resolver,
+                                         const LoadOptions & options)
+{
+	return record_page_profile(load_image_from_stream(read, resolver, options), options);
+}
+
+std::shared_ptr<Module> load_from_stream(std::istream & stream,
+                                         const ModuleResolver & resolver,
+                                         const LoadOptions & options)
+{
+	const auto read = [&] (void * buffer, std::size_t size) -> std::size_t {
+		stream.read(static_cast<char *>(buffer), size);
+		return stream.gcount();
+	};
+	return load_from_stream(read, resolver, options);
+}
+
 }
@@ -0,0 +1,87 @@
+#include <config.h>
+#include <tldr/relocation_plan_cache.hpp>
+
+#include <deque>
+#include <map>
+#include <mutex>
+
+namespace tldr {
+
+struct RelocationPlanCache::State
+{
+	std::string directory;
+	std::size_t capacity;
+
+	mutable std::mutex mutex;
+	std::map<std::string, std::shared_ptr<const void>> plans;
+	std::deque<std::string> order;
+	mutable std::size_t hits = 0;
+	mutable std::size_t misses = 0;
+};
+
+RelocationPlanCache::RelocationPlanCache(std::string directory, std::size_t capacity)
+	: state_ { new State }
+{
+	state_->directory = std::move(directory);
+	state_->capacity = capacity;
+}
+
+RelocationPlanCache::~RelocationPlanCache() = default;
+
+const std::string & RelocationPlanCache::directory() const
+{
+	return state_->directory;
+}
+
+std::shared_ptr<const void> RelocationPlanCache::find(const std::string & key) const
+{
+	std::lock_guard<std::mutex> lock { state_->mutex };
+	const auto iter = state_->plans.find(key);
+	if (iter == state_->plans.end()) {
+		++state_->misses;
+		return nullptr;
+	}
+	++state_->hits;
+	return iter->second;
+}
+
+/* Evicts the oldest plans first; a plan still being replayed stays alive through its owner. */
+void RelocationPlanCache::insert(const std::string & key, std::shared_ptr<const void> plan)
+{
+	std::lock_guard<std::mutex> lock { state_->mutex };
+	if (state_->capacity == 0) return;
+	auto & entry = state_->plans[key];
+	if (!entry) state_->order.push_back(key);
+	entry = std::move(plan);
+	while (state_->plans.size() > state_->capacity) {
+		state_->plans.erase(state_->order.front());
+		state_->order.pop_front();
+	}
+}
+
+void RelocationPlanCache::clear()
+{
+	std::lock_guard<std::mutex> lock { state_->mutex };
+	state_->plans.clear();
+	state_->order.clear();
+}
+
+std::size_t RelocationPlanCache::size() const
+{
+	std::lock_guard<std::mutex> lock { state_->mutex };
+	return state_->plans.size();
+}
+
+std::size_t RelocationPlanCache::hits() const
+{
+	std::lock_guard<std::mutex> lock { state_->mutex };
+	return state_->hits;
+}
+
+std::size_t RelocationPlanCache::misses() const
+{
+	std::lock_guard<std::mutex> lock { state_->mutex };
+	return state_->misses;
+}
+
+}
@@ -0,0 +1,107 @@
+#include <config.h>
+#include <tldr/relocation_report.hpp>
+
+#include <cstdio>
+#include <sstream>
+
+namespace tldr {
+
+namespace {
+
+void write_string(std::ostream & out, const std::string & value)
+{
+	out << '"';
+	for (const auto c : value) {
+		switch (c) {
+		case '"': out << "\\\""; break;
+		case '\\': out << "\\\\"; break;
+		case '\n': out << "\\n"; break;
+		case '\t': out << "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				char escaped[7];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x",
+				              static_cast<unsigned char>(c));
+				out << escaped;
+			} else {
+				out << c;
+			}
+		}
+	}
+	out << '"';
+}
+
+void write_pages(std::ostream & out, const std::vector<std::uintptr_t> & pages)
+{
+	out << '[';
+	for (std::size_t i = 0; i < pages.size(); ++i)
+		out << (i ? "," : "") << pages[i];
+	out << ']';
+}
+
+void write_types(std::ostream & out, const std::vector<RelocationTypeUsage> & types)
+{
+	out << '[';
+	for (std::size_t i = 0; i < types.size(); ++i) {
+		const auto & type = types[i];
+		out << (i ? "," : "") << "{\"type\":" << type.type << ",\"name\":";
+		write_string(out, type.name);
+		out << ",\"relocations\":" << type.relocations
+		    << ",\"dirty_pages\":" << type.dirty_pages
+		    << ",\"dirty_bytes\":" << type.dirty_bytes << '}';
+	}
+	out << ']';
+}
+
+void write_report(std::ostream & out, const RelocationReport & report)
+{
+	out << "{\"module\":";
+	write_string(out, report.module);
+	out << ",\"page_size\":" << report.page_size
+	    << ",\"relocations\":" << report.relocations
+	    << ",\"relocations_skipped\":" << report.relocations_skipped
+	    << ",\"dirty_bytes\":" << report.dirty_bytes
+	    << ",\"pages\":";
+	write_pages(out, report.pages);
+	out << ",\"types\":";
+	write_types(out, report.types);
+	out << ",\"sections\":[";
+	for (std::size_t i = 0; i < report.sections.size(); ++i) {
+		const auto & section = report.sections[i];
+		out << (i ? "," : "") << "{\"name\":";
+		write_string(out, section.name);
+		out << ",\"offset\":" << section.offset
+		    << ",\"size\":" << section.size
+		    << ",\"relocations\":" << section.relocations
+		    << ",\"dirty_bytes\":" << section.dirty_bytes
+		    << ",\"pages\":";
+		write_pages(out, section.pages);
+		out << ",\"types\":";
+		write_types(out, section.types);
+		out << '}';
+	}
+	out << "]}";
+}
+
+}
+
+std::string to_json(const RelocationReport & report)
+{
+	std::ostringstream out;
+	write_report(out, report);
+	return out.str();
+}
+
+std::string to_json(const std::vector<RelocationReport> & reports)
+{
+	std::ostringstream out;
+	out << '[';
+	for (std::size_t i = 0; i < reports.size(); ++i) {
+		if (i) out << ',';
+		write_report(out, reports[i]);
+	}
+	out << ']';
+	return out.str();
+}
+
+}
@@ -0,0 +1,19 @@
+#ifndef TLDR_SRC_RUSAGE_HPP_
+#define TLDR_SRC_RUSAGE_HPP_
+
+#include <chrono>
+
+namespace tldr {
+
+struct ResourceUsage
+{
+	std::chrono::nanoseconds cpu_time;
+	long minor_faults;
+	long major_faults;
+};
+
+ResourceUsage thread_resource_usage();
+
+}
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef TLDR_SRC_SHA256_HPP_
+#define TLDR_SRC_SHA256_HPP_
+
+#include <array>
+#include <cstddef>
+
+namespace tldr {
+
+typedef std::array<unsigned char, 32> Sha256Digest;
+
+/* FIPS 180-4 SHA-256 of size bytes at mem. */
+Sha256Digest sha256(const void * mem, std::size_t size);
+
+}
+
+#endif
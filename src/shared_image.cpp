@@ -0,0 +1,125 @@
+#include <config.h>
+#include "shared_image.hpp"
+
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+namespace tldr {
+
+namespace {
+
+std::mutex registry_mutex;
+std::unordered_map<std::uint64_t, std::weak_ptr<SharedImage>> registry;
+
+}
+
+SharedImage::SharedImage(std::uint64_t key, std::size_t size)
+	: key_ { key }, size_ { size }, object_ { vmem_object_create(size) } {}
+
+SharedImage::~SharedImage()
+{
+	vmem_object_close(object_);
+}
+
+std::uint64_t SharedImage::key() const
+{
+	return key_;
+}
+
+std::size_t SharedImage::size() const
+{
+	return size_;
+}
+
+void SharedImage::fill(const std::function<void (void * mem)> & fill)
+{
+	const auto mem = vmem_object_map(object_, size_, false);
+	try {
+		fill(mem);
+	} catch (...) {
+		vmem_object_unmap(mem, size_);
+		throw;
+	}
+	vmem_object_unmap(mem, size_);
+}
+
+void * SharedImage::map(std::uintptr_t pref_base) const
+{
+	return vmem_object_map(object_, size_, true, pref_base);
+}
+
+void SharedImage::unmap(void * mem, std::size_t size)
+{
+	vmem_object_unmap(mem, size);
+}
+
+/*
+	FNV-1a over 64-bit words with the size folded in. The key only picks
+	a candidate; callers compare the mapped contents before trusting it.
+ */
+std::uint64_t shared_image_key(const void * mem, std::size_t size)
+{
+	const auto bytes = static_cast<const unsigned char *>(mem);
+	std::uint64_t hash = 0xcbf29ce484222325ull ^ size;
+	std::size_t i = 0;
+	for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t)) {
+		std::uint64_t word;
+		std::memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ word) * 0x100000001b3ull;
+	}
+	for (; i < size; ++i)
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	return hash;
+}
+
+namespace {
+
+std::shared_ptr<SharedImage> shared_image_find(std::uint64_t key, std::size_t size)
+{
+	for (auto iter = registry.begin(); iter != registry.end();) {
+		if (iter->second.expired())
+			iter = registry.erase(iter);
+		else
+			++iter;
+	}
+	const auto iter = registry.find(key);
+	if (iter == registry.end()) return nullptr;
+	auto image = iter->second.lock();
+	return image && image->size() == size ? image : nullptr;
+}
+
+}
+
+/*
+	The copy is laid out without holding the registry lock, so loads of
+	other images are not held up behind it. Two first loads of the same
+	image may both fill a copy; the one published first wins and the
+	other is dropped.
+ */
+std::shared_ptr<SharedImage> shared_image_acquire(std::uint64_t key, std::size_t size,
+                                                  const std::function<void (void * mem)> & fill,
+                                                  bool & created)
+{
+	{
+		std::lock_guard<std::mutex> lock { registry_mutex };
+		if (auto image = shared_image_find(key, size)) {
+			created = false;
+			return image;
+		}
+	}
+
+	auto image = std::make_shared<SharedImage>(key, size);
+	image->fill(fill);
+
+	std::lock_guard<std::mutex> lock { registry_mutex };
+	if (auto published = shared_image_find(key, size)) {
+		created = false;
+		return published;
+	}
+	registry[key] = image;
+	created = true;
+	return image;
+}
+
+}
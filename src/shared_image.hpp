@@ -0,0 +1,55 @@
+#ifndef TLDR_SRC_SHAREDIMAGE_HPP_
+#define TLDR_SRC_SHAREDIMAGE_HPP_
+
+#include "vmemory.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace tldr {
+
+/*
+	A pristine, unrelocated copy of an image held in a shareable memory
+	object. Every instance maps it copy-on-write, so pages that relocation
+	never touches, text in particular, stay backed by the one copy while
+	written pages become private to their instance.
+ */
+class SharedImage
+{
+public:
+	SharedImage(std::uint64_t key, std::size_t size);
+	~SharedImage();
+
+	SharedImage(const SharedImage &) = delete;
+	SharedImage & operator=(const SharedImage &) = delete;
+
+	std::uint64_t key() const;
+	std::size_t size() const;
+
+	void fill(const std::function<void (void * mem)> & fill);
+	void * map(std::uintptr_t pref_base = 0) const;
+	static void unmap(void * mem, std::size_t size);
+
+private:
+	std::uint64_t key_;
+	std::size_t size_;
+	vmem_object_t object_;
+};
+
+std::uint64_t shared_image_key(const void * mem, std::size_t size);
+
+/*
+	Returns the shared image registered under key, or creates one of the
+	given size, lets fill lay the image out in it and registers it. created
+	reports which of the two happened. Images are dropped from the registry
+	once the last module mapping them goes away.
+ */
+std::shared_ptr<SharedImage> shared_image_acquire(std::uint64_t key, std::size_t size,
+                                                  const std::function<void (void * mem)> & fill,
+                                                  bool & created);
+
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef TLDR_SRC_STREAM_READER_HPP_
+#define TLDR_SRC_STREAM_READER_HPP_
+
+#include <tldr/raw_module.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tldr {
+
+const std::size_t stream_skip_buffer_size = 64 * 1024;
+/* The program header table must end within this many bytes of the stream. */
+const std::size_t stream_max_headers_size = 4 * 1024 * 1024;
+
+class StreamReader
+{
+public:
+	explicit StreamReader(const ReadCallback & read);
+
+	std::uintptr_t position() const;
+
+	std::size_t read_some(void * buffer, std::size_t size);
+	void read_exact(void * buffer, std::size_t size);
+	void skip_to(std::uintptr_t offset);
+
+private:
+	const ReadCallback & read_;
+	std::uintptr_t position_;
+};
+
+inline StreamReader::StreamReader(const ReadCallback & read)
+	: read_ { read }, position_ { 0 } {}
+
+inline std::uintptr_t StreamReader::position() const
+{
+	return position_;
+}
+
+inline std::size_t StreamReader::read_some(void * buffer, std::size_t size)
+{
+	std::size_t total = 0;
+	const auto data = static_cast<char *>(buffer);
+	while (total < size) {
+		const auto count = read_(data + total, size - total);
+		if (count == 0) break;
+		total += count;
+	}
+	position_ += total;
+	return total;
+}
+
+inline void StreamReader::read_exact(void * buffer, std::size_t size)
+{
+	if (read_some(buffer, size) != size)
+		throw LoadError("invalid elf image (unexpected end of stream)");
+}
+
+inline void StreamReader::skip_to(std::uintptr_t offset)
+{
+	if (offset < position_)
+		throw LoadError("invalid elf image (stream offset out of order)");
+	std::vector<char> scratch;
+	while (position_ < offset) {
+		const auto count = std::min<std::uintptr_t>(offset - position_, stream_skip_buffer_size);
+		scratch.resize(count);
+		read_exact(scratch.data(), count);
+	}
+}
+
+}
+
+#endif
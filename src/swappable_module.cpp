@@ -0,0 +1,239 @@
+#include <config.h>
+#include <tldr/swappable_module.hpp>
+
+#include <tldr/memory_usage.hpp>
+#include <tldr/raw_module.hpp>
+#include <tldr/relocation_report.hpp>
+
+#include "vmemory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace tldr {
+
+namespace {
+
+const std::size_t trampoline_size = 8;
+
+std::size_t trampoline_block_capacity()
+{
+	return vmem_page_size() / trampoline_size;
+}
+
+void write_trampoline(unsigned char * stub, const std::atomic<std::uintptr_t> * target)
+{
+#if defined(__x86_64) || defined(_M_AMD64)
+	/* jmp qword ptr [rip + disp32] */
+	const auto next = reinterpret_cast<std::intptr_t>(stub + 6);
+	const auto disp = static_cast<std::int32_t>(reinterpret_cast<std::intptr_t>(target) - next);
+	stub[0] = 0xff;
+	stub[1] = 0x25;
+	std::memcpy(stub + 2, &disp, sizeof(disp));
+#elif defined(__i386__) || defined(_M_IX86)
+	/* jmp dword ptr [abs32] */
+	const auto addr = static_cast<std::uint32_t>(reinterpret_cast<std::uintptr_t>(target));
+	stub[0] = 0xff;
+	stub[1] = 0x25;
+	std::memcpy(stub + 2, &addr, sizeof(addr));
+#else
+#	error "trampolines are not implemented for this architecture"
+#endif
+	stub[6] = stub[7] = 0xcc;
+}
+
+}
+
+struct SwappableModule::TrampolineBlock
+{
+	TrampolineBlock();
+	~TrampolineBlock();
+
+	void * mem;
+	std::size_t size;
+	unsigned char * stubs;
+	std::atomic<std::uintptr_t> * targets;
+};
+
+SwappableModule::TrampolineBlock::TrampolineBlock()
+	: size { 2 * vmem_page_size() }
+{
+	mem = vmem_alloc(size, 0, MemAccessRead | MemAccessWrite);
+	stubs = static_cast<unsigned char *>(mem);
+	targets = reinterpret_cast<std::atomic<std::uintptr_t> *>(stubs + size / 2);
+	for (std::size_t i = 0; i < trampoline_block_capacity(); ++i) {
+		new (&targets[i]) std::atomic<std::uintptr_t> { 0 };
+		write_trampoline(stubs + i * trampoline_size, &targets[i]);
+	}
+	vmem_protect(stubs, size / 2, MemAccessRead | MemAccessExecute);
+}
+
+SwappableModule::TrampolineBlock::~TrampolineBlock()
+{
+	vmem_free(mem, size);
+}
+
+SwappableModule::Reader::Reader(SwappableModule & module)
+	: module_ { module }
+	, observed_epoch_ { std::make_shared<std::atomic<std::uint64_t>>(module.epoch()) }
+{
+	std::lock_guard<std::mutex> lock { module_.mutex_ };
+	module_.readers_.push_back(observed_epoch_);
+}
+
+SwappableModule::Reader::~Reader() = default;
+
+void SwappableModule::Reader::quiescent()
+{
+	observed_epoch_->store(module_.epoch(), std::memory_order_release);
+}
+
+SwappableModule::SwappableModule(std::shared_ptr<Module> module)
+	: current_ { std::move(module) }, epoch_ { 0 }
+{
+	if (!current_)
+		throw std::invalid_argument("module is null");
+}
+
+SwappableModule::~SwappableModule() = default;
+
+std::size_t SwappableModule::allocate_trampoline(const std::string & name) const
+{
+	const auto slot = slots_.size();
+	if (slot == blocks_.size() * trampoline_block_capacity())
+		blocks_.emplace_back(new TrampolineBlock);
+	slots_.emplace(name, slot);
+	return slot;
+}
+
+fn_ptr_t SwappableModule::trampoline_at(std::size_t slot) const
+{
+	const auto & block = *blocks_[slot / trampoline_block_capacity()];
+	const auto stub = block.stubs + slot % trampoline_block_capacity() * trampoline_size;
+	return reinterpret_cast<fn_ptr_t>(stub);
+}
+
+std::atomic<std::uintptr_t> & SwappableModule::target_at(std::size_t slot) const
+{
+	const auto & block = *blocks_[slot / trampoline_block_capacity()];
+	return block.targets[slot % trampoline_block_capacity()];
+}
+
+fn_ptr_t SwappableModule::get_raw_proc(const std::string & name) const
+{
+	std::lock_guard<std::mutex> lock { mutex_ };
+	const auto slot_iter = slots_.find(name);
+	if (slot_iter != slots_.end())
+		return trampoline_at(slot_iter->second);
+
+	const auto proc = current_->get_raw_proc(name);
+	if (!proc) return nullptr;
+	const auto slot = allocate_trampoline(name);
+	target_at(slot).store(reinterpret_cast<std::uintptr_t>(proc), std::memory_order_release);
+	return trampoline_at(slot);
+}
+
+data_ptr_t SwappableModule::get_raw_data(const std::string & name) const
+{
+	return current()->get_raw_data(name);
+}
+
+void SwappableModule::install(std::shared_ptr<Module> module)
+{
+	if (!module)
+		throw std::invalid_argument("module is null");
+
+	std::lock_guard<std::mutex> lock { mutex_ };
+	std::vector<std::pair<std::size_t, std::uintptr_t>> targets;
+	for (const auto & slot : slots_) {
+		const auto proc = module->get_raw_proc(slot.first);
+		if (!proc)
+			throw LoadError("swapped module lacks symbol " + slot.first);
+		targets.emplace_back(slot.second, reinterpret_cast<std::uintptr_t>(proc));
+	}
+
+	for (const auto & target : targets)
+		target_at(target.first).store(target.second, std::memory_order_release);
+
+	const auto retire_epoch = epoch_.fetch_add(1, std::memory_order_acq_rel) + 1;
+	retired_.push_back({ std::move(current_), retire_epoch });
+	current_ = std::move(module);
+}
+
+/*
+	Counts the installed module, every retired module not yet reclaimed, and
+	the trampoline blocks themselves as reserved memory.
+ */
+MemoryUsage SwappableModule::memory_usage() const
+{
+	std::lock_guard<std::mutex> lock { mutex_ };
+	auto usage = current_->memory_usage();
+	for (const auto & retired : retired_)
+		usage += retired.module->memory_usage();
+	for (const auto & block : blocks_)
+		usage.reserved_bytes += block->size;
+	usage.metadata_bytes += sizeof(*this) + slots_.size() * sizeof(*slots_.begin());
+	return usage;
+}
+
+std::size_t SwappableModule::footprint() const
+{
+	std::lock_guard<std::mutex> lock { mutex_ };
+	auto bytes = current_->footprint();
+	for (const auto & retired : retired_)
+		bytes += retired.module->footprint();
+	for (const auto & block : blocks_)
+		bytes += block->size;
+	return bytes + sizeof(*this) + slots_.size() * sizeof(*slots_.begin());
+}
+
+/* Reports the installed module only; retired ones are on their way out. */
+RelocationReport SwappableModule::relocation_report() const
+{
+	std::lock_guard<std::mutex> lock { mutex_ };
+	return current_->relocation_report();
+}
+
+void SwappableModule::wait_initialized() const
+{
+	current()->wait_initialized();
+}
+
+std::shared_ptr<Module> SwappableModule::current() const
+{
+	std::lock_guard<std::mutex> lock { mutex_ };
+	return current_;
+}
+
+std::uint64_t SwappableModule::epoch() const
+{
+	return epoch_.load(std::memory_order_acquire);
+}
+
+std::size_t SwappableModule::reclaim()
+{
+	std::vector<std::shared_ptr<Module>> released;
+	{
+		std::lock_guard<std::mutex> lock { mutex_ };
+		auto safe_epoch = std::numeric_limits<std::uint64_t>::max();
+		readers_.erase(std::remove_if(readers_.begin(), readers_.end(), [&] (const auto & reader) {
+			const auto observed = reader.lock();
+			if (!observed) return true;
+			safe_epoch = std::min(safe_epoch, observed->load(std::memory_order_acquire));
+			return false;
+		}), readers_.end());
+
+		const auto keep = std::stable_partition(retired_.begin(), retired_.end(),
+			[&] (const RetiredModule & retired) { return retired.epoch > safe_epoch; });
+		for (auto iter = keep; iter != retired_.end(); ++iter)
+			released.push_back(std::move(iter->module));
+		retired_.erase(keep, retired_.end());
+	}
+	return released.size();
+}
+
+}
@@ -0,0 +1,11 @@
+#ifndef TLDR_SRC_UNWIND_HPP_
+#define TLDR_SRC_UNWIND_HPP_
+
+namespace tldr {
+
+void * unwind_register_frames(const void * eh_frame_hdr);
+void unwind_deregister_frames(void * frames);
+
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 namespace tldr {
 
@@ -13,9 +14,31 @@ enum {
 	MemAccessExecute = 1 << 2,
 };
 
+std::size_t vmem_page_size();
+
+/*
+	pref_base is honoured only if the whole range there is free; otherwise
+	the memory goes wherever the system puts it.
+ */
 void * vmem_alloc(std::size_t size, std::uintptr_t pref_base = 0, int access = 3);
 void vmem_protect(void * mem, std::size_t size, int new_access);
 void vmem_free(void * mem, std::size_t size);
+std::size_t vmem_resident_size(const void * mem, std::size_t size);
+std::vector<bool> vmem_mapped_pages(const void * mem, std::size_t size);
+void vmem_discard(void * mem, std::size_t size);
+void vmem_populate(const void * mem, std::size_t size);
+
+/*
+	Anonymous memory objects that can be mapped more than once. A copy-on-write
+	view shares every page it never writes with the other views of the object.
+ */
+typedef std::intptr_t vmem_object_t;
+
+vmem_object_t vmem_object_create(std::size_t size);
+void vmem_object_close(vmem_object_t object);
+void * vmem_object_map(vmem_object_t object, std::size_t size, bool copy_on_write,
+                       std::uintptr_t pref_base = 0);
+void vmem_object_unmap(void * mem, std::size_t size);
 
 }
 
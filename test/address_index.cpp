@@ -0,0 +1,91 @@
+#include <config.h>
+#include <gtest/gtest.h>
+#include <tldr/address_index.hpp>
+#include <tldr/raw_module.hpp>
+
+#include "module_data.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+class AddressIndexTests : public ModuleDataTests {};
+
+TEST_F(AddressIndexTests, FindModuleGivesLoadedModule) {
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size());
+	const auto proc = module->get_raw_data("foo_test_proc");
+	tldr::ModuleInfo info;
+	ASSERT_TRUE(tldr::find_module(proc, info));
+	ASSERT_EQ(info.module, module.get());
+	ASSERT_STREQ(info.name, "libfoo.so");
+	ASSERT_LE(info.base, proc);
+}
+
+TEST_F(AddressIndexTests, FindModuleGivesFalseForUnknownAddress) {
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size());
+	int local = 0;
+	tldr::ModuleInfo info;
+	ASSERT_FALSE(tldr::find_module(&local, info));
+}
+
+TEST_F(AddressIndexTests, FindSymbolGivesEnclosingSymbol) {
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size());
+	const auto proc = static_cast<const char *>(module->get_raw_data("foo_test_proc"));
+	const auto data = module->get_raw_data("foo_test_data");
+	tldr::SymbolInfo info;
+	ASSERT_TRUE(tldr::find_symbol(proc + 1, info));
+	ASSERT_STREQ(info.name, "foo_test_proc");
+	ASSERT_EQ(info.address, proc);
+	ASSERT_EQ(info.module.module, module.get());
+	ASSERT_TRUE(tldr::find_symbol(data, info));
+	ASSERT_STREQ(info.name, "foo_test_data");
+}
+
+TEST_F(AddressIndexTests, FindSymbolUsesRetainedSymtab) {
+	tldr::LoadOptions options;
+	options.retain_symtab = true;
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size(),
+	                                           tldr::system_loader, options);
+	const auto proc = static_cast<const char *>(module->get_raw_data("foo_test_proc"));
+	tldr::SymbolInfo info;
+	ASSERT_TRUE(tldr::find_symbol(proc, info));
+	ASSERT_STREQ(info.name, "foo_test_proc");
+}
+
+TEST_F(AddressIndexTests, UnloadedModuleIsRemoved) {
+	auto module = tldr::load_from_memory(module_data_.data(),
+	                                     module_data_.size());
+	const auto proc = module->get_raw_data("foo_test_proc");
+	module.reset();
+	tldr::ModuleInfo info;
+	ASSERT_FALSE(tldr::find_module(proc, info));
+}
+
+TEST_F(AddressIndexTests, LookupsRunWhileModulesLoadAndUnload) {
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size());
+	const auto proc = module->get_raw_data("foo_test_proc");
+	std::atomic<bool> done { false };
+	std::atomic<unsigned int> misses { 0 };
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 4; ++i) {
+		readers.emplace_back([&] {
+			while (!done) {
+				tldr::SymbolInfo info;
+				if (!tldr::find_symbol(proc, info) || info.module.module != module.get())
+					++misses;
+			}
+		});
+	}
+	for (int i = 0; i < 50; ++i)
+		tldr::load_from_memory(module_data_.data(), module_data_.size());
+	done = true;
+	for (auto & reader : readers)
+		reader.join();
+	EXPECT_EQ(misses, 0u);
+}
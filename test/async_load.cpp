@@ -0,0 +1,132 @@
+#include <config.h>
+#include <gtest/gtest.h>
+#include <tldr/async_load.hpp>
+#include <tldr/loader.hpp>
+
+#include "module_data.hpp"
+
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class AsyncLoadTests : public ModuleDataTests
+{
+public:
+	tldr::LoadHandle block_worker(tldr::LoadExecutor & executor);
+
+public:
+	std::promise<void> gate_;
+	std::promise<void> blocked_;
+};
+
+tldr::LoadHandle AsyncLoadTests::block_worker(tldr::LoadExecutor & executor)
+{
+	auto gate = gate_.get_future().share();
+	auto handle = executor.submit([this, gate] {
+		blocked_.set_value();
+		gate.wait();
+		return std::shared_ptr<tldr::Module>();
+	});
+	blocked_.get_future().wait();
+	return handle;
+}
+
+TEST_F(AsyncLoadTests, LoadFromMemoryAsyncRunsOnExecutor) {
+	tldr::LoadExecutor executor;
+	std::promise<std::thread::id> completed_on;
+	tldr::AsyncLoadOptions options;
+	options.on_complete = [&] (std::shared_ptr<tldr::Module> module, std::exception_ptr error) {
+		completed_on.set_value(std::this_thread::get_id());
+	};
+	const auto handle = tldr::load_from_memory_async(executor, module_data_.data(),
+	                                                 module_data_.size(),
+	                                                 tldr::system_loader, {}, options);
+	const auto module = handle.get();
+	ASSERT_TRUE(module != nullptr);
+	EXPECT_EQ(*module->get_data<int>("foo_test_init_count"), 1);
+	EXPECT_NE(completed_on.get_future().get(), std::this_thread::get_id());
+}
+
+TEST_F(AsyncLoadTests, HigherPriorityRunsFirst) {
+	tldr::LoadExecutor executor;
+	const auto blocker = block_worker(executor);
+	std::mutex mutex;
+	std::vector<tldr::LoadPriority> order;
+	std::vector<tldr::LoadHandle> handles;
+	for (const auto priority : { tldr::LoadPriority::Low, tldr::LoadPriority::High,
+	                             tldr::LoadPriority::Normal }) {
+		tldr::AsyncLoadOptions options;
+		options.priority = priority;
+		handles.push_back(executor.submit([&, priority] {
+			std::lock_guard<std::mutex> lock { mutex };
+			order.push_back(priority);
+			return std::shared_ptr<tldr::Module>();
+		}, options));
+	}
+	gate_.set_value();
+	for (const auto & handle : handles)
+		handle.future().wait();
+	const std::vector<tldr::LoadPriority> expected {
+		tldr::LoadPriority::High, tldr::LoadPriority::Normal, tldr::LoadPriority::Low
+	};
+	EXPECT_EQ(order, expected);
+}
+
+TEST_F(AsyncLoadTests, CancelStopsQueuedLoad) {
+	tldr::LoadExecutor executor;
+	const auto blocker = block_worker(executor);
+	bool ran = false;
+	auto handle = executor.submit([&] {
+		ran = true;
+		return std::shared_ptr<tldr::Module>();
+	});
+	EXPECT_TRUE(handle.cancel());
+	EXPECT_THROW(handle.get(), tldr::LoadCancelledError);
+	gate_.set_value();
+	blocker.future().wait();
+	EXPECT_FALSE(handle.cancel());
+	EXPECT_FALSE(ran);
+}
+
+TEST_F(AsyncLoadTests, SubmitFailsWhenQueueIsFull) {
+	tldr::LoadExecutor executor { 1, 1 };
+	const auto blocker = block_worker(executor);
+	const auto queued = executor.submit([] { return std::shared_ptr<tldr::Module>(); });
+	const auto rejected = executor.submit([] { return std::shared_ptr<tldr::Module>(); });
+	EXPECT_THROW(rejected.get(), tldr::LoadQueueFullError);
+	gate_.set_value();
+	EXPECT_NO_THROW(queued.get());
+}
+
+TEST_F(AsyncLoadTests, CancelledLoadFreesQueueSlot) {
+	tldr::LoadExecutor executor { 1, 1 };
+	const auto blocker = block_worker(executor);
+	auto cancelled = executor.submit([] { return std::shared_ptr<tldr::Module>(); });
+	EXPECT_TRUE(cancelled.cancel());
+	EXPECT_EQ(executor.queued(), 0u);
+	const auto queued = executor.submit([] { return std::shared_ptr<tldr::Module>(); });
+	EXPECT_EQ(executor.queued(), 1u);
+	gate_.set_value();
+	EXPECT_NO_THROW(queued.get());
+	EXPECT_THROW(cancelled.get(), tldr::LoadCancelledError);
+}
+
+TEST_F(AsyncLoadTests, ThrowingCallbackLeavesWorkerRunning) {
+	tldr::LoadExecutor executor;
+	tldr::AsyncLoadOptions options;
+	options.on_complete = [] (std::shared_ptr<tldr::Module>, std::exception_ptr) {
+		throw std::runtime_error("callback failed");
+	};
+	const auto first = executor.submit([] { return std::shared_ptr<tldr::Module>(); }, options);
+	EXPECT_NO_THROW(first.get());
+	const auto second = executor.submit([] { return std::shared_ptr<tldr::Module>(); });
+	EXPECT_NO_THROW(second.get());
+}
+
+TEST_F(AsyncLoadTests, LoaderGetModuleAsyncUsesResolver) {
+	tldr::LoadExecutor executor;
+	tldr::Loader loader;
+	loader.set_module_resolver(&tldr::system_loader);
+	EXPECT_TRUE(loader.get_module_async(executor, "libc.so.6").get() != nullptr);
+}
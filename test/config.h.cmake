@@ -1 +1,3 @@
 #define TLDR_TEST_MODULE_PATH "@CMAKE_CURRENT_BINARY_DIR@/@TLDR_TEST_MODULE_PATH@"
+#define TLDR_TEST_PRELINKED_MODULE_PATH "@CMAKE_CURRENT_BINARY_DIR@/@TLDR_TEST_PRELINKED_MODULE_PATH@"
+#define TLDR_TEST_PRELINKED_BASE @TLDR_TEST_PRELINKED_BASE@
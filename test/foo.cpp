@@ -2,16 +2,61 @@
 #include "foo.hpp"
 
 #include <chrono>
+#include <cstdlib>
+#include <stdexcept>
 #include <thread>
 
 const int foo_test_data = 0x11223344;
+int foo_test_init_count = 0;
+
+namespace {
+
+/* Fails while FOO_TEST_INIT_THROW is set, to exercise failed initializers. */
+struct CountInit
+{
+	CountInit()
+	{
+		if (std::getenv("FOO_TEST_INIT_THROW"))
+			throw std::runtime_error("foo init failed");
+		++foo_test_init_count;
+	}
+} count_init;
+
+int indirect_target()
+{
+	return 0x55667788;
+}
+
+/* Initialized through a relative relocation. */
+int (* volatile indirect_table[])() = { indirect_target };
+
+#define FOO_REPEAT4(x) x, x, x, x
+#define FOO_REPEAT16(x) FOO_REPEAT4(x), FOO_REPEAT4(x), FOO_REPEAT4(x), FOO_REPEAT4(x)
+#define FOO_REPEAT64(x) FOO_REPEAT16(x), FOO_REPEAT16(x), FOO_REPEAT16(x), FOO_REPEAT16(x)
+#define FOO_REPEAT256(x) FOO_REPEAT64(x), FOO_REPEAT64(x), FOO_REPEAT64(x), FOO_REPEAT64(x)
+
+/* Fills whole pages of relocation table, which trim_after_load can discard. */
+__attribute__((used))
+int (* volatile relocated_table[])() = { FOO_REPEAT256(indirect_target), FOO_REPEAT256(indirect_target) };
+
+}
 
 int foo_test_proc()
 {
 	return 0x11223344;
 }
 
+int foo_test_indirect()
+{
+	return indirect_table[0]();
+}
+
 void foo_test_imports()
 {
 	std::this_thread::sleep_for(std::chrono::milliseconds(1));
 }
+
+void foo_test_throw()
+{
+	throw std::runtime_error("foo_test_throw");
+}
@@ -8,8 +8,11 @@ extern "C" {
 #endif
 
 TLDR_EXPORT extern const int foo_test_data;
+TLDR_EXPORT extern int foo_test_init_count;
 TLDR_EXPORT extern int foo_test_proc(void);
+TLDR_EXPORT extern int foo_test_indirect(void);
 TLDR_EXPORT extern void foo_test_imports(void);
+TLDR_EXPORT extern void foo_test_throw(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,70 @@
+#include <config.h>
+#include <gtest/gtest.h>
+#include <tldr/import_table.hpp>
+#include <tldr/module.hpp>
+#include <tldr/raw_module.hpp>
+
+#include "module_data.hpp"
+
+#include <string>
+#include <vector>
+
+struct FooImports : tldr::ImportTable
+{
+	Proc<int()> test_proc { *this, "foo_test_proc" };
+	Data<const int> test_data { *this, "foo_test_data" };
+	Proc<void()> optional_proc { *this, "foo_optional_proc", tldr::ImportOptional };
+};
+
+struct BrokenImports : tldr::ImportTable
+{
+	Proc<int()> test_proc { *this, "foo_test_proc" };
+	Proc<void()> first_missing { *this, "foo_missing_proc" };
+	Data<int> second_missing { *this, "foo_missing_data" };
+};
+
+class ImportTableTests : public ModuleDataTests {};
+
+TEST(ImportTable, SlotsRegisterInDeclarationOrder) {
+	FooImports imports;
+	ASSERT_EQ(imports.size(), 3u);
+	ASSERT_EQ(imports.names()[0], "foo_test_proc");
+	ASSERT_EQ(imports.names()[1], "foo_test_data");
+	ASSERT_EQ(imports.kind(1), tldr::SymbolKind::Data);
+	ASSERT_FALSE(imports.is_bound());
+	ASSERT_FALSE(imports.test_proc);
+}
+
+TEST_F(ImportTableTests, BindResolvesAllSlots) {
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size());
+	FooImports imports;
+	module->bind(imports);
+	ASSERT_TRUE(imports.is_bound());
+	ASSERT_EQ(imports.test_proc.get(), module->get_proc<int()>("foo_test_proc"));
+	ASSERT_EQ(*imports.test_data, 0x11223344);
+	ASSERT_FALSE(imports.optional_proc);
+}
+
+TEST_F(ImportTableTests, BindReportsAllMissingSymbols) {
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size());
+	BrokenImports imports;
+	try {
+		module->bind(imports);
+		FAIL() << "bind did not throw";
+	} catch (const tldr::MissingSymbolsError & e) {
+		const std::vector<std::string> expected { "foo_missing_proc", "foo_missing_data" };
+		ASSERT_EQ(e.missing(), expected);
+	}
+	ASSERT_FALSE(imports.is_bound());
+	ASSERT_TRUE(imports.test_proc);
+}
+
+TEST_F(ImportTableTests, BindWorksThroughSystemLoader) {
+	const auto module = tldr::system_loader.get_module(TLDR_TEST_MODULE_PATH);
+	FooImports imports;
+	module->bind(imports);
+	ASSERT_EQ(*imports.test_data, 0x11223344);
+	ASSERT_EQ(imports.test_proc.get(), module->get_proc<int()>("foo_test_proc"));
+}
@@ -1,15 +1,70 @@
 #include <gtest/gtest.h>
 #include <tldr/loader.hpp>
+#include <tldr/memory_usage.hpp>
 
 #include "loader.hpp"
 #include "module.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <map>
 #include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/* Holds each resolution until the given number of callers wait on it. */
+class LatchedModuleResolver : public tldr::ModuleResolver
+{
+public:
+	LatchedModuleResolver(const tldr::Loader & loader, std::size_t waiters, bool fail = false)
+		: loader_ ( loader ), waiters_ { waiters }, fail_ { fail }, calls_ { 0 } {}
+
+	virtual std::shared_ptr<tldr::Module> get_module(const std::string & name) const override
+	{
+		++calls_;
+		while (loader_.counters().coalesced < waiters_)
+			std::this_thread::yield();
+		if (fail_) throw std::runtime_error("load failed");
+		return std::make_shared<testing::NiceMock<MockModule>>();
+	}
+
+	int calls() const { return calls_; }
+
+private:
+	const tldr::Loader & loader_;
+	std::size_t waiters_;
+	bool fail_;
+	mutable std::atomic<int> calls_;
+};
 
 struct LoaderTests : testing::Test {
 	tldr::Loader _loader;
 };
 
+class SlowModuleResolver : public tldr::ModuleResolver
+{
+public:
+	explicit SlowModuleResolver(std::chrono::milliseconds delay, bool fail = false)
+		: delay_ { delay }, fail_ { fail }, calls_ { 0 } {}
+
+	virtual std::shared_ptr<tldr::Module> get_module(const std::string & name) const override
+	{
+		++calls_;
+		std::this_thread::sleep_for(delay_);
+		if (fail_) throw std::runtime_error("load failed");
+		return std::make_shared<testing::NiceMock<MockModule>>();
+	}
+
+	int calls() const { return calls_; }
+
+private:
+	std::chrono::milliseconds delay_;
+	bool fail_;
+	mutable std::atomic<int> calls_;
+};
+
 TEST_F(LoaderTests, GetModuleUsesResolverIfModuleNotSet) {
 	const MockModuleResolver mock_resolver;
 	_loader.set_module_resolver(&mock_resolver);
@@ -64,3 +119,157 @@ TEST_F(LoaderTests, RemoveModuleRemovesModuleFromLoader) {
 	_loader.remove_module("foo");
 	ASSERT_TRUE(_loader.get_module("foo") == nullptr);
 }
+
+TEST_F(LoaderTests, MemoryUsageSumsEachLiveModuleOnce) {
+	tldr::MemoryUsage usage;
+	usage.reserved_bytes = 0x1000;
+	usage.metadata_bytes = 0x10;
+	const auto module_a = std::make_shared<MockModule>();
+	const auto module_b = std::make_shared<MockModule>();
+	auto module_c = std::make_shared<MockModule>();
+	EXPECT_CALL(*module_a, memory_usage()).WillOnce(testing::Return(usage));
+	EXPECT_CALL(*module_b, memory_usage()).WillOnce(testing::Return(usage));
+	EXPECT_CALL(*module_c, memory_usage()).Times(0);
+	_loader.set_module("foo", module_a);
+	_loader.set_module("bar", module_a);
+	_loader.set_module("baz", module_b);
+	_loader.set_module("qux", module_c);
+	module_c.reset();
+	const auto total = _loader.memory_usage();
+	EXPECT_EQ(total.reserved_bytes, 0x2000u);
+	EXPECT_EQ(total.metadata_bytes, 0x20u);
+}
+
+TEST_F(LoaderTests, RetentionKeepsResolvedModuleAlive) {
+	const MockModuleResolver mock_resolver;
+	_loader.set_module_resolver(&mock_resolver);
+	tldr::RetentionPolicy policy;
+	policy.max_modules = 2;
+	_loader.set_retention_policy(policy);
+	std::weak_ptr<tldr::Module> weak_module;
+	EXPECT_CALL(mock_resolver, get_module("foo")).WillOnce(testing::Invoke([&] (const std::string &) {
+		const auto module = std::make_shared<testing::NiceMock<MockModule>>();
+		weak_module = module;
+		return module;
+	}));
+	_loader.get_module("foo");
+	ASSERT_FALSE(weak_module.expired());
+	ASSERT_EQ(_loader.get_module("foo"), weak_module.lock());
+	const auto counters = _loader.counters();
+	EXPECT_EQ(counters.hits, 1u);
+	EXPECT_EQ(counters.misses, 1u);
+}
+
+TEST_F(LoaderTests, RetentionEvictsLeastRecentlyUsed) {
+	const MockModuleResolver mock_resolver;
+	_loader.set_module_resolver(&mock_resolver);
+	tldr::RetentionPolicy policy;
+	policy.max_modules = 2;
+	_loader.set_retention_policy(policy);
+	std::map<std::string, std::weak_ptr<tldr::Module>> loaded;
+	ON_CALL(mock_resolver, get_module(testing::_)).WillByDefault(testing::Invoke([&] (const std::string & name) {
+		const auto module = std::make_shared<testing::NiceMock<MockModule>>();
+		loaded[name] = module;
+		return module;
+	}));
+	EXPECT_CALL(mock_resolver, get_module(testing::_)).Times(3);
+	_loader.get_module("a");
+	_loader.get_module("b");
+	_loader.get_module("a");
+	_loader.get_module("c");
+	EXPECT_FALSE(loaded["a"].expired());
+	EXPECT_TRUE(loaded["b"].expired());
+	EXPECT_FALSE(loaded["c"].expired());
+	EXPECT_EQ(_loader.counters().evictions, 1u);
+}
+
+TEST_F(LoaderTests, RetentionRespectsByteBudget) {
+	const MockModuleResolver mock_resolver;
+	_loader.set_module_resolver(&mock_resolver);
+	tldr::RetentionPolicy policy;
+	policy.max_bytes = 0x2800;
+	_loader.set_retention_policy(policy);
+	ON_CALL(mock_resolver, get_module(testing::_)).WillByDefault(testing::Invoke([&] (const std::string &) {
+		const auto module = std::make_shared<testing::NiceMock<MockModule>>();
+		ON_CALL(*module, footprint()).WillByDefault(testing::Return(0x1000));
+		EXPECT_CALL(*module, memory_usage()).Times(0);
+		return module;
+	}));
+	EXPECT_CALL(mock_resolver, get_module(testing::_)).Times(4);
+	_loader.get_module("a");
+	_loader.get_module("b");
+	_loader.get_module("c");
+	EXPECT_EQ(_loader.retained_bytes(), 0x2000u);
+	EXPECT_EQ(_loader.counters().evictions, 1u);
+	_loader.get_module("d");
+	EXPECT_EQ(_loader.retained_bytes(), 0x2000u);
+	EXPECT_EQ(_loader.counters().evictions, 2u);
+}
+
+TEST_F(LoaderTests, ConcurrentGetModuleLoadsOnce) {
+	const LatchedModuleResolver resolver { _loader, 31 };
+	_loader.set_module_resolver(&resolver);
+	std::vector<std::shared_ptr<tldr::Module>> results(32);
+	std::vector<std::thread> threads;
+	for (auto & result : results)
+		threads.emplace_back([&] { result = _loader.get_module("foo"); });
+	for (auto & thread : threads)
+		thread.join();
+	EXPECT_EQ(resolver.calls(), 1);
+	for (const auto & result : results) {
+		ASSERT_TRUE(result != nullptr);
+		EXPECT_EQ(result, results[0]);
+	}
+	EXPECT_EQ(_loader.counters().misses, 1u);
+	EXPECT_EQ(_loader.counters().coalesced, 31u);
+}
+
+TEST_F(LoaderTests, ConcurrentGetModuleSharesError) {
+	const LatchedModuleResolver resolver { _loader, 7, true };
+	_loader.set_module_resolver(&resolver);
+	std::atomic<int> failures { 0 };
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 8; ++i) {
+		threads.emplace_back([&] {
+			try {
+				_loader.get_module("foo");
+			} catch (const std::runtime_error &) {
+				++failures;
+			}
+		});
+	}
+	for (auto & thread : threads)
+		thread.join();
+	EXPECT_EQ(failures, 8);
+	EXPECT_EQ(resolver.calls(), 1);
+}
+
+TEST_F(LoaderTests, WaitingForInFlightLoadTimesOut) {
+	const SlowModuleResolver resolver { std::chrono::milliseconds(300) };
+	_loader.set_module_resolver(&resolver);
+	_loader.set_load_timeout(std::chrono::milliseconds(10));
+	std::thread first { [&] { _loader.get_module("foo"); } };
+	while (resolver.calls() == 0) std::this_thread::yield();
+	EXPECT_THROW(_loader.get_module("foo"), tldr::LoadTimeoutError);
+	first.join();
+	EXPECT_EQ(resolver.calls(), 1);
+}
+
+TEST_F(LoaderTests, FailedRetentionEndsInFlightLoad) {
+	const MockModuleResolver mock_resolver;
+	_loader.set_module_resolver(&mock_resolver);
+	tldr::RetentionPolicy policy;
+	policy.max_modules = 2;
+	_loader.set_retention_policy(policy);
+	EXPECT_CALL(mock_resolver, get_module("foo"))
+		.WillOnce(testing::Invoke([] (const std::string &) {
+			const auto module = std::make_shared<testing::NiceMock<MockModule>>();
+			ON_CALL(*module, footprint()).WillByDefault(testing::Throw(std::runtime_error("footprint")));
+			return module;
+		}))
+		.WillOnce(testing::Return(std::make_shared<testing::NiceMock<MockModule>>()));
+	EXPECT_THROW(_loader.get_module("foo"), std::runtime_error);
+	/* from another thread, so a stale entry would be waited on */
+	auto retry = std::async(std::launch::async, [&] { return _loader.get_module("foo"); });
+	EXPECT_NE(retry.get(), nullptr);
+}
@@ -3,12 +3,15 @@
 
 #include <gmock/gmock.h>
 
+#include <tldr/memory_usage.hpp>
 #include <tldr/module.hpp>
 
 class MockModule : public tldr::Module {
 public:
 	MOCK_CONST_METHOD1(get_raw_data, tldr::data_ptr_t(const std::string & name));
 	MOCK_CONST_METHOD1(get_raw_proc, tldr::fn_ptr_t(const std::string & name));
+	MOCK_CONST_METHOD0(memory_usage, tldr::MemoryUsage());
+	MOCK_CONST_METHOD0(footprint, std::size_t());
 };
 
 #endif
@@ -0,0 +1,23 @@
+#ifndef TLDR_TEST_MODULE_DATA_HPP_
+#define TLDR_TEST_MODULE_DATA_HPP_
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+inline std::vector<char> read_module_data(const char * path)
+{
+	std::ifstream ifs { path, std::ios::binary };
+	return { std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>() };
+}
+
+/* Base fixture for tests that load the test module from memory. */
+class ModuleDataTests : public testing::Test
+{
+public:
+	std::vector<char> module_data_ = read_module_data(TLDR_TEST_MODULE_PATH);
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include <config.h>
+#include <gtest/gtest.h>
+#include <tldr/module_pool.hpp>
+
+#include "module_data.hpp"
+
+#include <vector>
+
+class ModulePoolTests : public ModuleDataTests {};
+
+TEST_F(ModulePoolTests, ConstructorPrewarmsInstances) {
+	tldr::ModulePool pool { module_data_.data(), module_data_.size(), 3 };
+	EXPECT_EQ(pool.idle(), 3u);
+	EXPECT_EQ(pool.loads(), 3u);
+}
+
+TEST_F(ModulePoolTests, ReleasedInstanceIsResetAndReused) {
+	tldr::ModulePool pool { module_data_.data(), module_data_.size(), 1 };
+	auto module = pool.acquire();
+	EXPECT_EQ(pool.idle(), 0u);
+	const auto count = module->get_data<int>("foo_test_init_count");
+	ASSERT_EQ(*count, 1);
+	*count = 42;
+	module.reset();
+	EXPECT_EQ(pool.idle(), 1u);
+	EXPECT_GT(pool.bytes_restored(), 0u);
+
+	module = pool.acquire();
+	EXPECT_EQ(module->get_data<int>("foo_test_init_count"), count);
+	EXPECT_EQ(*count, 1);
+	EXPECT_EQ(pool.loads(), 1u);
+}
+
+TEST_F(ModulePoolTests, AcquireLoadsWhenPoolIsEmpty) {
+	tldr::ModulePool pool { module_data_.data(), module_data_.size(), 1 };
+	auto first = pool.acquire();
+	auto second = pool.acquire();
+	EXPECT_NE(first, second);
+	EXPECT_EQ(pool.loads(), 2u);
+	*first->get_data<int>("foo_test_init_count") = 42;
+	*second->get_data<int>("foo_test_init_count") = 42;
+	first.reset();
+	const auto restored = pool.bytes_restored();
+	EXPECT_GT(restored, 0u);
+	second.reset();
+	EXPECT_EQ(pool.idle(), 1u);
+	EXPECT_EQ(pool.bytes_restored(), restored);
+}
+
+TEST_F(ModulePoolTests, DedupDoesNotShareInstances) {
+	tldr::LoadOptions options;
+	options.dedup = true;
+	tldr::ModulePool pool { module_data_.data(), module_data_.size(), 2,
+	                        tldr::system_loader, options };
+	EXPECT_EQ(pool.loads(), 2u);
+	const auto first = pool.acquire();
+	const auto second = pool.acquire();
+	EXPECT_NE(first->get_data<int>("foo_test_init_count"),
+	          second->get_data<int>("foo_test_init_count"));
+}
+
+TEST_F(ModulePoolTests, InstancesMayOutlivePool) {
+	std::shared_ptr<tldr::Module> module;
+	{
+		tldr::ModulePool pool { module_data_.data(), module_data_.size(), 1 };
+		module = pool.acquire();
+	}
+	EXPECT_EQ(module->get_proc<int()>("foo_test_proc")(), 0x11223344);
+}
@@ -1,29 +1,64 @@
 #include <config.h>
 #include <gtest/gtest.h>
+#include <tldr/memory_usage.hpp>
 #include <tldr/module.hpp>
+#include <tldr/page_profile.hpp>
 #include <tldr/raw_module.hpp>
+#include <tldr/relocation_plan_cache.hpp>
+#include <tldr/relocation_report.hpp>
+#include <tldr/unwind.hpp>
+
+#include "module_data.hpp"
+
+#include <dirent.h>
+#include <link.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <cstdio>
 #include <iterator>
 #include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 
-class RawModuleTests : public testing::Test
-{
-public:
-	RawModuleTests();
+class RawModuleTests : public ModuleDataTests {};
 
-public:
-	std::vector<char> module_data_;
-};
+namespace {
 
-RawModuleTests::RawModuleTests()
+/* The inode backing the mapping that holds addr, from /proc/self/maps. */
+unsigned long mapping_inode(const void * addr)
 {
-	std::ifstream ifs { TLDR_TEST_MODULE_PATH, std::ios::binary };
-	ifs.unsetf(std::ios::skipws);
-	std::copy(std::istream_iterator<char>(ifs),
-	          std::istream_iterator<char>(),
-	          std::back_inserter(module_data_));
+	const auto target = reinterpret_cast<std::uintptr_t>(addr);
+	std::ifstream maps { "/proc/self/maps" };
+	std::string line;
+	while (std::getline(maps, line)) {
+		std::uintptr_t begin = 0, end = 0;
+		unsigned long inode = 0;
+		if (std::sscanf(line.c_str(), "%zx-%zx %*s %*s %*s %lu", &begin, &end, &inode) == 3
+		 && target >= begin && target < end)
+			return inode;
+	}
+	return 0;
+}
+
+/* The page frame holding addr, or 0 where /proc/self/pagemap hides it. */
+std::uint64_t page_frame(const void * addr)
+{
+	const auto page_size = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+	std::ifstream pagemap { "/proc/self/pagemap", std::ios::binary };
+	pagemap.seekg(reinterpret_cast<std::uintptr_t>(addr) / page_size * sizeof(std::uint64_t));
+	std::uint64_t entry = 0;
+	if (!pagemap.read(reinterpret_cast<char *>(&entry), sizeof(entry))) return 0;
+	return entry & (std::uint64_t(1) << 63) ? entry & ((std::uint64_t(1) << 55) - 1) : 0;
+}
+
 }
 
 TEST_F(RawModuleTests, LoadFromMemoryWorks) {
@@ -69,6 +104,21 @@ TEST_F(RawModuleTests, GetProcGivesCorrectSymbolAddress) {
 	ASSERT_EQ(foo_fn(), 0x11223344);
 }
 
+TEST_F(RawModuleTests, FindSymbolsMatchesSingleLookups) {
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size());
+	std::vector<std::string> names;
+	for (int i = 0; i < 40; ++i) {
+		names.push_back(i % 3 ? "foo_test_proc" : "foo_unknown_" + std::to_string(i));
+		names.push_back("foo_test_data");
+	}
+	const std::vector<tldr::SymbolKind> kinds(names.size(), tldr::SymbolKind::Data);
+	std::vector<void *> addresses(names.size());
+	module->find_symbols(names.data(), kinds.data(), names.size(), addresses.data());
+	for (std::size_t i = 0; i < names.size(); ++i)
+		ASSERT_EQ(addresses[i], module->get_raw_data(names[i])) << names[i];
+}
+
 TEST_F(RawModuleTests, LoadFromMemoryResolvesAllImports) {
 	const auto module = tldr::load_from_memory(module_data_.data(),
 	                                           module_data_.size());
@@ -76,3 +126,647 @@ TEST_F(RawModuleTests, LoadFromMemoryResolvesAllImports) {
 	EXPECT_TRUE(foo_fn != nullptr);
 	foo_fn();
 }
+
+TEST_F(RawModuleTests, LoadFromMemoryFillsLoadStats) {
+	tldr::LoadStats stats;
+	tldr::LoadOptions options;
+	options.stats = &stats;
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size(),
+	                                           tldr::system_loader, options);
+	ASSERT_TRUE(module != nullptr);
+	EXPECT_GT(stats.bytes_mapped, 0u);
+	EXPECT_GT(stats.bytes_copied, 0u);
+	EXPECT_FALSE(stats.relocations.empty());
+	EXPECT_FALSE(stats.dependencies.empty());
+	const auto & relocate = stats.phase(tldr::LoadPhase::ApplyRelocations);
+	EXPECT_GT(relocate.wall_time.count(), 0);
+
+	const auto dependencies = stats.dependencies;
+	tldr::load_from_memory(module_data_.data(), module_data_.size(),
+	                       tldr::system_loader, options);
+	ASSERT_EQ(stats.dependencies.size(), dependencies.size());
+	for (std::size_t i = 0; i < dependencies.size(); ++i) {
+		EXPECT_EQ(stats.dependencies[i].name, dependencies[i].name);
+		EXPECT_EQ(stats.dependencies[i].symbols_resolved, 2 * dependencies[i].symbols_resolved);
+	}
+}
+
+TEST_F(RawModuleTests, OnFirstUseDefersInitializersToFirstLookup) {
+	tldr::LoadStats stats;
+	tldr::LoadOptions options;
+	options.stats = &stats;
+	options.init_policy = tldr::InitPolicy::OnFirstUse;
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size(),
+	                                           tldr::system_loader, options);
+	EXPECT_EQ(stats.phase(tldr::LoadPhase::Initialize).wall_time.count(), 0);
+	ASSERT_TRUE(module->get_raw_proc("unknown") == nullptr);
+
+	std::vector<std::thread> threads;
+	std::vector<int> counts(8);
+	for (auto & count : counts) {
+		threads.emplace_back([&module, &count] {
+			count = *module->get_data<int>("foo_test_init_count");
+		});
+	}
+	for (auto & thread : threads)
+		thread.join();
+	for (const auto count : counts)
+		EXPECT_EQ(count, 1);
+}
+
+TEST_F(RawModuleTests, BackgroundInitRunsOnExecutor) {
+	std::vector<std::function<void ()>> tasks;
+	tldr::LoadOptions options;
+	options.init_policy = tldr::InitPolicy::Background;
+	options.init_executor = [&tasks] (std::function<void ()> task) {
+		tasks.push_back(std::move(task));
+	};
+	auto module = tldr::load_from_memory(module_data_.data(),
+	                                     module_data_.size(),
+	                                     tldr::system_loader, options);
+	ASSERT_EQ(tasks.size(), 1u);
+	tasks[0]();
+	EXPECT_EQ(*module->get_data<int>("foo_test_init_count"), 1);
+
+	auto cancelled = tldr::load_from_memory(module_data_.data(),
+	                                        module_data_.size(),
+	                                        tldr::system_loader, options);
+	ASSERT_EQ(tasks.size(), 2u);
+	cancelled.reset();
+	tasks[1]();
+}
+
+TEST_F(RawModuleTests, WaitInitializedRethrowsBackgroundFailure) {
+	tldr::LoadOptions options;
+	options.init_policy = tldr::InitPolicy::Background;
+	auto module = tldr::load_from_memory(module_data_.data(),
+	                                     module_data_.size(),
+	                                     tldr::system_loader, options);
+	module->wait_initialized();
+	EXPECT_EQ(*module->get_data<int>("foo_test_init_count"), 1);
+
+	std::vector<std::function<void ()>> tasks;
+	options.init_executor = [&tasks] (std::function<void ()> task) {
+		tasks.push_back(std::move(task));
+	};
+	module = tldr::load_from_memory(module_data_.data(),
+	                                module_data_.size(),
+	                                tldr::system_loader, options);
+	ASSERT_EQ(tasks.size(), 1u);
+	setenv("FOO_TEST_INIT_THROW", "1", 1);
+	tasks[0]();
+	unsetenv("FOO_TEST_INIT_THROW");
+	EXPECT_THROW(module->wait_initialized(), std::runtime_error);
+	EXPECT_EQ(*module->get_data<int>("foo_test_init_count"), 1);
+	module->wait_initialized();
+}
+
+TEST_F(RawModuleTests, SharePagesMapsOnePristineCopy) {
+	tldr::LoadStats first_stats, second_stats;
+	tldr::LoadOptions options;
+	options.share_pages = true;
+	options.stats = &first_stats;
+	const auto first = tldr::load_from_memory(module_data_.data(),
+	                                          module_data_.size(),
+	                                          tldr::system_loader, options);
+	options.stats = &second_stats;
+	const auto second = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size(),
+	                                           tldr::system_loader, options);
+	EXPECT_GT(first_stats.bytes_copied, 0u);
+	EXPECT_EQ(second_stats.bytes_copied, 0u);
+	EXPECT_EQ(second_stats.bytes_mapped, first_stats.bytes_mapped);
+
+	EXPECT_EQ(first->get_proc<int()>("foo_test_proc")(), 0x11223344);
+	EXPECT_EQ(second->get_proc<int()>("foo_test_proc")(), 0x11223344);
+	EXPECT_EQ(*first->get_data<int>("foo_test_init_count"), 1);
+	EXPECT_EQ(*second->get_data<int>("foo_test_init_count"), 1);
+	EXPECT_NE(first->get_raw_data("foo_test_init_count"),
+	          second->get_raw_data("foo_test_init_count"));
+
+	const auto first_text = reinterpret_cast<const void *>(first->get_raw_proc("foo_test_proc"));
+	const auto second_text = reinterpret_cast<const void *>(second->get_raw_proc("foo_test_proc"));
+	ASSERT_NE(first_text, second_text);
+	EXPECT_NE(mapping_inode(first_text), 0u);
+	EXPECT_EQ(mapping_inode(first_text), mapping_inode(second_text));
+	const auto first_frame = page_frame(first_text);
+	if (first_frame != 0)
+		EXPECT_EQ(first_frame, page_frame(second_text));
+}
+
+TEST_F(RawModuleTests, TrimAfterLoadKeepsModuleUsable) {
+	tldr::LoadStats stats;
+	tldr::LoadOptions options;
+	options.stats = &stats;
+	options.trim_after_load = true;
+	const auto trimmed = tldr::load_from_memory(module_data_.data(),
+	                                            module_data_.size(),
+	                                            tldr::system_loader, options);
+	const auto untrimmed = tldr::load_from_memory(module_data_.data(),
+	                                              module_data_.size());
+	const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	EXPECT_GT(stats.bytes_trimmed, 0u);
+	EXPECT_EQ(stats.bytes_trimmed % page_size, 0u);
+	EXPECT_EQ(trimmed->get_proc<int()>("foo_test_proc")(), 0x11223344);
+	EXPECT_EQ(*trimmed->get_data<int>("foo_test_data"), 0x11223344);
+	const auto trimmed_usage = trimmed->memory_usage();
+	const auto untrimmed_usage = untrimmed->memory_usage();
+	EXPECT_EQ(trimmed_usage.relocated_bytes, untrimmed_usage.relocated_bytes);
+	EXPECT_EQ(trimmed_usage.reserved_bytes, untrimmed_usage.reserved_bytes);
+	EXPECT_LE(trimmed_usage.resident_bytes + stats.bytes_trimmed, untrimmed_usage.resident_bytes);
+}
+
+TEST_F(RawModuleTests, FullPopulateSkipsTrimmedPages) {
+	tldr::LoadStats trimmed_stats, untrimmed_stats;
+	tldr::LoadOptions options;
+	options.populate = tldr::PopulatePolicy::Full;
+	options.stats = &untrimmed_stats;
+	const auto untrimmed = tldr::load_from_memory(module_data_.data(),
+	                                              module_data_.size(),
+	                                              tldr::system_loader, options);
+	options.trim_after_load = true;
+	options.stats = &trimmed_stats;
+	const auto trimmed = tldr::load_from_memory(module_data_.data(),
+	                                            module_data_.size(),
+	                                            tldr::system_loader, options);
+	ASSERT_GT(trimmed_stats.bytes_trimmed, 0u);
+	EXPECT_EQ(trimmed_stats.bytes_populated + trimmed_stats.bytes_trimmed,
+	          untrimmed_stats.bytes_populated);
+	EXPECT_LE(trimmed->memory_usage().resident_bytes + trimmed_stats.bytes_trimmed,
+	          untrimmed->memory_usage().resident_bytes);
+}
+
+TEST_F(RawModuleTests, PopulatePolicyFaultsInRequestedPages) {
+	tldr::LoadStats full_stats, hot_stats;
+	tldr::LoadOptions options;
+	options.populate = tldr::PopulatePolicy::Full;
+	options.stats = &full_stats;
+	const auto full = tldr::load_from_memory(module_data_.data(),
+	                                         module_data_.size(),
+	                                         tldr::system_loader, options);
+	options.populate = tldr::PopulatePolicy::HotSet;
+	options.hot_symbols = { "foo_test_proc" };
+	options.stats = &hot_stats;
+	const auto hot = tldr::load_from_memory(module_data_.data(),
+	                                        module_data_.size(),
+	                                        tldr::system_loader, options);
+	EXPECT_GT(hot_stats.bytes_populated, 0u);
+	EXPECT_LT(hot_stats.bytes_populated, full_stats.bytes_populated);
+	EXPECT_LE(full_stats.bytes_populated, full_stats.bytes_mapped);
+	EXPECT_EQ(hot->get_proc<int()>("foo_test_proc")(), 0x11223344);
+}
+
+TEST_F(RawModuleTests, PageProfileRecordsAndPrefetchesTouchedPages) {
+	char directory[] = "/tmp/tldr-profiles-XXXXXX";
+	ASSERT_NE(mkdtemp(directory), nullptr);
+	std::vector<std::string> files;
+	{
+		tldr::PageProfileStore store { directory, std::chrono::hours(1) };
+		tldr::LoadStats stats;
+		tldr::LoadOptions options;
+		options.share_pages = true;
+		options.populate = tldr::PopulatePolicy::Profile;
+		options.page_profiles = &store;
+		options.stats = &stats;
+		std::size_t image_pages = 0;
+		{
+			const auto module = tldr::load_from_memory(module_data_.data(),
+			                                           module_data_.size(),
+			                                           tldr::system_loader, options);
+			image_pages = module->memory_usage().reserved_bytes / sysconf(_SC_PAGESIZE);
+			EXPECT_EQ(stats.bytes_populated, 0u);
+			EXPECT_EQ(store.pending(), 1u);
+			EXPECT_EQ(module->get_proc<int()>("foo_test_proc")(), 0x11223344);
+			store.flush();
+			EXPECT_EQ(store.pending(), 0u);
+		}
+		const auto dir = opendir(directory);
+		ASSERT_NE(dir, nullptr);
+		while (const auto entry = readdir(dir))
+			if (entry->d_name[0] != '.') files.push_back(entry->d_name);
+		closedir(dir);
+		ASSERT_EQ(files.size(), 1u);
+
+		std::vector<std::size_t> pages;
+		const auto key = files[0].substr(0, files[0].find('.'));
+		ASSERT_TRUE(store.load(key, image_pages, pages));
+		EXPECT_FALSE(pages.empty());
+		std::vector<std::size_t> rejected;
+		EXPECT_FALSE(store.load(key, pages.size() - 1, rejected));
+		EXPECT_FALSE(store.load(key, *std::max_element(pages.begin(), pages.end()), rejected));
+
+		stats = {};
+		const auto module = tldr::load_from_memory(module_data_.data(),
+		                                           module_data_.size(),
+		                                           tldr::system_loader, options);
+		EXPECT_GT(stats.bytes_populated, 0u);
+		EXPECT_LE(stats.bytes_populated, pages.size() * sysconf(_SC_PAGESIZE));
+		EXPECT_EQ(store.pending(), 0u);
+		EXPECT_EQ(module->get_proc<int()>("foo_test_proc")(), 0x11223344);
+	}
+	for (const auto & file : files)
+		std::remove((std::string(directory) + "/" + file).c_str());
+	rmdir(directory);
+}
+
+TEST_F(RawModuleTests, DedupReturnsLoadedModuleForIdenticalImage) {
+	tldr::LoadOptions options;
+	options.dedup = true;
+	const auto copy = module_data_;
+	const auto first = tldr::load_from_memory(module_data_.data(),
+	                                          module_data_.size(),
+	                                          tldr::system_loader, options);
+	const auto second = tldr::load_from_memory(copy.data(), copy.size(),
+	                                           tldr::system_loader, options);
+	EXPECT_EQ(first, second);
+
+	const tldr::SystemLoader other_resolver;
+	const auto other = tldr::load_from_memory(copy.data(), copy.size(),
+	                                          other_resolver, options);
+	EXPECT_NE(first, other);
+
+	options.dedup = false;
+	const auto isolated = tldr::load_from_memory(copy.data(), copy.size(),
+	                                             tldr::system_loader, options);
+	EXPECT_NE(first, isolated);
+	EXPECT_NE(first->get_proc<int()>("foo_test_proc"),
+	          isolated->get_proc<int()>("foo_test_proc"));
+}
+
+TEST_F(RawModuleTests, DedupMatchesImageWithoutBuildIdByContents) {
+	auto stripped = module_data_;
+	const auto ehdr = reinterpret_cast<ElfW(Ehdr) *>(stripped.data());
+	const auto phdrs = reinterpret_cast<ElfW(Phdr) *>(stripped.data() + ehdr->e_phoff);
+	for (std::size_t i = 0; i < ehdr->e_phnum; ++i)
+		if (phdrs[i].p_type == PT_NOTE) phdrs[i].p_type = PT_NULL;
+	tldr::LoadOptions options;
+	options.dedup = true;
+	const auto copy = stripped;
+	const auto first = tldr::load_from_memory(stripped.data(), stripped.size(),
+	                                          tldr::system_loader, options);
+	const auto second = tldr::load_from_memory(copy.data(), copy.size(),
+	                                           tldr::system_loader, options);
+	EXPECT_EQ(first, second);
+	const auto with_build_id = tldr::load_from_memory(module_data_.data(),
+	                                                  module_data_.size(),
+	                                                  tldr::system_loader, options);
+	EXPECT_NE(first, with_build_id);
+}
+
+TEST_F(RawModuleTests, RelativeRelocationsUseLoadAddress) {
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size());
+	EXPECT_EQ(module->get_proc<int()>("foo_test_indirect")(), 0x55667788);
+}
+
+TEST_F(RawModuleTests, PreferredBaseSkipsRelativeRelocations) {
+	const auto prelinked = read_module_data(TLDR_TEST_PRELINKED_MODULE_PATH);
+	ASSERT_FALSE(prelinked.empty());
+	const auto base = static_cast<std::uintptr_t>(TLDR_TEST_PRELINKED_BASE);
+	const auto at_base = [&] (const tldr::Module & module) {
+		const auto proc = reinterpret_cast<std::uintptr_t>(module.get_raw_proc("foo_test_proc"));
+		return proc >= base && proc < base + 0x100000;
+	};
+
+	tldr::LoadStats stats;
+	tldr::LoadOptions options;
+	options.stats = &stats;
+	const auto first = tldr::load_from_memory(prelinked.data(), prelinked.size(),
+	                                          tldr::system_loader, options);
+	ASSERT_TRUE(at_base(*first));
+	EXPECT_GT(stats.relocations_skipped, 0u);
+	EXPECT_EQ(first->get_proc<int()>("foo_test_indirect")(), 0x55667788);
+	EXPECT_EQ(first->get_proc<int()>("foo_test_proc")(), 0x11223344);
+
+	stats = {};
+	const auto second = tldr::load_from_memory(prelinked.data(), prelinked.size(),
+	                                           tldr::system_loader, options);
+	EXPECT_FALSE(at_base(*second));
+	EXPECT_EQ(stats.relocations_skipped, 0u);
+	EXPECT_EQ(second->get_proc<int()>("foo_test_indirect")(), 0x55667788);
+}
+
+TEST_F(RawModuleTests, PreferredBaseOptionPlacesImage) {
+	const auto base = static_cast<std::uintptr_t>(TLDR_TEST_PRELINKED_BASE) - 0x10000000000;
+	tldr::LoadStats stats;
+	tldr::LoadOptions options;
+	options.stats = &stats;
+	options.preferred_base = base;
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size(),
+	                                           tldr::system_loader, options);
+	const auto proc = reinterpret_cast<std::uintptr_t>(module->get_raw_proc("foo_test_proc"));
+	EXPECT_GE(proc, base);
+	EXPECT_LT(proc, base + 0x100000);
+	EXPECT_EQ(stats.relocations_skipped, 0u);
+	EXPECT_EQ(module->get_proc<int()>("foo_test_indirect")(), 0x55667788);
+}
+
+TEST_F(RawModuleTests, PreferredBaseOptionPlacesStreamedImage) {
+	const auto base = static_cast<std::uintptr_t>(TLDR_TEST_PRELINKED_BASE) - 0x20000000000;
+	tldr::LoadOptions options;
+	options.preferred_base = base;
+	std::istringstream stream { std::string { module_data_.begin(), module_data_.end() } };
+	const auto module = tldr::load_from_stream(stream, tldr::system_loader, options);
+	ASSERT_TRUE(module != nullptr);
+	const auto proc = reinterpret_cast<std::uintptr_t>(module->get_raw_proc("foo_test_proc"));
+	EXPECT_GE(proc, base);
+	EXPECT_LT(proc, base + 0x100000);
+	EXPECT_EQ(module->get_proc<int()>("foo_test_indirect")(), 0x55667788);
+}
+
+TEST_F(RawModuleTests, PageRelocationDensityCoversRelocatedPages) {
+	tldr::LoadStats stats;
+	tldr::LoadOptions options;
+	options.stats = &stats;
+	const auto module = tldr::load_from_memory(module_data_.data(), module_data_.size(),
+	                                           tldr::system_loader, options);
+	ASSERT_FALSE(stats.page_relocation_density.empty());
+	std::size_t pages = 0, lower_bound = 0, applied = 0;
+	for (const auto & entry : stats.page_relocation_density) {
+		EXPECT_EQ(entry.first & (entry.first - 1), 0u);
+		pages += entry.second;
+		lower_bound += entry.first * entry.second;
+	}
+	for (const auto & entry : stats.relocations)
+		applied += entry.second;
+	EXPECT_EQ(pages * static_cast<std::size_t>(sysconf(_SC_PAGESIZE)),
+	          module->memory_usage().relocated_bytes);
+	EXPECT_LE(lower_bound, applied);
+}
+
+TEST_F(RawModuleTests, RelocationPlanReplaysFromCacheAndDisk) {
+	char directory[] = "/tmp/tldr-plans-XXXXXX";
+	ASSERT_NE(mkdtemp(directory), nullptr);
+	tldr::LoadStats table_stats;
+	tldr::LoadOptions table_options;
+	table_options.stats = &table_stats;
+	tldr::load_from_memory(module_data_.data(), module_data_.size(),
+	                       tldr::system_loader, table_options);
+
+	const auto load = [&] (tldr::RelocationPlanCache & cache, tldr::LoadStats & stats) {
+		tldr::LoadOptions options;
+		options.stats = &stats;
+		options.relocation_plans = &cache;
+		const auto module = tldr::load_from_memory(module_data_.data(), module_data_.size(),
+		                                           tldr::system_loader, options);
+		EXPECT_EQ(module->get_proc<int()>("foo_test_indirect")(), 0x55667788);
+		EXPECT_EQ(module->get_proc<int()>("foo_test_proc")(), 0x11223344);
+		EXPECT_EQ(stats.relocations, table_stats.relocations);
+		EXPECT_EQ(stats.page_relocation_density, table_stats.page_relocation_density);
+	};
+	{
+		tldr::RelocationPlanCache cache { directory };
+		tldr::LoadStats first, second;
+		load(cache, first);
+		EXPECT_FALSE(first.relocation_plan_cached);
+		load(cache, second);
+		EXPECT_TRUE(second.relocation_plan_cached);
+		EXPECT_EQ(cache.size(), 1u);
+		EXPECT_EQ(cache.hits(), 1u);
+	}
+	{
+		tldr::RelocationPlanCache cache { directory };
+		tldr::LoadStats stats;
+		load(cache, stats);
+		EXPECT_TRUE(stats.relocation_plan_cached);
+		EXPECT_EQ(cache.hits(), 0u);
+	}
+
+	const auto dir = opendir(directory);
+	ASSERT_NE(dir, nullptr);
+	std::vector<std::string> files;
+	while (const auto entry = readdir(dir))
+		if (entry->d_name[0] != '.') files.push_back(entry->d_name);
+	closedir(dir);
+	ASSERT_EQ(files.size(), 1u);
+	{
+		/* a plan recorded for an image of another size is compiled again */
+		std::fstream file { std::string(directory) + "/" + files[0],
+		                    std::ios::binary | std::ios::in | std::ios::out };
+		file.seekp(12);
+		const std::uint64_t image_size = 1;
+		file.write(reinterpret_cast<const char *>(&image_size), sizeof(image_size));
+	}
+	{
+		tldr::RelocationPlanCache cache { directory };
+		tldr::LoadStats stats;
+		load(cache, stats);
+		EXPECT_FALSE(stats.relocation_plan_cached);
+	}
+	for (const auto & file : files)
+		std::remove((std::string(directory) + "/" + file).c_str());
+	rmdir(directory);
+}
+
+TEST_F(RawModuleTests, RelocationReportGroupsDirtyPagesBySection) {
+	EXPECT_EQ(tldr::load_from_memory(module_data_.data(), module_data_.size())
+	          ->relocation_report().page_size, 0u);
+
+	tldr::LoadStats stats;
+	tldr::LoadOptions options;
+	options.stats = &stats;
+	options.record_relocation_report = true;
+	const auto module = tldr::load_from_memory(module_data_.data(), module_data_.size(),
+	                                           tldr::system_loader, options);
+	const auto report = module->relocation_report();
+	EXPECT_EQ(report.module, "libfoo.so");
+	EXPECT_EQ(report.page_size, static_cast<std::size_t>(sysconf(_SC_PAGESIZE)));
+	EXPECT_GT(report.relocations, 0u);
+	ASSERT_FALSE(report.pages.empty());
+	EXPECT_EQ(report.dirty_bytes, report.pages.size() * report.page_size);
+	EXPECT_LE(report.dirty_bytes, module->memory_usage().relocated_bytes);
+
+	std::size_t relocations = 0, type_relocations = 0;
+	bool found_got = false;
+	for (const auto & section : report.sections) {
+		relocations += section.relocations;
+		EXPECT_EQ(section.dirty_bytes, section.pages.size() * report.page_size);
+		for (const auto page : section.pages)
+			EXPECT_TRUE(std::binary_search(report.pages.begin(), report.pages.end(), page));
+		if (section.name.compare(0, 4, ".got") == 0) found_got = true;
+	}
+	for (const auto & type : report.types) {
+		type_relocations += type.relocations;
+		EXPECT_FALSE(type.name.empty());
+		EXPECT_EQ(stats.relocations[type.type], type.relocations);
+	}
+	EXPECT_EQ(relocations, report.relocations);
+	EXPECT_EQ(type_relocations, report.relocations);
+	EXPECT_TRUE(found_got);
+
+	const auto json = tldr::to_json(report);
+	EXPECT_EQ(json.front(), '{');
+	EXPECT_NE(json.find("\"module\":\"libfoo.so\""), std::string::npos);
+	EXPECT_NE(json.find("\"dirty_bytes\":" + std::to_string(report.dirty_bytes)), std::string::npos);
+	EXPECT_EQ(tldr::to_json(std::vector<tldr::RelocationReport> { report }), "[" + json + "]");
+}
+
+TEST_F(RawModuleTests, MemoryUsageReportsSegments) {
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size());
+	module->get_proc<int()>("foo_test_proc")();
+	const auto usage = module->memory_usage();
+	EXPECT_GT(usage.reserved_bytes, 0u);
+	EXPECT_GT(usage.resident_bytes, 0u);
+	EXPECT_LE(usage.resident_bytes, usage.reserved_bytes);
+	EXPECT_GT(usage.relocated_bytes, 0u);
+	EXPECT_GT(usage.metadata_bytes, 0u);
+	ASSERT_FALSE(usage.segments.empty());
+	std::size_t relocated = 0;
+	bool found_text = false;
+	for (const auto & segment : usage.segments) {
+		relocated += segment.relocated_bytes;
+		EXPECT_LE(segment.resident_bytes, segment.size);
+		if (segment.executable) found_text = segment.resident_bytes > 0;
+	}
+	EXPECT_EQ(relocated, usage.relocated_bytes);
+	EXPECT_TRUE(found_text);
+}
+
+TEST_F(RawModuleTests, FootprintMatchesMemoryUsage) {
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size());
+	const auto usage = module->memory_usage();
+	EXPECT_EQ(module->footprint(), usage.reserved_bytes + usage.metadata_bytes);
+}
+
+TEST_F(RawModuleTests, PerfMapListsModuleSymbols) {
+	const auto map_path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+	tldr::LoadOptions options;
+	options.perf_outputs = tldr::PerfOutputMap;
+	auto module = tldr::load_from_memory(module_data_.data(),
+	                                     module_data_.size(),
+	                                     tldr::system_loader, options);
+	const auto proc = reinterpret_cast<std::uintptr_t>(module->get_raw_proc("foo_test_proc"));
+	module.reset();
+
+	std::ifstream map { map_path };
+	bool found_proc = false, found_tombstone = false;
+	for (std::string line; std::getline(map, line);) {
+		std::istringstream fields { line };
+		std::uintptr_t start;
+		std::size_t size;
+		std::string name;
+		fields >> std::hex >> start >> size;
+		std::getline(fields >> std::ws, name);
+		if (name == "foo_test_proc [libfoo.so]" && start == proc && size != 0)
+			found_proc = true;
+		if (name == "[unloaded libfoo.so]" && start <= proc && proc < start + size)
+			found_tombstone = true;
+	}
+	std::remove(map_path.c_str());
+	EXPECT_TRUE(found_proc);
+	EXPECT_TRUE(found_tombstone);
+}
+
+TEST_F(RawModuleTests, JitDumpIsCreatedInJitDumpDir) {
+	char dir[] = "/tmp/tldr-jitdump-XXXXXX";
+	ASSERT_NE(nullptr, mkdtemp(dir));
+	setenv("JITDUMPDIR", dir, 1);
+	tldr::LoadOptions options;
+	options.perf_outputs = tldr::PerfOutputJitDump;
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size(),
+	                                           tldr::system_loader, options);
+	unsetenv("JITDUMPDIR");
+
+	const auto dump_path = std::string { dir } + "/jit-" + std::to_string(getpid()) + ".dump";
+	struct stat st;
+	ASSERT_EQ(0, lstat(dump_path.c_str(), &st));
+	EXPECT_TRUE(S_ISREG(st.st_mode));
+	EXPECT_EQ(0, st.st_mode & (S_IWGRP | S_IWOTH));
+	std::uint32_t magic = 0;
+	std::ifstream { dump_path, std::ios::binary }.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+	EXPECT_EQ(0x4a695444u, magic);
+	std::remove(dump_path.c_str());
+	rmdir(dir);
+}
+
+TEST_F(RawModuleTests, ExceptionsUnwindOutOfLoadedCode) {
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size());
+	const auto foo_throw = module->get_proc<void()>("foo_test_throw");
+	ASSERT_THROW(foo_throw(), std::runtime_error);
+}
+
+TEST_F(RawModuleTests, IteratePhdrReportsLoadedImage) {
+	const auto module = tldr::load_from_memory(module_data_.data(),
+	                                           module_data_.size());
+	struct Search
+	{
+		std::uintptr_t proc;
+		bool found;
+		bool has_eh_frame;
+	} search { reinterpret_cast<std::uintptr_t>(module->get_raw_proc("foo_test_proc")) };
+	tldr::iterate_phdr([] (dl_phdr_info * info, std::size_t, void * data) {
+		const auto search = static_cast<Search *>(data);
+		for (int i = 0; i < info->dlpi_phnum; ++i) {
+			const auto & phdr = info->dlpi_phdr[i];
+			const auto start = info->dlpi_addr + phdr.p_vaddr;
+			if (phdr.p_type == PT_LOAD && start <= search->proc
+			 && search->proc < start + phdr.p_memsz)
+				search->found = true;
+			if (search->found && phdr.p_type == PT_GNU_EH_FRAME)
+				search->has_eh_frame = true;
+		}
+		return search->found ? 1 : 0;
+	}, &search);
+	EXPECT_TRUE(search.found);
+	EXPECT_TRUE(search.has_eh_frame);
+}
+
+TEST_F(RawModuleTests, LoadFromStreamWorks) {
+	std::ifstream ifs { TLDR_TEST_MODULE_PATH, std::ios::binary };
+	const auto module = tldr::load_from_stream(ifs);
+	ASSERT_TRUE(module != nullptr);
+	const auto foo_fn = module->get_proc<int()>("foo_test_proc");
+	ASSERT_EQ(foo_fn(), 0x11223344);
+}
+
+TEST_F(RawModuleTests, LoadFromStreamAcceptsSmallChunks) {
+	std::size_t offset = 0;
+	const auto read = [&] (void * buffer, std::size_t size) -> std::size_t {
+		const auto count = std::min<std::size_t>({ size, 7, module_data_.size() - offset });
+		std::copy_n(module_data_.data() + offset, count, static_cast<char *>(buffer));
+		offset += count;
+		return count;
+	};
+	const auto module = tldr::load_from_stream(read);
+	ASSERT_TRUE(module != nullptr);
+	const auto foo_data = module->get_data<int>("foo_test_data");
+	ASSERT_EQ(*foo_data, 0x11223344);
+}
+
+TEST_F(RawModuleTests, LoadFromStreamThrowsOnTruncatedImage) {
+	std::istringstream stream { std::string(module_data_.data(), 2048) };
+	ASSERT_THROW(tldr::load_from_stream(stream), tldr::LoadError);
+}
+
+TEST_F(RawModuleTests, LoadRejectsProgramHeadersOutOfBounds) {
+	ElfW(Ehdr) ehdr;
+	std::memcpy(&ehdr, module_data_.data(), sizeof(ehdr));
+
+	auto table = module_data_;
+	auto corrupt = ehdr;
+	corrupt.e_phnum = 0xfffe;
+	std::memcpy(table.data(), &corrupt, sizeof(corrupt));
+	EXPECT_THROW(tldr::load_from_memory(table.data(), table.size()), tldr::LoadError);
+	std::istringstream stream { std::string(table.data(), table.size()) };
+	EXPECT_THROW(tldr::load_from_stream(stream), tldr::LoadError);
+
+	auto segment = module_data_;
+	for (std::size_t i = 0; i < ehdr.e_phnum; ++i) {
+		ElfW(Phdr) phdr;
+		const auto offset = ehdr.e_phoff + i * ehdr.e_phentsize;
+		std::memcpy(&phdr, segment.data() + offset, sizeof(phdr));
+		if (phdr.p_type == PT_LOAD) {
+			phdr.p_offset = segment.size();
+			std::memcpy(segment.data() + offset, &phdr, sizeof(phdr));
+			break;
+		}
+	}
+	EXPECT_THROW(tldr::load_from_memory(segment.data(), segment.size()), tldr::LoadError);
+}
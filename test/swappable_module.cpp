@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <tldr/raw_module.hpp>
+#include <tldr/swappable_module.hpp>
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace {
+
+int answer_v1() { return 1; }
+int answer_v2() { return 2; }
+const int data_v1 = 1;
+
+class FixedModule final : public tldr::Module
+{
+public:
+	explicit FixedModule(std::map<std::string, tldr::fn_ptr_t> procs)
+		: procs_ { std::move(procs) } {}
+
+	virtual tldr::fn_ptr_t get_raw_proc(const std::string & name) const override
+	{
+		const auto iter = procs_.find(name);
+		return iter != procs_.end() ? iter->second : nullptr;
+	}
+
+	virtual tldr::data_ptr_t get_raw_data(const std::string & name) const override
+	{
+		return name == "data" ? const_cast<int *>(&data_v1) : nullptr;
+	}
+
+private:
+	std::map<std::string, tldr::fn_ptr_t> procs_;
+};
+
+std::shared_ptr<tldr::Module> make_module(int (* answer)())
+{
+	return std::make_shared<FixedModule>(std::map<std::string, tldr::fn_ptr_t> {
+		{ "answer", reinterpret_cast<tldr::fn_ptr_t>(answer) }
+	});
+}
+
+}
+
+TEST(SwappableModuleTests, GetProcCallsCurrentModule) {
+	tldr::SwappableModule module { make_module(answer_v1) };
+	const auto answer = module.get_proc<int()>("answer");
+	ASSERT_TRUE(answer != nullptr);
+	ASSERT_EQ(answer(), 1);
+}
+
+TEST(SwappableModuleTests, GetProcReturnsStableAddress) {
+	tldr::SwappableModule module { make_module(answer_v1) };
+	ASSERT_EQ(module.get_raw_proc("answer"), module.get_raw_proc("answer"));
+}
+
+TEST(SwappableModuleTests, GetRawProcGivesNullIfSymbolNotFound) {
+	tldr::SwappableModule module { make_module(answer_v1) };
+	ASSERT_TRUE(module.get_raw_proc("unknown") == nullptr);
+}
+
+TEST(SwappableModuleTests, GetRawDataForwardsToCurrentModule) {
+	tldr::SwappableModule module { make_module(answer_v1) };
+	ASSERT_EQ(*module.get_data<int>("data"), 1);
+}
+
+TEST(SwappableModuleTests, InstallRetargetsCachedProcs) {
+	tldr::SwappableModule module { make_module(answer_v1) };
+	const auto answer = module.get_proc<int()>("answer");
+	module.install(make_module(answer_v2));
+	ASSERT_EQ(answer(), 2);
+	ASSERT_EQ(module.get_proc<int()>("answer"), answer);
+}
+
+TEST(SwappableModuleTests, InstallThrowsIfBoundSymbolMissing) {
+	tldr::SwappableModule module { make_module(answer_v1) };
+	const auto answer = module.get_proc<int()>("answer");
+	const auto empty = std::make_shared<FixedModule>(std::map<std::string, tldr::fn_ptr_t> {});
+	ASSERT_THROW(module.install(empty), tldr::LoadError);
+	ASSERT_EQ(answer(), 1);
+}
+
+TEST(SwappableModuleTests, ReclaimWaitsForReaderQuiescence) {
+	auto old_module = make_module(answer_v1);
+	const std::weak_ptr<tldr::Module> old_ref = old_module;
+	tldr::SwappableModule module { std::move(old_module) };
+	tldr::SwappableModule::Reader reader { module };
+	module.install(make_module(answer_v2));
+	ASSERT_EQ(module.reclaim(), 0u);
+	ASSERT_FALSE(old_ref.expired());
+	reader.quiescent();
+	ASSERT_EQ(module.reclaim(), 1u);
+	ASSERT_TRUE(old_ref.expired());
+}
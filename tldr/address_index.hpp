@@ -0,0 +1,37 @@
+#ifndef TLDR_ADDRESSINDEX_HPP_
+#define TLDR_ADDRESSINDEX_HPP_
+
+#include <tldr/module.hpp>
+
+#include <cstddef>
+
+namespace tldr {
+
+struct ModuleInfo
+{
+	const Module * module = nullptr;
+	const char * name = nullptr;
+	const void * base = nullptr;
+	std::size_t size = 0;
+};
+
+struct SymbolInfo
+{
+	ModuleInfo module;
+	const char * name = nullptr;
+	const void * address = nullptr;
+	std::size_t size = 0;
+};
+
+/*
+	Reverse lookups over every image mapped by load_from_memory and
+	load_from_stream. Neither function allocates or takes a lock, so both may
+	be called from signal handlers. A lookup that finds 128 others already
+	in progress fails instead of waiting for one of them to finish.
+*/
+TLDR_EXPORT bool find_module(const void * addr, ModuleInfo & info) noexcept;
+TLDR_EXPORT bool find_symbol(const void * addr, SymbolInfo & info) noexcept;
+
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef TLDR_ASYNCLOAD_HPP_
+#define TLDR_ASYNCLOAD_HPP_
+
+#include <tldr/raw_module.hpp>
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+
+namespace tldr {
+
+enum class LoadPriority
+{
+	Low,
+	Normal,
+	High,
+};
+
+class TLDR_EXPORT LoadCancelledError : public std::runtime_error
+{
+	using runtime_error::runtime_error;
+};
+
+class TLDR_EXPORT LoadQueueFullError : public std::runtime_error
+{
+	using runtime_error::runtime_error;
+};
+
+typedef std::function<void (std::shared_ptr<Module> module, std::exception_ptr error)> LoadCallback;
+
+struct AsyncLoadOptions
+{
+	LoadPriority priority = LoadPriority::Normal;
+	LoadCallback on_complete;
+};
+
+class LoadJob;
+
+/*
+	The result of a queued load. cancel() succeeds only while the load is
+	still queued; once a worker has started mapping the image it runs to
+	completion. A cancelled load fails with LoadCancelledError, and its
+	completion callback runs on the thread that cancelled it.
+*/
+class TLDR_EXPORT LoadHandle
+{
+public:
+	LoadHandle() = default;
+	explicit LoadHandle(std::shared_ptr<LoadJob> job);
+
+	std::shared_future<std::shared_ptr<Module>> future() const;
+	std::shared_ptr<Module> get() const;
+	bool cancel();
+
+private:
+	std::shared_ptr<LoadJob> job_;
+};
+
+/*
+	A pool of loader threads fed from a bounded priority queue; higher
+	priorities run first and equal priorities in submission order. A load
+	submitted while the queue is full fails straight away with
+	LoadQueueFullError. Cancelled loads stop counting against the queue
+	at once. Completion callbacks run on the worker thread, except for a
+	rejected load, whose callback runs in submit(), and a cancelled one;
+	exceptions they throw are discarded. Destroying the executor cancels
+	whatever is still queued and waits for running loads to finish.
+*/
+class TLDR_EXPORT LoadExecutor
+{
+public:
+	explicit LoadExecutor(std::size_t threads = 1, std::size_t max_queued = 64);
+	~LoadExecutor();
+
+	LoadExecutor(const LoadExecutor &) = delete;
+	LoadExecutor & operator=(const LoadExecutor &) = delete;
+
+	LoadHandle submit(std::function<std::shared_ptr<Module> ()> load,
+	                  const AsyncLoadOptions & options = {});
+
+	std::size_t queued() const;
+
+private:
+	friend class LoadJob;
+
+	struct State;
+	std::shared_ptr<State> state_;
+};
+
+/*
+	The caller keeps mem, resolver and the LoadOptions::stats target alive
+	until the load completes.
+*/
+TLDR_EXPORT
+LoadHandle load_from_memory_async(LoadExecutor & executor,
+                                  const void * mem, std::size_t size,
+                                  const ModuleResolver & resolver = system_loader,
+                                  const LoadOptions & options = {},
+                                  const AsyncLoadOptions & async_options = {});
+
+}
+
+#endif
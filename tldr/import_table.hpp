@@ -0,0 +1,164 @@
+#ifndef TLDR_IMPORTTABLE_HPP_
+#define TLDR_IMPORTTABLE_HPP_
+
+#include <tldr/module.hpp>
+#include <tldr/raw_module.hpp>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tldr {
+
+enum ImportFlags
+{
+	ImportRequired = 0,
+	ImportOptional = 1 << 0,
+};
+
+class TLDR_EXPORT MissingSymbolsError : public LoadError
+{
+public:
+	explicit MissingSymbolsError(std::vector<std::string> missing);
+
+	const std::vector<std::string> & missing() const;
+
+private:
+	std::vector<std::string> missing_;
+};
+
+/*
+	Named, typed slots resolved together by Module::bind; each slot keeps the
+	index it registered at, so reading a bound slot is a single indexed load.
+
+		struct FooImports : tldr::ImportTable {
+			Proc<int()> test_proc { *this, "foo_test_proc" };
+			Data<const int> test_data { *this, "foo_test_data" };
+		};
+*/
+class TLDR_EXPORT ImportTable
+{
+public:
+	template <typename Fn> class Proc;
+	template <typename T> class Data;
+
+	ImportTable();
+	ImportTable(const ImportTable &) = delete;
+	ImportTable & operator=(const ImportTable &) = delete;
+	virtual ~ImportTable();
+
+	std::size_t add(std::string name, SymbolKind kind, int flags = ImportRequired);
+
+	std::size_t size() const;
+	const std::vector<std::string> & names() const;
+	const std::vector<SymbolKind> & kinds() const;
+	SymbolKind kind(std::size_t index) const;
+	int flags(std::size_t index) const;
+
+	void * address(std::size_t index) const;
+	void set_address(std::size_t index, void * address);
+
+	bool is_bound() const;
+	void validate();
+
+private:
+	std::vector<std::string> names_;
+	std::vector<SymbolKind> kinds_;
+	std::vector<int> flags_;
+	std::vector<void *> addresses_;
+	bool bound_;
+};
+
+template <typename Fn>
+class ImportTable::Proc
+{
+public:
+	Proc(ImportTable & table, std::string name, int flags = ImportRequired);
+
+	Fn * get() const;
+	explicit operator bool() const;
+
+	template <typename... Args>
+	decltype(auto) operator()(Args &&... args) const;
+
+private:
+	const ImportTable & table_;
+	std::size_t index_;
+};
+
+template <typename T>
+class ImportTable::Data
+{
+public:
+	Data(ImportTable & table, std::string name, int flags = ImportRequired);
+
+	T * get() const;
+	explicit operator bool() const;
+
+	T & operator*() const;
+	T * operator->() const;
+
+private:
+	const ImportTable & table_;
+	std::size_t index_;
+};
+
+inline void * ImportTable::address(std::size_t index) const
+{
+	return addresses_[index];
+}
+
+template <typename Fn>
+ImportTable::Proc<Fn>::Proc(ImportTable & table, std::string name, int flags)
+	: table_ { table }, index_ { table.add(std::move(name), SymbolKind::Proc, flags) } {}
+
+template <typename Fn>
+Fn * ImportTable::Proc<Fn>::get() const
+{
+	return reinterpret_cast<Fn *>(table_.address(index_));
+}
+
+template <typename Fn>
+ImportTable::Proc<Fn>::operator bool() const
+{
+	return get() != nullptr;
+}
+
+template <typename Fn> template <typename... Args>
+decltype(auto) ImportTable::Proc<Fn>::operator()(Args &&... args) const
+{
+	return get()(std::forward<Args>(args)...);
+}
+
+template <typename T>
+ImportTable::Data<T>::Data(ImportTable & table, std::string name, int flags)
+	: table_ { table }, index_ { table.add(std::move(name), SymbolKind::Data, flags) } {}
+
+template <typename T>
+T * ImportTable::Data<T>::get() const
+{
+	return static_cast<T *>(table_.address(index_));
+}
+
+template <typename T>
+ImportTable::Data<T>::operator bool() const
+{
+	return get() != nullptr;
+}
+
+template <typename T>
+T & ImportTable::Data<T>::operator*() const
+{
+	return *get();
+}
+
+template <typename T>
+T * ImportTable::Data<T>::operator->() const
+{
+	return get();
+}
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef TLDR_LOADSTATS_HPP_
+#define TLDR_LOADSTATS_HPP_
+
+#include <tldr/export.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace tldr {
+
+enum class LoadPhase
+{
+	MapProgramHeaders,
+	ResolveImports,
+	ApplyRelocations,
+	ApplyPermissions,
+	Populate,
+	Initialize,
+};
+
+constexpr std::size_t load_phase_count = 6;
+
+struct PhaseStats
+{
+	std::chrono::nanoseconds wall_time {};
+	std::chrono::nanoseconds cpu_time {};
+	long minor_faults = 0;
+	long major_faults = 0;
+};
+
+struct DependencyStats
+{
+	std::string name;
+	std::size_t symbols_resolved = 0;
+};
+
+struct LoadStats
+{
+	std::array<PhaseStats, load_phase_count> phases;
+	std::map<unsigned int, std::size_t> relocations;
+	std::size_t relocations_skipped = 0;
+	bool relocation_plan_cached = false;
+	std::vector<DependencyStats> dependencies;
+	std::size_t symbols_resolved_locally = 0;
+	std::size_t bytes_mapped = 0;
+	std::size_t bytes_copied = 0;
+	std::size_t bytes_trimmed = 0;
+	std::size_t bytes_populated = 0;
+	/*
+		Relocated pages keyed by how many relocations were applied to them,
+		rounded down to a power of two. A relocation that straddles two
+		pages counts on both.
+	*/
+	std::map<std::size_t, std::size_t> page_relocation_density;
+
+	PhaseStats & phase(LoadPhase phase);
+	const PhaseStats & phase(LoadPhase phase) const;
+	std::size_t dependency_index(const std::string & name);
+};
+
+TLDR_EXPORT const char * to_string(LoadPhase phase);
+
+inline PhaseStats & LoadStats::phase(LoadPhase phase)
+{
+	return phases[static_cast<std::size_t>(phase)];
+}
+
+inline const PhaseStats & LoadStats::phase(LoadPhase phase) const
+{
+	return phases[static_cast<std::size_t>(phase)];
+}
+
+/*
+	Dependencies are keyed by name, so that a LoadStats reused across loads
+	accumulates each dependency's counts in one entry.
+ */
+inline std::size_t LoadStats::dependency_index(const std::string & name)
+{
+	for (std::size_t i = 0; i < dependencies.size(); ++i)
+		if (dependencies[i].name == name) return i;
+	dependencies.push_back({ name });
+	return dependencies.size() - 1;
+}
+
+}
+
+#endif
@@ -3,13 +3,26 @@
 
 #include <tldr/export.h>
 
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace tldr {
 
 class Module;
+class LoadExecutor;
+class LoadHandle;
+struct AsyncLoadOptions;
+struct MemoryUsage;
+struct RelocationReport;
 
 class TLDR_EXPORT ModuleResolver
 {
@@ -18,6 +31,38 @@ public:
 	virtual std::shared_ptr<Module> get_module(const std::string & name) const = 0;
 };
 
+/*
+	Modules a Loader keeps alive after their last user lets go. A zero
+	limit is unbounded; both zero disables retention, which is the default.
+	Bytes are counted as each module's reserved image plus its metadata.
+*/
+struct RetentionPolicy
+{
+	std::size_t max_modules = 0;
+	std::size_t max_bytes = 0;
+};
+
+struct LoaderCounters
+{
+	std::size_t hits = 0;
+	std::size_t misses = 0;
+	std::size_t evictions = 0;
+	std::size_t coalesced = 0;
+};
+
+class TLDR_EXPORT LoadTimeoutError : public std::runtime_error
+{
+	using runtime_error::runtime_error;
+};
+
+/*
+	Concurrent get_module calls for a name that is being resolved wait for
+	that one resolution and share its module or its exception, instead of
+	each asking the resolver. With a load timeout set, waiters give up with
+	LoadTimeoutError after that long; the load itself carries on.
+	get_module_async runs get_module on a LoadExecutor; the Loader must
+	outlive the load.
+*/
 class TLDR_EXPORT Loader : public ModuleResolver
 {
 public:
@@ -25,14 +70,55 @@ public:
 
 	virtual std::shared_ptr<Module> get_module(const std::string & name) const override;
 
+	LoadHandle get_module_async(LoadExecutor & executor, const std::string & name) const;
+	LoadHandle get_module_async(LoadExecutor & executor, const std::string & name,
+	                            const AsyncLoadOptions & options) const;
+
 	void set_module(const std::string & name, std::shared_ptr<Module> module);
 	void remove_module(const std::string & name);
 
 	void set_module_resolver(const ModuleResolver * resolver);
 
+	MemoryUsage memory_usage() const;
+	std::vector<RelocationReport> relocation_reports() const;
+
+	void set_retention_policy(const RetentionPolicy & policy);
+	void clear_retained();
+	std::size_t retained_bytes() const;
+	LoaderCounters counters() const;
+
+	void set_load_timeout(std::chrono::milliseconds timeout);
+
+private:
+	struct InFlight
+	{
+		std::shared_future<std::shared_ptr<Module>> result;
+		std::thread::id loader;
+	};
+
+	struct Retained
+	{
+		std::string name;
+		std::shared_ptr<Module> module;
+		std::size_t bytes;
+	};
+
+	bool retention_enabled() const;
+	void retain(const std::string & name, std::shared_ptr<Module> module) const;
+	void release(const std::string & name) const;
+	void evict() const;
+
 private:
 	mutable std::unordered_map<std::string, std::weak_ptr<Module>> modules_;
 	const ModuleResolver * resolver_;
+	RetentionPolicy retention_;
+	mutable std::list<Retained> retained_;
+	mutable std::unordered_map<std::string, std::list<Retained>::iterator> retained_index_;
+	mutable std::size_t retained_bytes_;
+	mutable LoaderCounters counters_;
+	std::chrono::milliseconds load_timeout_;
+	mutable std::unordered_map<std::string, InFlight> in_flight_;
+	mutable std::mutex mutex_;
 };
 
 }
@@ -0,0 +1,41 @@
+#ifndef TLDR_MEMORYUSAGE_HPP_
+#define TLDR_MEMORYUSAGE_HPP_
+
+#include <tldr/export.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace tldr {
+
+struct SegmentUsage
+{
+	const void * address = nullptr;
+	std::size_t size = 0;
+	bool readable = false;
+	bool writable = false;
+	bool executable = false;
+	std::size_t resident_bytes = 0;
+	std::size_t relocated_bytes = 0;
+};
+
+/*
+	A snapshot of what a module costs: the address space it reserves, how
+	much of that is resident right now, the pages written by relocation
+	(private copies that can never be shared or dropped), and the heap and
+	side tables the loader keeps for it.
+*/
+struct MemoryUsage
+{
+	std::size_t reserved_bytes = 0;
+	std::size_t resident_bytes = 0;
+	std::size_t relocated_bytes = 0;
+	std::size_t metadata_bytes = 0;
+	std::vector<SegmentUsage> segments;
+
+	TLDR_EXPORT MemoryUsage & operator+=(const MemoryUsage & other);
+};
+
+}
+
+#endif
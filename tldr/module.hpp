@@ -3,6 +3,7 @@
 
 #include <tldr/export.h>
 
+#include <cstddef>
 #include <string>
 
 namespace tldr {
@@ -10,6 +11,16 @@ namespace tldr {
 typedef void * data_ptr_t;
 typedef void (* fn_ptr_t)();
 
+class ImportTable;
+struct MemoryUsage;
+struct RelocationReport;
+
+enum class SymbolKind
+{
+	Proc,
+	Data,
+};
+
 class TLDR_EXPORT Module
 {
 public:
@@ -18,6 +29,28 @@ public:
 	virtual fn_ptr_t get_raw_proc(const std::string & name) const = 0;
 	virtual data_ptr_t get_raw_data(const std::string & name) const = 0;
 
+	virtual void find_symbols(const std::string * names, const SymbolKind * kinds,
+	                          std::size_t count, void ** addresses) const;
+
+	void bind(ImportTable & table) const;
+
+	virtual MemoryUsage memory_usage() const;
+	virtual RelocationReport relocation_report() const;
+
+	/*
+		The reserved and metadata bytes of memory_usage(), which do not
+		change once the module is loaded. Cheap to call, unlike
+		memory_usage(), which probes residency page by page.
+	*/
+	virtual std::size_t footprint() const;
+
+	/*
+		Returns once the module's initializers have run, running them here
+		if nothing has started them yet. Rethrows the error of a deferred or
+		background run that failed.
+	*/
+	virtual void wait_initialized() const;
+
 	template <typename Fn>
 	Fn * get_proc(const std::string & name) const;
 
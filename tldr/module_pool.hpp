@@ -0,0 +1,49 @@
+#ifndef TLDR_MODULEPOOL_HPP_
+#define TLDR_MODULEPOOL_HPP_
+
+#include <tldr/raw_module.hpp>
+
+#include <cstddef>
+#include <memory>
+
+namespace tldr {
+
+/*
+	Keeps up to capacity initialized instances of one module image ready for
+	checkout. Each instance's writable segments are copied right after it is
+	initialized. When the last reference to a checked-out instance goes away,
+	the pages that differ from that copy are written back and the instance
+	returns to the pool instead of being unloaded.
+
+	Only state inside the module's own image is reset. Heap allocations,
+	threads and handles the module created are not undone. The image at mem
+	must outlive the pool, and instances may outlive it; they are unloaded
+	normally once released. LoadOptions::stats is ignored, since instances
+	may be loaded concurrently from acquire(), and so is LoadOptions::dedup,
+	since every instance must be a separate copy of the image.
+*/
+class TLDR_EXPORT ModulePool
+{
+public:
+	ModulePool(const void * mem, std::size_t size, std::size_t capacity,
+	           const ModuleResolver & resolver = system_loader,
+	           const LoadOptions & options = {});
+	~ModulePool();
+
+	ModulePool(const ModulePool &) = delete;
+	ModulePool & operator=(const ModulePool &) = delete;
+
+	std::shared_ptr<Module> acquire();
+
+	std::size_t idle() const;
+	std::size_t loads() const;
+	std::size_t bytes_restored() const;
+
+private:
+	struct State;
+	std::shared_ptr<State> state_;
+};
+
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef TLDR_PAGEPROFILE_HPP_
+#define TLDR_PAGEPROFILE_HPP_
+
+#include <tldr/module.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tldr {
+
+/*
+	Remembers which pages of an image its module had touched by the end of
+	a warm-up window, so that a later load with PopulatePolicy::Profile can
+	fault in just those pages. Profiles are kept as one file per image in
+	directory, which must exist, named after the image's build-id or, when
+	it has none, a hash of its contents.
+
+	Loads with LoadOptions::page_profiles set are sampled once window has
+	passed, on a thread owned by the store, unless their image has a
+	profile already. Recordings still pending when the store is destroyed
+	are dropped. Only pages this process has mapped count as touched, which
+	makes profiles most useful with LoadOptions::share_pages: private images
+	are written in full while loading. load() rejects a profile listing
+	more than max_pages pages, or any page past them, as stale or corrupt.
+*/
+class TLDR_EXPORT PageProfileStore
+{
+public:
+	explicit PageProfileStore(std::string directory,
+	                          std::chrono::milliseconds window = std::chrono::seconds(30));
+	~PageProfileStore();
+
+	PageProfileStore(const PageProfileStore &) = delete;
+	PageProfileStore & operator=(const PageProfileStore &) = delete;
+
+	bool load(const std::string & key, std::size_t max_pages,
+	          std::vector<std::size_t> & pages) const;
+	void save(const std::string & key, const std::vector<std::size_t> & pages) const;
+
+	void record(const std::shared_ptr<Module> & module);
+	void flush();
+	std::size_t pending() const;
+
+private:
+	struct State;
+	std::unique_ptr<State> state_;
+};
+
+}
+
+#endif
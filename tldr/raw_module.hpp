@@ -1,11 +1,17 @@
 #ifndef TLDR_RAWMODULE_HPP_
 #define TLDR_RAWMODULE_HPP_
 
+#include <tldr/load_stats.hpp>
 #include <tldr/module.hpp>
 #include <tldr/system_loader.hpp>
 
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace tldr {
 
@@ -14,10 +20,96 @@ class TLDR_EXPORT LoadError : public std::runtime_error
 	using runtime_error::runtime_error;
 };
 
+typedef std::function<std::size_t (void * buffer, std::size_t size)> ReadCallback;
+
+/*
+	PerfOutputMap appends to /tmp/perf-<pid>.map; PerfOutputJitDump writes
+	jit-<pid>.dump in $JITDUMPDIR, or /tmp. Unloads are only recorded in the
+	map, as jitdump has no record for them.
+*/
+enum PerfOutput
+{
+	PerfOutputNone = 0,
+	PerfOutputMap = 1 << 0,
+	PerfOutputJitDump = 1 << 1,
+};
+
+enum class InitPolicy
+{
+	Eager,
+	OnFirstUse,
+	Background,
+};
+
+typedef std::function<void (std::function<void ()> task)> Executor;
+
+/*
+	Which pages to fault in before a load returns. HotSet covers the pages
+	of LoadOptions::hot_symbols, or of every exported symbol if that is
+	empty. Profile covers the pages LoadOptions::page_profiles recorded for
+	the image, and none until it has recorded some.
+*/
+enum class PopulatePolicy
+{
+	None,
+	Full,
+	HotSet,
+	Profile,
+};
+
+class PageProfileStore;
+class RelocationPlanCache;
+
+struct LoadOptions
+{
+	LoadStats * stats = nullptr;
+	bool retain_symtab = false;
+	int perf_outputs = PerfOutputNone;
+	InitPolicy init_policy = InitPolicy::Eager;
+	Executor init_executor;
+	bool share_pages = false;
+	/*
+		Discards the pages holding only relocation tables once the image is
+		relocated, so the tables are gone. Pages of a private copy read back
+		as zeros afterwards. With share_pages they read back as the file
+		contents on POSIX systems and are left in place on Windows.
+	*/
+	bool trim_after_load = false;
+	PopulatePolicy populate = PopulatePolicy::None;
+	std::vector<std::string> hot_symbols;
+	PageProfileStore * page_profiles = nullptr;
+	bool dedup = false;
+	std::uintptr_t preferred_base = 0;
+	RelocationPlanCache * relocation_plans = nullptr;
+	bool record_relocation_report = false;
+};
+
 TLDR_EXPORT
 std::shared_ptr<Module> load_from_memory(const void * mem, std::size_t size,
                                          const ModuleResolver & resolver = system_loader);
 
+/*
+	With LoadOptions::dedup set, a load of an image that is already loaded,
+	through the same resolver and with dedup set, returns that module
+	instead of mapping another copy; the options of the first load apply.
+	Images are matched by their GNU build-id or, when they have none, by
+	the SHA-256 digest and size of their whole contents.
+*/
+TLDR_EXPORT
+std::shared_ptr<Module> load_from_memory(const void * mem, std::size_t size,
+                                         const ModuleResolver & resolver,
+                                         const LoadOptions & options);
+
+TLDR_EXPORT
+std::shared_ptr<Module> load_from_stream(const ReadCallback & read,
+                                         const ModuleResolver & resolver = system_loader,
+                                         const LoadOptions & options = {});
+
+TLDR_EXPORT
+std::shared_ptr<Module> load_from_stream(std::istream & stream,
+                                         const ModuleResolver & resolver = system_loader,
+                                         const LoadOptions & options = {});
+
 }
 
 #endif
@@ -0,0 +1,51 @@
+#ifndef TLDR_RELOCATIONPLANCACHE_HPP_
+#define TLDR_RELOCATIONPLANCACHE_HPP_
+
+#include <tldr/export.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace tldr {
+
+/*
+	Holds compiled relocation plans for loads with
+	LoadOptions::relocation_plans set. A plan lists an image's relative
+	fixups as sorted runs, plus its imports, each with the sites that refer
+	to it. It replays at any load address without decoding the relocation
+	tables again. Plans are keyed by build-id, or by a hash of the image
+	when it has none. Up to capacity plans are kept in memory. If directory
+	is set, plans are also written there and read back by later processes;
+	the directory must exist.
+
+	Entries are opaque to callers; find() and insert() exist for the
+	loader.
+*/
+class TLDR_EXPORT RelocationPlanCache
+{
+public:
+	explicit RelocationPlanCache(std::string directory = {}, std::size_t capacity = 64);
+	~RelocationPlanCache();
+
+	RelocationPlanCache(const RelocationPlanCache &) = delete;
+	RelocationPlanCache & operator=(const RelocationPlanCache &) = delete;
+
+	const std::string & directory() const;
+
+	std::shared_ptr<const void> find(const std::string & key) const;
+	void insert(const std::string & key, std::shared_ptr<const void> plan);
+	void clear();
+
+	std::size_t size() const;
+	std::size_t hits() const;
+	std::size_t misses() const;
+
+private:
+	struct State;
+	std::unique_ptr<State> state_;
+};
+
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef TLDR_RELOCATIONREPORT_HPP_
+#define TLDR_RELOCATIONREPORT_HPP_
+
+#include <tldr/export.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tldr {
+
+struct RelocationTypeUsage
+{
+	unsigned int type = 0;
+	std::string name;
+	std::size_t relocations = 0;
+	std::size_t dirty_pages = 0;
+	std::size_t dirty_bytes = 0;
+};
+
+struct RelocationSectionUsage
+{
+	std::string name;
+	std::uintptr_t offset = 0;
+	std::size_t size = 0;
+	std::size_t relocations = 0;
+	std::vector<std::uintptr_t> pages;
+	std::size_t dirty_bytes = 0;
+	std::vector<RelocationTypeUsage> types;
+};
+
+/*
+	The pages a module's relocations wrote to when it was loaded. Each such
+	page became a private, dirty copy that cannot be shared with other
+	processes or instances, so bytes are counted in whole pages. Offsets
+	are from the start of the image. Pages are listed per section, or per
+	segment when the image has no section headers, and broken down by
+	relocation type; a page written through several sections or types
+	counts once in each, and once in the module totals.
+
+	Modules record a report only when loaded with
+	LoadOptions::record_relocation_report; for others it is empty.
+*/
+struct RelocationReport
+{
+	std::string module;
+	std::size_t page_size = 0;
+	std::size_t relocations = 0;
+	std::size_t relocations_skipped = 0;
+	std::vector<std::uintptr_t> pages;
+	std::size_t dirty_bytes = 0;
+	std::vector<RelocationSectionUsage> sections;
+	std::vector<RelocationTypeUsage> types;
+};
+
+TLDR_EXPORT std::string to_json(const RelocationReport & report);
+TLDR_EXPORT std::string to_json(const std::vector<RelocationReport> & reports);
+
+}
+
+#endif
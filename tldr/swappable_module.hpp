@@ -0,0 +1,93 @@
+#ifndef TLDR_SWAPPABLEMODULE_HPP_
+#define TLDR_SWAPPABLEMODULE_HPP_
+
+#include <tldr/module.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tldr {
+
+/*
+	A module whose procedures are exported through stable trampolines.
+
+	get_raw_proc returns the address of a small jump stub instead of the
+	procedure itself. install() retargets every stub to the matching
+	procedure of a newer module, so pointers handed out earlier keep
+	working across upgrades. Each stub is retargeted with a single atomic
+	store and calls through it take no lock.
+
+	A replaced module is retired rather than released: reclaim() drops it
+	once every registered Reader has passed a quiescent state after the
+	swap. Threads that call into the module should own a Reader and call
+	quiescent() whenever they are not executing module code.
+
+	Data symbols cannot be redirected; get_raw_data returns the address in
+	the currently installed module.
+
+	The stubs are x86/x86_64 code; the class is only built for those
+	targets (TLDR_HAS_SWAPPABLE_MODULE in config.h).
+*/
+class TLDR_EXPORT SwappableModule final : public Module
+{
+public:
+	class TLDR_EXPORT Reader
+	{
+	public:
+		explicit Reader(SwappableModule & module);
+		Reader(const Reader &) = delete;
+		~Reader();
+
+		void quiescent();
+
+	private:
+		SwappableModule & module_;
+		std::shared_ptr<std::atomic<std::uint64_t>> observed_epoch_;
+	};
+
+	explicit SwappableModule(std::shared_ptr<Module> module);
+	virtual ~SwappableModule();
+
+	virtual fn_ptr_t get_raw_proc(const std::string & name) const override;
+	virtual data_ptr_t get_raw_data(const std::string & name) const override;
+	virtual MemoryUsage memory_usage() const override;
+	virtual std::size_t footprint() const override;
+	virtual RelocationReport relocation_report() const override;
+	virtual void wait_initialized() const override;
+
+	void install(std::shared_ptr<Module> module);
+	std::shared_ptr<Module> current() const;
+
+	std::uint64_t epoch() const;
+	std::size_t reclaim();
+
+private:
+	struct TrampolineBlock;
+
+	struct RetiredModule
+	{
+		std::shared_ptr<Module> module;
+		std::uint64_t epoch;
+	};
+
+	std::size_t allocate_trampoline(const std::string & name) const;
+	fn_ptr_t trampoline_at(std::size_t slot) const;
+	std::atomic<std::uintptr_t> & target_at(std::size_t slot) const;
+
+	mutable std::mutex mutex_;
+	std::shared_ptr<Module> current_;
+	mutable std::vector<std::unique_ptr<TrampolineBlock>> blocks_;
+	mutable std::unordered_map<std::string, std::size_t> slots_;
+	std::vector<RetiredModule> retired_;
+	std::vector<std::weak_ptr<std::atomic<std::uint64_t>>> readers_;
+	std::atomic<std::uint64_t> epoch_;
+};
+
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef TLDR_UNWIND_HPP_
+#define TLDR_UNWIND_HPP_
+
+#include <tldr/export.h>
+
+#ifndef _WIN32
+
+#include <link.h>
+
+#include <cstddef>
+
+namespace tldr {
+
+typedef int (* PhdrCallback)(dl_phdr_info * info, std::size_t size, void * data);
+
+/*
+	Same contract as dl_iterate_phdr: visits the objects known to the system
+	loader, then every image mapped by tldr. dlpi_adds and dlpi_subs also
+	count tldr loads and unloads, so unwinder caches keyed on them stay valid.
+*/
+TLDR_EXPORT int iterate_phdr(PhdrCallback callback, void * data);
+
+}
+
+#endif
+
+#endif